@@ -15,4 +15,7 @@ void __noreturn barebox_single_pbl_start(unsigned long membase,
 					 unsigned long memsize,
 					 void *boarddata);
 
+void arm_pbl_uncompress(unsigned long membase, unsigned long memsize,
+			void *dest, void *compressed_start, unsigned int len);
+
 #endif
@@ -34,3 +34,8 @@ void mmu_early_enable(unsigned long membase, unsigned long memsize,
 
 	__mmu_cache_on();
 }
+
+void mmu_early_disable(void)
+{
+	__mmu_cache_off();
+}
@@ -48,6 +48,48 @@ static void create_sections(void *ttb, uint64_t virt, uint64_t phys,
 	}
 }
 
+/*
+ * Map the memory cached. The level 1 table only has a 1GiB granularity,
+ * the parts of the memory which do not fill a whole 1GiB block are mapped
+ * with 2MiB blocks from level 2 tables placed right after the level 1
+ * table. A contiguous memory region needs at most two of them, which fit
+ * into the ARM_TTB_SIZE reserved for the table.
+ */
+static void map_cachable(uint64_t *ttb, uint64_t start, uint64_t size)
+{
+	uint64_t l1_size = 1ULL << level2shift(1);
+	uint64_t l2_size = 1ULL << level2shift(2);
+	uint64_t *table = ttb + GRANULE_SIZE / sizeof(*ttb);
+	uint64_t end, base, *pte;
+	int i;
+
+	end = ALIGN_DOWN(start + size, l2_size);
+	start = ALIGN(start, l2_size);
+
+	while (start < end) {
+		pte = ttb + (start >> level2shift(1));
+
+		if (IS_ALIGNED(start, l1_size) && end - start >= l1_size) {
+			*pte = start | CACHED_MEM | PTE_TYPE_BLOCK;
+			start += l1_size;
+			continue;
+		}
+
+		base = ALIGN_DOWN(start, l1_size);
+
+		for (i = 0; i < GRANULE_SIZE / sizeof(*table); i++)
+			table[i] = (base + i * l2_size) | UNCACHED_MEM |
+				   PTE_TYPE_BLOCK;
+
+		for (; start < end && start < base + l1_size; start += l2_size)
+			table[(start - base) >> level2shift(2)] =
+				start | CACHED_MEM | PTE_TYPE_BLOCK;
+
+		*pte = (uint64_t)table | PTE_TYPE_TABLE;
+		table += GRANULE_SIZE / sizeof(*table);
+	}
+}
+
 void mmu_early_enable(unsigned long membase, unsigned long memsize,
 		      unsigned long ttb)
 {
@@ -72,6 +114,33 @@ void mmu_early_enable(unsigned long membase, unsigned long memsize,
 	set_cr(get_cr() | CR_M);
 }
 
+/*
+ * Like mmu_early_enable(), but also for memory which is not 1GiB aligned,
+ * and with the data and instruction caches enabled. Used by the PBL to
+ * uncompress barebox with PBL_CACHED_UNCOMPRESS, the caller must turn the
+ * MMU off again with mmu_early_disable().
+ */
+void mmu_early_enable_cached(unsigned long membase, unsigned long memsize,
+			     unsigned long ttb)
+{
+	int el;
+
+	memset((void *)ttb, 0, GRANULE_SIZE);
+
+	el = current_el();
+	set_ttbr_tcr_mair(el, ttb, calc_tcr(el), MEMORY_ATTRIBUTES);
+	create_sections((void *)ttb, 0, 0, 1UL << (BITS_PER_VA - 1), UNCACHED_MEM);
+	map_cachable((void *)ttb, membase, memsize);
+	tlb_invalidate();
+	isb();
+
+	/* the caches are off, nothing in them may be written back */
+	v8_invalidate_dcache_all();
+	v8_invalidate_icache_all();
+
+	set_cr(get_cr() | CR_M | CR_C | CR_I);
+}
+
 void mmu_early_disable(void)
 {
 	unsigned int cr;
@@ -0,0 +1,118 @@
+/*
+ * pbl-uncompress.c - uncompress barebox with the caches enabled
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#define pr_fmt(fmt) "uncompress: " fmt
+
+#include <common.h>
+#include <pbl.h>
+#include <asm/barebox-arm.h>
+#include <asm/cache.h>
+#include <asm/mmu.h>
+#include <asm/system.h>
+
+#include "entry.h"
+
+enum pbl_cache_mode {
+	PBL_CACHE_OFF,
+	PBL_CACHE_ICACHE,
+	PBL_CACHE_MMU_ONLY,
+	PBL_CACHE_MMU,
+};
+
+static const char * const pbl_cache_mode_names[] = {
+	[PBL_CACHE_OFF] = "caches off",
+	[PBL_CACHE_ICACHE] = "icache only",
+	[PBL_CACHE_MMU_ONLY] = "MMU on, caches off",
+	[PBL_CACHE_MMU] = "MMU and caches on",
+};
+
+/*
+ * Uncompressing runs many times faster with the caches enabled. With
+ * MMU_EARLY the MMU is enabled here and stays on for barebox proper, on
+ * ARM64 this leaves the data cache off. Otherwise with
+ * PBL_CACHED_UNCOMPRESS the MMU and caches are only enabled while
+ * uncompressing. Without MMU support only the instruction cache can be
+ * enabled, data accesses are uncached without an MMU.
+ */
+static enum pbl_cache_mode pbl_cache_enable(unsigned long membase,
+					    unsigned long memsize)
+{
+	unsigned long ttb = arm_mem_ttb(membase, membase + memsize);
+	unsigned int cr;
+
+	if (IS_ENABLED(CONFIG_MMU_EARLY)) {
+		pr_debug("enabling MMU, ttb @ 0x%08lx\n", ttb);
+		mmu_early_enable(membase, memsize, ttb);
+		return IS_ENABLED(CONFIG_CPU_64) ? PBL_CACHE_MMU_ONLY :
+						   PBL_CACHE_MMU;
+	}
+
+	if (!IS_ENABLED(CONFIG_PBL_CACHED_UNCOMPRESS))
+		return PBL_CACHE_OFF;
+
+	if (IS_ENABLED(CONFIG_MMU)) {
+		pr_debug("enabling MMU, ttb @ 0x%08lx\n", ttb);
+		if (IS_ENABLED(CONFIG_CPU_64))
+			mmu_early_enable_cached(membase, memsize, ttb);
+		else
+			mmu_early_enable(membase, memsize, ttb);
+		return PBL_CACHE_MMU;
+	}
+
+	cr = get_cr();
+	if (!(cr & CR_I)) {
+		arm_early_mmu_cache_invalidate();
+		set_cr(cr | CR_I);
+	}
+
+	return PBL_CACHE_ICACHE;
+}
+
+static void pbl_cache_disable(enum pbl_cache_mode mode, unsigned int cr)
+{
+	if (IS_ENABLED(CONFIG_MMU_EARLY))
+		return;
+
+	if (mode == PBL_CACHE_MMU)
+		mmu_early_disable();
+	else if (mode == PBL_CACHE_ICACHE)
+		set_cr(cr);
+}
+
+void arm_pbl_uncompress(unsigned long membase, unsigned long memsize,
+			void *dest, void *compressed_start, unsigned int len)
+{
+	enum pbl_cache_mode mode;
+	unsigned long cycles = 0;
+	unsigned int cr = get_cr();
+	int counting;
+
+	mode = pbl_cache_enable(membase, memsize);
+
+	pr_debug("uncompressing barebox binary at 0x%p (size 0x%08x) to 0x%p\n",
+		 compressed_start, len, dest);
+
+	counting = arm_cycle_counter_enable();
+	if (counting)
+		cycles = arm_cycle_counter();
+
+	pbl_barebox_uncompress(dest, compressed_start, len);
+
+	if (counting)
+		cycles = arm_cycle_counter() - cycles;
+
+	pbl_cache_disable(mode, cr);
+
+	if (counting)
+		pr_info("uncompressed %u bytes in %lu cycles, %s\n", len,
+			cycles, pbl_cache_mode_names[mode]);
+}
@@ -30,6 +30,8 @@
 #include <asm/mmu.h>
 #include <asm/unaligned.h>
 
+#include "entry.h"
+
 unsigned long free_mem_ptr;
 unsigned long free_mem_end_ptr;
 
@@ -80,15 +82,11 @@ __noreturn void barebox_single_pbl_start(unsigned long membase,
 
 	setup_c();
 
-	if (IS_ENABLED(CONFIG_MMU_EARLY)) {
-		unsigned long ttb = arm_mem_ttb(membase, endmem);
-		mmu_early_enable(membase, memsize, ttb);
-	}
-
 	free_mem_ptr = arm_mem_early_malloc(membase, endmem);
 	free_mem_end_ptr = arm_mem_early_malloc_end(membase, endmem);
 
-	pbl_barebox_uncompress((void*)barebox_base, (void *)pg_start, pg_len);
+	arm_pbl_uncompress(membase, memsize, (void *)barebox_base,
+			   (void *)pg_start, pg_len);
 
 	arm_early_mmu_cache_flush();
 	icache_invalidate();
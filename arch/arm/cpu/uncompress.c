@@ -33,6 +33,8 @@
 
 #include <debug_ll.h>
 
+#include "entry.h"
+
 unsigned long free_mem_ptr;
 unsigned long free_mem_end_ptr;
 
@@ -84,19 +86,13 @@ void __noreturn barebox_multi_pbl_start(unsigned long membase,
 
 	pr_debug("memory at 0x%08lx, size 0x%08lx\n", membase, memsize);
 
-	if (IS_ENABLED(CONFIG_MMU_EARLY)) {
-		unsigned long ttb = arm_mem_ttb(membase, endmem);
-		pr_debug("enabling MMU, ttb @ 0x%08lx\n", ttb);
-		mmu_early_enable(membase, memsize, ttb);
-	}
-
 	free_mem_ptr = arm_mem_early_malloc(membase, endmem);
 	free_mem_end_ptr = arm_mem_early_malloc_end(membase, endmem);
 
-	pr_debug("uncompressing barebox binary at 0x%p (size 0x%08x) to 0x%08lx (uncompressed size: 0x%08x)\n",
-			pg_start, pg_len, barebox_base, uncompressed_len);
+	pr_debug("uncompressed size: 0x%08x\n", uncompressed_len);
 
-	pbl_barebox_uncompress((void*)barebox_base, pg_start, pg_len);
+	arm_pbl_uncompress(membase, memsize, (void *)barebox_base, pg_start,
+			   pg_len);
 
 	arm_early_mmu_cache_flush();
 	icache_invalidate();
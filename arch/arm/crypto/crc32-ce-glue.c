@@ -0,0 +1,78 @@
+/*
+ * crc32-ce-glue.c - CRC32 using the ARMv8 CRC32 instructions
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <common.h>
+#include <crc.h>
+#include <init.h>
+#include <asm/system_info.h>
+#include <asm/unaligned.h>
+
+/*
+ * The CPU is checked before these are used, enable the instructions for the
+ * assembler only instead of building everything for CPUs which have them.
+ */
+#define __CRC32_PREAMBLE	".arch_extension crc\n"
+
+static inline uint32_t crc32x(uint32_t crc, u64 val)
+{
+	asm(__CRC32_PREAMBLE "crc32x %w0, %w0, %x1" : "+r" (crc) : "r" (val));
+	return crc;
+}
+
+static inline uint32_t crc32w(uint32_t crc, u32 val)
+{
+	asm(__CRC32_PREAMBLE "crc32w %w0, %w0, %w1" : "+r" (crc) : "r" (val));
+	return crc;
+}
+
+static inline uint32_t crc32h(uint32_t crc, u16 val)
+{
+	asm(__CRC32_PREAMBLE "crc32h %w0, %w0, %w1" : "+r" (crc) : "r" (val));
+	return crc;
+}
+
+static inline uint32_t crc32b(uint32_t crc, u8 val)
+{
+	asm(__CRC32_PREAMBLE "crc32b %w0, %w0, %w1" : "+r" (crc) : "r" (val));
+	return crc;
+}
+
+static uint32_t crc32_armv8(uint32_t crc, const void *buf, unsigned int len)
+{
+	const u8 *p = buf;
+
+	while (len >= 8) {
+		crc = crc32x(crc, get_unaligned_le64(p));
+		p += 8;
+		len -= 8;
+	}
+
+	if (len & 4) {
+		crc = crc32w(crc, get_unaligned_le32(p));
+		p += 4;
+	}
+
+	if (len & 2) {
+		crc = crc32h(crc, get_unaligned_le16(p));
+		p += 2;
+	}
+
+	if (len & 1)
+		crc = crc32b(crc, *p);
+
+	return crc;
+}
+
+static int crc32_armv8_init(void)
+{
+	if (cpu_has_crc32())
+		crc32_register_arch("crc32-ce", crc32_armv8);
+
+	return 0;
+}
+coredevice_initcall(crc32_armv8_init);
@@ -0,0 +1,64 @@
+/*
+ * sha1-ce-glue.c - SHA-1 secure hash using ARMv8 Crypto Extensions
+ *
+ * Copyright (C) 2014 - 2017 Linaro Ltd <ard.biesheuvel@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <common.h>
+#include <digest.h>
+#include <init.h>
+#include <crypto/sha.h>
+#include <crypto/sha1_base.h>
+#include <crypto/internal.h>
+#include <asm/system_info.h>
+
+void sha1_ce_transform(u32 *state, u8 const *src, int blocks);
+
+static void sha1_ce_block_fn(struct sha1_state *sst, u8 const *src,
+			     int blocks)
+{
+	sha1_ce_transform(sst->state, src, blocks);
+}
+
+static int sha1_ce_update(struct digest *desc, const void *data,
+			  unsigned long len)
+{
+	return sha1_base_do_update(desc, data, len, sha1_ce_block_fn);
+}
+
+static int sha1_ce_final(struct digest *desc, u8 *out)
+{
+	sha1_base_do_finalize(desc, sha1_ce_block_fn);
+
+	return sha1_base_finish(desc, out);
+}
+
+static struct digest_algo m = {
+	.base = {
+		.name		=	"sha1",
+		.driver_name	=	"sha1-ce",
+		.priority	=	200,
+		.algo		=	HASH_ALGO_SHA1,
+	},
+
+	.init	=	sha1_base_init,
+	.update	=	sha1_ce_update,
+	.final	=	sha1_ce_final,
+	.digest	=	digest_generic_digest,
+	.verify	=	digest_generic_verify,
+	.length	=	SHA1_DIGEST_SIZE,
+	.ctx_length =	sizeof(struct sha1_state),
+};
+
+static int sha1_ce_mod_init(void)
+{
+	if (!cpu_has_sha1())
+		return 0;
+
+	return digest_algo_register(&m);
+}
+coredevice_initcall(sha1_ce_mod_init);
@@ -0,0 +1,87 @@
+/*
+ * sha2-ce-glue.c - SHA-224/SHA-256 using ARMv8 Crypto Extensions
+ *
+ * Copyright (C) 2014 - 2017 Linaro Ltd <ard.biesheuvel@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <common.h>
+#include <digest.h>
+#include <init.h>
+#include <crypto/sha.h>
+#include <crypto/sha256_base.h>
+#include <crypto/internal.h>
+#include <asm/system_info.h>
+
+void sha2_ce_transform(u32 *state, u8 const *src, int blocks);
+
+static void sha256_ce_block_fn(struct sha256_state *sst, u8 const *src,
+			       int blocks)
+{
+	sha2_ce_transform(sst->state, src, blocks);
+}
+
+static int sha256_ce_update(struct digest *desc, const void *data,
+			    unsigned long len)
+{
+	return sha256_base_do_update(desc, data, len, sha256_ce_block_fn);
+}
+
+static int sha256_ce_final(struct digest *desc, u8 *out)
+{
+	sha256_base_do_finalize(desc, sha256_ce_block_fn);
+
+	return sha256_base_finish(desc, out);
+}
+
+static struct digest_algo sha224 = {
+	.base = {
+		.name		=	"sha224",
+		.driver_name	=	"sha224-ce",
+		.priority	=	200,
+		.algo		=	HASH_ALGO_SHA224,
+	},
+
+	.length	=	SHA224_DIGEST_SIZE,
+	.init	=	sha224_base_init,
+	.update	=	sha256_ce_update,
+	.final	=	sha256_ce_final,
+	.digest	=	digest_generic_digest,
+	.verify	=	digest_generic_verify,
+	.ctx_length =	sizeof(struct sha256_state),
+};
+
+static struct digest_algo sha256 = {
+	.base = {
+		.name		=	"sha256",
+		.driver_name	=	"sha256-ce",
+		.priority	=	200,
+		.algo		=	HASH_ALGO_SHA256,
+	},
+
+	.length	=	SHA256_DIGEST_SIZE,
+	.init	=	sha256_base_init,
+	.update	=	sha256_ce_update,
+	.final	=	sha256_ce_final,
+	.digest	=	digest_generic_digest,
+	.verify	=	digest_generic_verify,
+	.ctx_length =	sizeof(struct sha256_state),
+};
+
+static int sha2_ce_mod_init(void)
+{
+	int ret;
+
+	if (!cpu_has_sha2())
+		return 0;
+
+	ret = digest_algo_register(&sha224);
+	if (ret)
+		return ret;
+
+	return digest_algo_register(&sha256);
+}
+coredevice_initcall(sha2_ce_mod_init);
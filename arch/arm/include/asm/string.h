@@ -8,6 +8,11 @@ extern void *memcpy(void *, const void *, __kernel_size_t);
 #define __HAVE_ARCH_MEMSET
 extern void *memset(void *, int, __kernel_size_t);
 
+#ifdef CONFIG_ARM_ASIMD_STRING_FUNCTIONS
+#define __HAVE_ARCH_MEMCMP
+extern int memcmp(const void *, const void *, __kernel_size_t);
+#endif
+
 #endif
 
 #endif
@@ -1,6 +1,8 @@
 #ifndef __ASM_ARM_SYSTEM_H
 #define __ASM_ARM_SYSTEM_H
 
+#include <asm/ptrace.h>
+
 #if __LINUX_ARM_ARCH__ >= 7
 #define isb() __asm__ __volatile__ ("isb" : : : "memory")
 #ifdef CONFIG_CPU_64v8
@@ -159,6 +161,105 @@ static inline void set_vbar(unsigned int vbar)
 static inline unsigned int get_vbar(void) { return 0; }
 static inline void set_vbar(unsigned int vbar) {}
 #endif
+
+/*
+ * The cycle counter of the performance monitors, used to measure the
+ * early startup code. arm_cycle_counter_enable() returns 0 when there is
+ * no architected PMU or when accessing it might trap, the counter must
+ * not be read then.
+ */
+#if defined(CONFIG_CPU_64v8)
+static inline int arm_cycle_counter_enable(void)
+{
+	unsigned long dfr0, pfr0, pmcr;
+	unsigned int pmuver, el;
+
+	/* ID_AA64DFR0_EL1.PMUVer, 0xf is an IMPLEMENTATION DEFINED PMU */
+	asm volatile("mrs %0, id_aa64dfr0_el1" : "=r" (dfr0));
+	pmuver = (dfr0 >> 8) & 0xf;
+	if (pmuver == 0 || pmuver == 0xf)
+		return 0;
+
+	/*
+	 * EL2 and EL3 can trap the PMU accesses of the lower exception
+	 * levels (MDCR_EL2.TPM, MDCR_EL3.TPM), so only use it when running
+	 * at the highest implemented one.
+	 */
+	asm volatile("mrs %0, id_aa64pfr0_el1" : "=r" (pfr0));
+	if ((pfr0 >> 12) & 0xf)
+		el = 3;
+	else if ((pfr0 >> 8) & 0xf)
+		el = 2;
+	else
+		el = 1;
+
+	if (current_el() != el)
+		return 0;
+
+	asm volatile("mrs %0, pmcr_el0" : "=r" (pmcr));
+	/* enable the counters, count every cycle instead of every 64th */
+	pmcr = (pmcr | (1 << 0)) & ~(1 << 3);
+	asm volatile("msr pmcr_el0, %0" : : "r" (pmcr));
+	asm volatile("msr pmcntenset_el0, %0" : : "r" (1UL << 31));
+	isb();
+
+	return 1;
+}
+
+static inline unsigned long arm_cycle_counter(void)
+{
+	unsigned long cycles;
+
+	isb();
+	asm volatile("mrs %0, pmccntr_el0" : "=r" (cycles));
+
+	return cycles;
+}
+#elif __LINUX_ARM_ARCH__ >= 7
+static inline int arm_cycle_counter_enable(void)
+{
+	unsigned int dfr0, pfr1, cpsr, pmcr, perfmon;
+
+	/*
+	 * ID_DFR0.PerfMon, only PMUv1 and PMUv2 are used. A PMUv3 means an
+	 * ARMv8 core in AArch32 state, on which EL3 can trap the accesses
+	 * without this being visible here.
+	 */
+	asm volatile("mrc p15, 0, %0, c0, c1, 2 @ get ID_DFR0" : "=r" (dfr0));
+	perfmon = (dfr0 >> 24) & 0xf;
+	if (perfmon != 1 && perfmon != 2)
+		return 0;
+
+	/* with the virtualization extensions HDCR.TPM can trap outside HYP */
+	asm volatile("mrc p15, 0, %0, c0, c1, 1 @ get ID_PFR1" : "=r" (pfr1));
+	asm volatile("mrs %0, cpsr" : "=r" (cpsr));
+	if (((pfr1 >> 12) & 0xf) && (cpsr & MODE_MASK) != HYP_MODE)
+		return 0;
+
+	asm volatile("mrc p15, 0, %0, c9, c12, 0 @ get PMCR" : "=r" (pmcr));
+	pmcr = (pmcr | (1 << 0)) & ~(1 << 3);
+	asm volatile("mcr p15, 0, %0, c9, c12, 0 @ set PMCR" : : "r" (pmcr));
+	asm volatile("mcr p15, 0, %0, c9, c12, 1 @ set PMCNTENSET"
+		     : : "r" (1 << 31));
+	isb();
+
+	return 1;
+}
+
+static inline unsigned long arm_cycle_counter(void)
+{
+	unsigned int cycles;
+
+	isb();
+	asm volatile("mrc p15, 0, %0, c9, c13, 0 @ get PMCCNTR"
+		     : "=r" (cycles));
+
+	return cycles;
+}
+#else
+static inline int arm_cycle_counter_enable(void) { return 0; }
+static inline unsigned long arm_cycle_counter(void) { return 0; }
+#endif
 #endif
 
 #endif /* __ASM_ARM_SYSTEM_H */
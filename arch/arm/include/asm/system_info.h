@@ -212,6 +212,34 @@ static inline int __pure cpu_architecture(void)
 }
 #endif
 
+#ifdef CONFIG_CPU_64v8
+static inline unsigned long read_id_aa64isar0(void)
+{
+	unsigned long isar0;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+
+	return isar0;
+}
+
+/* Instruction set attribute fields for the v8 Crypto Extensions */
+#define cpu_has_sha1()	(((read_id_aa64isar0() >> 8) & 0xf) != 0)
+#define cpu_has_sha2()	(((read_id_aa64isar0() >> 12) & 0xf) != 0)
+#define cpu_has_crc32()	(((read_id_aa64isar0() >> 16) & 0xf) != 0)
+
+static inline unsigned long read_id_aa64pfr0(void)
+{
+	unsigned long pfr0;
+
+	asm volatile("mrs %0, id_aa64pfr0_el1" : "=r" (pfr0));
+
+	return pfr0;
+}
+
+/* 0xf in the AdvSIMD field means not implemented */
+#define cpu_has_asimd()	(((read_id_aa64pfr0() >> 20) & 0xf) != 0xf)
+#endif
+
 #endif /* !__ASSEMBLY__ */
 
 #endif /* __ASM_ARM_SYSTEM_INFO_H */
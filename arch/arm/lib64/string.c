@@ -1,22 +1,67 @@
 #include <common.h>
+#include <init.h>
 #include <asm/system.h>
+#include <asm/system_info.h>
+#include <linux/sizes.h>
 #include <string.h>
 
 void *__arch_memset(void *dst, int c, __kernel_size_t size);
 void *__arch_memcpy(void * dest, const void *src, size_t count);
 
+void *__asimd_memset(void *dst, int c, __kernel_size_t size);
+void *__asimd_memcpy(void *dest, const void *src, size_t count);
+void *__asimd_memcpy_nt(void *dest, const void *src, size_t count);
+int __asimd_memcmp(const void *cs, const void *ct, size_t count);
+
+/*
+ * Copies larger than this are done with non-temporal accesses. These are
+ * mostly images copied to their final location, which would otherwise
+ * evict everything else from the caches.
+ */
+#define ASIMD_MEMCPY_NT_SIZE	SZ_1M
+
+/* set when the CPU implements ASIMD, which is optional on some cores */
+static int asimd;
+
+static int asimd_string_init(void)
+{
+	asimd = IS_ENABLED(CONFIG_ARM_ASIMD_STRING_FUNCTIONS) && cpu_has_asimd();
+
+	return 0;
+}
+core_initcall(asimd_string_init);
+
 void *memset(void *dst, int c, __kernel_size_t size)
 {
-	if (likely(get_cr() & CR_M))
-		return __arch_memset(dst, c, size);
+	if (unlikely(!(get_cr() & CR_M)))
+		return __default_memset(dst, c, size);
 
-	return __default_memset(dst, c, size);
+	/* zeroing is done with DC ZVA by __arch_memset */
+	if (asimd && c && size >= 64)
+		return __asimd_memset(dst, c, size);
+
+	return __arch_memset(dst, c, size);
 }
 
 void *memcpy(void * dest, const void *src, size_t count)
 {
-	if (likely(get_cr() & CR_M))
-		return __arch_memcpy(dest, src, count);
+	if (unlikely(!(get_cr() & CR_M)))
+		return __default_memcpy(dest, src, count);
+
+	if (asimd && count >= ASIMD_MEMCPY_NT_SIZE)
+		return __asimd_memcpy_nt(dest, src, count);
+	if (asimd && count >= 64)
+		return __asimd_memcpy(dest, src, count);
+
+	return __arch_memcpy(dest, src, count);
+}
 
-	return __default_memcpy(dest, src, count);
-}
\ No newline at end of file
+#ifdef CONFIG_ARM_ASIMD_STRING_FUNCTIONS
+int memcmp(const void *cs, const void *ct, size_t count)
+{
+	if (asimd && count >= 32 && likely(get_cr() & CR_M))
+		return __asimd_memcmp(cs, ct, count);
+
+	return __default_memcmp(cs, ct, count);
+}
+#endif
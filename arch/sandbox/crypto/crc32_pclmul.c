@@ -0,0 +1,130 @@
+/*
+ * CRC32 using the carry-less multiplication of x86 hosts
+ *
+ * Based on the x86 crc32-pclmul code of the Linux kernel which folds the
+ * input with PCLMULQDQ as described in Intel's "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction".
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <common.h>
+#include <crc.h>
+#include <init.h>
+
+#include "sha_ni.h"
+
+#define __pclmul	__attribute__((target("pclmul,sse4.1")))
+
+typedef long long v2di_u __attribute__((vector_size(16), aligned(1)));
+
+/* the folding needs at least four 16 byte blocks */
+#define PCLMUL_MIN_LEN	64
+
+/* x^(32*k) mod P(x) bit reflected, low quadword first */
+static const v2di r2r1 = { 0x0000000154442bd4, 0x00000001c6e41596 };
+static const v2di r4r3 = { 0x00000001751997d0, 0x00000000ccaa009e };
+static const v2di r5 = { 0x0000000163cd6124, 0 };
+static const v2di mask32 = { 0xffffffff, 0 };
+/* the polynomial and its Barrett constant */
+static const v2di rupoly = { 0x00000001db710641, 0x00000001f7011641 };
+
+static inline v2di __pclmul clmul(v2di a, v2di b, const int imm)
+{
+	return __builtin_ia32_pclmulqdq128(a, b, imm);
+}
+
+/* multiply both halves of @x with the constants in @k and add them up */
+static inline v2di __pclmul fold(v2di x, v2di k)
+{
+	return clmul(x, k, 0x00) ^ clmul(x, k, 0x11);
+}
+
+static inline v2di __pclmul load(const u8 *p)
+{
+	return *(const v2di_u *)p;
+}
+
+/* @len is a multiple of 16 and at least PCLMUL_MIN_LEN */
+static uint32_t __pclmul crc32_pclmul_le_16(uint32_t crc, const u8 *p,
+					    unsigned int len)
+{
+	v2di x1, x2, x3, x4, t;
+
+	x1 = load(p) ^ (v2di){ crc, 0 };
+	x2 = load(p + 16);
+	x3 = load(p + 32);
+	x4 = load(p + 48);
+	p += 64;
+	len -= 64;
+
+	/* fold 64 bytes at a time into the four accumulators */
+	while (len >= 64) {
+		x1 = fold(x1, r2r1) ^ load(p);
+		x2 = fold(x2, r2r1) ^ load(p + 16);
+		x3 = fold(x3, r2r1) ^ load(p + 32);
+		x4 = fold(x4, r2r1) ^ load(p + 48);
+		p += 64;
+		len -= 64;
+	}
+
+	/* fold them into a single one */
+	x1 = fold(x1, r4r3) ^ x2;
+	x1 = fold(x1, r4r3) ^ x3;
+	x1 = fold(x1, r4r3) ^ x4;
+
+	while (len >= 16) {
+		x1 = fold(x1, r4r3) ^ load(p);
+		p += 16;
+		len -= 16;
+	}
+
+	/* 128 to 64 bits, this also appends the 32 zero bits of the CRC */
+	x1 = clmul(r4r3, x1, 0x01) ^
+		(v2di)__builtin_ia32_psrldqi128((v2di)x1, 64);
+
+	/* 64 to 32 bits */
+	t = (v2di)__builtin_ia32_psrldqi128((v2di)x1, 32);
+	x1 = clmul(x1 & mask32, r5, 0x00) ^ t;
+
+	/* Barrett reduction to the final remainder */
+	t = x1;
+	x1 = clmul(x1 & mask32, rupoly, 0x10);
+	x1 = clmul(x1 & mask32, rupoly, 0x00) ^ t;
+
+	return ((v4si)x1)[1];
+}
+
+static uint32_t crc32_pclmul(uint32_t crc, const void *buf, unsigned int len)
+{
+	unsigned int n;
+
+	if (len < PCLMUL_MIN_LEN)
+		return crc32_no_comp_generic(crc, buf, len);
+
+	n = len & ~15;
+	crc = crc32_pclmul_le_16(crc, buf, n);
+
+	return crc32_no_comp_generic(crc, buf + n, len - n);
+}
+
+static int crc32_pclmul_supported(void)
+{
+	unsigned int a, b, c, d;
+
+	sha_ni_cpuid(1, &a, &b, &c, &d);
+
+	/* PCLMULQDQ and SSE4.1 */
+	return (c & (1 << 1)) && (c & (1 << 19));
+}
+
+static int crc32_pclmul_init(void)
+{
+	if (crc32_pclmul_supported())
+		crc32_register_arch("crc32-pclmul", crc32_pclmul);
+
+	return 0;
+}
+coredevice_initcall(crc32_pclmul_init);
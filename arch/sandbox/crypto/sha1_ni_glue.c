@@ -0,0 +1,123 @@
+/*
+ * SHA-1 using the x86 SHA extensions of the sandbox host
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <common.h>
+#include <digest.h>
+#include <init.h>
+#include <crypto/sha.h>
+#include <crypto/sha1_base.h>
+#include <crypto/internal.h>
+
+#include "sha_ni.h"
+
+/*
+ * four rounds, with the message schedule for the next but three group.
+ * The instructions expect the first word in the highest lane.
+ */
+#define SHA1_NI_ROUNDS(i, m0, m1, m2, m3)				\
+	do {								\
+		if (i)							\
+			e = __builtin_ia32_sha1nexte(prev, m0);		\
+		else							\
+			e += m0;					\
+		prev = abcd;						\
+		abcd = __builtin_ia32_sha1rnds4(abcd, e, (i) / 5);	\
+		if ((i) < 16) {						\
+			m0 = __builtin_ia32_sha1msg1(m0, m1) ^ m2;	\
+			m0 = __builtin_ia32_sha1msg2(m0, m3);		\
+		}							\
+	} while (0)
+
+static void __sha_ni sha1_ni_transform(struct sha1_state *sst,
+				       u8 const *src, int blocks)
+{
+	const v16qi mask = { 15, 14, 13, 12, 11, 10, 9, 8,
+			     7, 6, 5, 4, 3, 2, 1, 0 };
+	v4si abcd, e, prev, abcd_save, e_save;
+	v4si m0, m1, m2, m3;
+
+	abcd = __builtin_ia32_pshufd(sha_ni_load(&sst->state[0]), 0x1b);
+	e_save = (v4si){ 0, 0, 0, sst->state[4] };
+
+	while (blocks--) {
+		abcd_save = abcd;
+		e = e_save;
+
+		m0 = (v4si)__builtin_ia32_pshufb128((v16qi)sha_ni_load(src), mask);
+		m1 = (v4si)__builtin_ia32_pshufb128((v16qi)sha_ni_load(src + 16), mask);
+		m2 = (v4si)__builtin_ia32_pshufb128((v16qi)sha_ni_load(src + 32), mask);
+		m3 = (v4si)__builtin_ia32_pshufb128((v16qi)sha_ni_load(src + 48), mask);
+
+		SHA1_NI_ROUNDS(0, m0, m1, m2, m3);
+		SHA1_NI_ROUNDS(1, m1, m2, m3, m0);
+		SHA1_NI_ROUNDS(2, m2, m3, m0, m1);
+		SHA1_NI_ROUNDS(3, m3, m0, m1, m2);
+		SHA1_NI_ROUNDS(4, m0, m1, m2, m3);
+		SHA1_NI_ROUNDS(5, m1, m2, m3, m0);
+		SHA1_NI_ROUNDS(6, m2, m3, m0, m1);
+		SHA1_NI_ROUNDS(7, m3, m0, m1, m2);
+		SHA1_NI_ROUNDS(8, m0, m1, m2, m3);
+		SHA1_NI_ROUNDS(9, m1, m2, m3, m0);
+		SHA1_NI_ROUNDS(10, m2, m3, m0, m1);
+		SHA1_NI_ROUNDS(11, m3, m0, m1, m2);
+		SHA1_NI_ROUNDS(12, m0, m1, m2, m3);
+		SHA1_NI_ROUNDS(13, m1, m2, m3, m0);
+		SHA1_NI_ROUNDS(14, m2, m3, m0, m1);
+		SHA1_NI_ROUNDS(15, m3, m0, m1, m2);
+		SHA1_NI_ROUNDS(16, m0, m1, m2, m3);
+		SHA1_NI_ROUNDS(17, m1, m2, m3, m0);
+		SHA1_NI_ROUNDS(18, m2, m3, m0, m1);
+		SHA1_NI_ROUNDS(19, m3, m0, m1, m2);
+
+		e_save = __builtin_ia32_sha1nexte(prev, e_save);
+		abcd += abcd_save;
+		src += SHA1_BLOCK_SIZE;
+	}
+
+	sha_ni_store(&sst->state[0], __builtin_ia32_pshufd(abcd, 0x1b));
+	sst->state[4] = e_save[3];
+}
+
+static int sha1_ni_update(struct digest *desc, const void *data,
+			  unsigned long len)
+{
+	return sha1_base_do_update(desc, data, len, sha1_ni_transform);
+}
+
+static int sha1_ni_final(struct digest *desc, u8 *out)
+{
+	sha1_base_do_finalize(desc, sha1_ni_transform);
+
+	return sha1_base_finish(desc, out);
+}
+
+static struct digest_algo m = {
+	.base = {
+		.name		=	"sha1",
+		.driver_name	=	"sha1-ni",
+		.priority	=	200,
+		.algo		=	HASH_ALGO_SHA1,
+	},
+
+	.init	=	sha1_base_init,
+	.update	=	sha1_ni_update,
+	.final	=	sha1_ni_final,
+	.digest	=	digest_generic_digest,
+	.verify	=	digest_generic_verify,
+	.length	=	SHA1_DIGEST_SIZE,
+	.ctx_length =	sizeof(struct sha1_state),
+};
+
+static int sha1_ni_mod_init(void)
+{
+	if (!sha_ni_supported())
+		return 0;
+
+	return digest_algo_register(&m);
+}
+coredevice_initcall(sha1_ni_mod_init);
@@ -0,0 +1,168 @@
+/*
+ * SHA-224/SHA-256 using the x86 SHA extensions of the sandbox host
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <common.h>
+#include <digest.h>
+#include <init.h>
+#include <crypto/sha.h>
+#include <crypto/sha256_base.h>
+#include <crypto/internal.h>
+
+#include "sha_ni.h"
+
+static const u32 sha256_k[64] __aligned(16) = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/* four rounds, with the message schedule for the next but three group */
+#define SHA256_NI_ROUNDS(i, m0, m1, m2, m3)				\
+	do {								\
+		v4si k = m0 + *(const v4si *)&sha256_k[4 * (i)];	\
+									\
+		state1 = __builtin_ia32_sha256rnds2(state1, state0, k);	\
+		k = __builtin_ia32_pshufd(k, 0x0e);			\
+		state0 = __builtin_ia32_sha256rnds2(state0, state1, k);	\
+		if ((i) < 12) {						\
+			m0 = __builtin_ia32_sha256msg1(m0, m1);		\
+			m0 += (v4si)__builtin_ia32_palignr128((v2di)m3,	\
+						(v2di)m2, 32);		\
+			m0 = __builtin_ia32_sha256msg2(m0, m3);		\
+		}							\
+	} while (0)
+
+static void __sha_ni sha256_ni_transform(struct sha256_state *sst,
+					 u8 const *src, int blocks)
+{
+	const v16qi mask = { 3, 2, 1, 0, 7, 6, 5, 4,
+			     11, 10, 9, 8, 15, 14, 13, 12 };
+	v4si state0, state1, tmp, abef, cdgh;
+	v4si m0, m1, m2, m3;
+
+	/* the rounds instructions operate on ABEF and CDGH */
+	tmp = __builtin_ia32_pshufd(sha_ni_load(&sst->state[0]), 0xb1);
+	state1 = __builtin_ia32_pshufd(sha_ni_load(&sst->state[4]), 0x1b);
+	state0 = (v4si)__builtin_ia32_palignr128((v2di)tmp, (v2di)state1, 64);
+	state1 = (v4si)__builtin_ia32_pblendw128((v8hi)state1, (v8hi)tmp, 0xf0);
+
+	while (blocks--) {
+		abef = state0;
+		cdgh = state1;
+
+		m0 = (v4si)__builtin_ia32_pshufb128((v16qi)sha_ni_load(src), mask);
+		m1 = (v4si)__builtin_ia32_pshufb128((v16qi)sha_ni_load(src + 16), mask);
+		m2 = (v4si)__builtin_ia32_pshufb128((v16qi)sha_ni_load(src + 32), mask);
+		m3 = (v4si)__builtin_ia32_pshufb128((v16qi)sha_ni_load(src + 48), mask);
+
+		SHA256_NI_ROUNDS(0, m0, m1, m2, m3);
+		SHA256_NI_ROUNDS(1, m1, m2, m3, m0);
+		SHA256_NI_ROUNDS(2, m2, m3, m0, m1);
+		SHA256_NI_ROUNDS(3, m3, m0, m1, m2);
+		SHA256_NI_ROUNDS(4, m0, m1, m2, m3);
+		SHA256_NI_ROUNDS(5, m1, m2, m3, m0);
+		SHA256_NI_ROUNDS(6, m2, m3, m0, m1);
+		SHA256_NI_ROUNDS(7, m3, m0, m1, m2);
+		SHA256_NI_ROUNDS(8, m0, m1, m2, m3);
+		SHA256_NI_ROUNDS(9, m1, m2, m3, m0);
+		SHA256_NI_ROUNDS(10, m2, m3, m0, m1);
+		SHA256_NI_ROUNDS(11, m3, m0, m1, m2);
+		SHA256_NI_ROUNDS(12, m0, m1, m2, m3);
+		SHA256_NI_ROUNDS(13, m1, m2, m3, m0);
+		SHA256_NI_ROUNDS(14, m2, m3, m0, m1);
+		SHA256_NI_ROUNDS(15, m3, m0, m1, m2);
+
+		state0 += abef;
+		state1 += cdgh;
+		src += SHA256_BLOCK_SIZE;
+	}
+
+	/* back to ABCD and EFGH */
+	tmp = __builtin_ia32_pshufd(state0, 0x1b);
+	state1 = __builtin_ia32_pshufd(state1, 0xb1);
+	state0 = (v4si)__builtin_ia32_pblendw128((v8hi)tmp, (v8hi)state1, 0xf0);
+	state1 = (v4si)__builtin_ia32_palignr128((v2di)state1, (v2di)tmp, 64);
+
+	sha_ni_store(&sst->state[0], state0);
+	sha_ni_store(&sst->state[4], state1);
+}
+
+static int sha256_ni_update(struct digest *desc, const void *data,
+			    unsigned long len)
+{
+	return sha256_base_do_update(desc, data, len, sha256_ni_transform);
+}
+
+static int sha256_ni_final(struct digest *desc, u8 *out)
+{
+	sha256_base_do_finalize(desc, sha256_ni_transform);
+
+	return sha256_base_finish(desc, out);
+}
+
+static struct digest_algo sha224 = {
+	.base = {
+		.name		=	"sha224",
+		.driver_name	=	"sha224-ni",
+		.priority	=	200,
+		.algo		=	HASH_ALGO_SHA224,
+	},
+
+	.length	=	SHA224_DIGEST_SIZE,
+	.init	=	sha224_base_init,
+	.update	=	sha256_ni_update,
+	.final	=	sha256_ni_final,
+	.digest	=	digest_generic_digest,
+	.verify	=	digest_generic_verify,
+	.ctx_length =	sizeof(struct sha256_state),
+};
+
+static struct digest_algo sha256 = {
+	.base = {
+		.name		=	"sha256",
+		.driver_name	=	"sha256-ni",
+		.priority	=	200,
+		.algo		=	HASH_ALGO_SHA256,
+	},
+
+	.length	=	SHA256_DIGEST_SIZE,
+	.init	=	sha256_base_init,
+	.update	=	sha256_ni_update,
+	.final	=	sha256_ni_final,
+	.digest	=	digest_generic_digest,
+	.verify	=	digest_generic_verify,
+	.ctx_length =	sizeof(struct sha256_state),
+};
+
+static int sha256_ni_mod_init(void)
+{
+	int ret;
+
+	if (!sha_ni_supported())
+		return 0;
+
+	ret = digest_algo_register(&sha224);
+	if (ret)
+		return ret;
+
+	return digest_algo_register(&sha256);
+}
+coredevice_initcall(sha256_ni_mod_init);
@@ -0,0 +1,64 @@
+/*
+ * Helpers for the x86 SHA extensions of the sandbox host
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __SANDBOX_SHA_NI_H
+#define __SANDBOX_SHA_NI_H
+
+#if !defined(__x86_64__) && !defined(__i386__)
+#error "the SHA extensions are only available on x86 hosts"
+#endif
+
+typedef int v4si __attribute__((vector_size(16)));
+typedef long long v2di __attribute__((vector_size(16)));
+typedef short v8hi __attribute__((vector_size(16)));
+typedef char v16qi __attribute__((vector_size(16)));
+/* for loads and stores that may not be 16 byte aligned */
+typedef int v4si_u __attribute__((vector_size(16), aligned(1)));
+
+/* enable the instructions for a single function, the rest is built without */
+#define __sha_ni	__attribute__((target("sha,sse4.1")))
+
+static inline void sha_ni_cpuid(unsigned int leaf, unsigned int *a,
+				unsigned int *b, unsigned int *c,
+				unsigned int *d)
+{
+	asm volatile("cpuid"
+		     : "=a" (*a), "=b" (*b), "=c" (*c), "=d" (*d)
+		     : "0" (leaf), "2" (0));
+}
+
+static inline int sha_ni_supported(void)
+{
+	unsigned int a, b, c, d;
+
+	sha_ni_cpuid(0, &a, &b, &c, &d);
+	if (a < 7)
+		return 0;
+
+	/* SSE4.1 */
+	sha_ni_cpuid(1, &a, &b, &c, &d);
+	if (!(c & (1 << 19)))
+		return 0;
+
+	/* SHA */
+	sha_ni_cpuid(7, &a, &b, &c, &d);
+
+	return !!(b & (1 << 29));
+}
+
+static inline v4si __sha_ni sha_ni_load(const void *p)
+{
+	return *(const v4si_u *)p;
+}
+
+static inline void __sha_ni sha_ni_store(void *p, v4si v)
+{
+	*(v4si_u *)p = v;
+}
+
+#endif /* __SANDBOX_SHA_NI_H */
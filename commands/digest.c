@@ -14,15 +14,41 @@
 #include <digest.h>
 #include <getopt.h>
 #include <libfile.h>
+#include <clock.h>
+#include <asm-generic/div64.h>
 
 #include "internal.h"
 
-int __do_digest(struct digest *d, unsigned char *sig,
+static void digest_print_throughput(const char *filename, loff_t start,
+				    loff_t size, uint64_t starttime)
+{
+	uint64_t ns = get_time_ns() - starttime;
+	uint64_t ms = ns;
+	struct stat s;
+
+	do_div(ms, MSECOND);
+
+	/* the area may extend beyond the end of the file */
+	if (!stat(filename, &s) && s.st_size != FILESIZE_MAX &&
+	    (size < 0 || start + size > s.st_size))
+		size = max_t(loff_t, s.st_size - start, 0);
+
+	if (size < 0) {
+		printf("digest took %llums\n", ms);
+		return;
+	}
+
+	printf("%lld bytes in %llums: %s\n", size, ms,
+	       rate_human_readable(size, ns));
+}
+
+int __do_digest(struct digest *d, unsigned char *sig, int throughput,
 		       int argc, char *argv[])
 {
 	int ret = COMMAND_ERROR_USAGE;
 	int i;
 	unsigned char *hash;
+	uint64_t starttime;
 
 	if (argc < 1)
 		goto err;
@@ -48,6 +74,8 @@ int __do_digest(struct digest *d, unsigned char *sig,
 			}
 		}
 
+		starttime = get_time_ns();
+
 		ret = digest_file_window(d, filename,
 					 hash, sig, start, size);
 		if (ret < 0) {
@@ -64,6 +92,10 @@ int __do_digest(struct digest *d, unsigned char *sig,
 
 				puts("\n");
 			}
+
+			if (throughput)
+				digest_print_throughput(filename, start, size,
+							starttime);
 		}
 
 		argv++;
@@ -95,13 +127,14 @@ static int do_digest(int argc, char *argv[])
 	size_t keylen = 0;
 	size_t digestlen = 0;
 	char *algo = NULL;
+	int throughput = 0;
 	int opt;
 	int ret = COMMAND_ERROR;
 
 	if (argc < 2)
 		return COMMAND_ERROR_USAGE;
 
-	while((opt = getopt(argc, argv, "a:k:K:s:S:")) > 0) {
+	while((opt = getopt(argc, argv, "a:k:K:s:S:t")) > 0) {
 		switch(opt) {
 		case 'k':
 			key = optarg;
@@ -120,6 +153,9 @@ static int do_digest(int argc, char *argv[])
 		case 'S':
 			sigfile = optarg;
 			break;
+		case 't':
+			throughput = 1;
+			break;
 		}
 	}
 
@@ -180,7 +216,7 @@ static int do_digest(int argc, char *argv[])
 		}
 	}
 
-	ret = __do_digest(d, sig, argc, argv);
+	ret = __do_digest(d, sig, throughput, argc, argv);
 	free(tmp_sig);
 	return ret;
 
@@ -197,12 +233,13 @@ BAREBOX_CMD_HELP_OPT ("-k <key>\t",   "use supplied <key> (ASCII or hex) for MAC
 BAREBOX_CMD_HELP_OPT ("-K <file>\t",  "use key from <file> (binary) for MAC")
 BAREBOX_CMD_HELP_OPT ("-s <hex>\t",   "verify data against supplied <hex> (hash, MAC or signature)")
 BAREBOX_CMD_HELP_OPT ("-S <file>\t",  "verify data against <file> (hash, MAC or signature)")
+BAREBOX_CMD_HELP_OPT ("-t\t",         "print throughput")
 BAREBOX_CMD_HELP_END
 
 BAREBOX_CMD_START(digest)
 	.cmd		= do_digest,
 	BAREBOX_CMD_DESC("calculate digest")
-	BAREBOX_CMD_OPTS("-a <algo> [-k <key> | -K <file>] [-s <sig> | -S <file>] FILE|AREA")
+	BAREBOX_CMD_OPTS("-a <algo> [-k <key> | -K <file>] [-s <sig> | -S <file>] [-t] FILE|AREA")
 	BAREBOX_CMD_GROUP(CMD_GRP_FILE)
 	BAREBOX_CMD_HELP(cmd_digest_help)
 	BAREBOX_CMD_USAGE(prints_algo_help)
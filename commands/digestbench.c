@@ -0,0 +1,163 @@
+/*
+ * digestbench.c - measure the throughput of the digest implementations
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <digest.h>
+#include <getopt.h>
+#include <malloc.h>
+#include <clock.h>
+#include <errno.h>
+#include <linux/sizes.h>
+
+static int digestbench_match(struct digest_algo *algo, int argc, char *argv[])
+{
+	int i;
+
+	if (!argc)
+		return 1;
+
+	for (i = 0; i < argc; i++) {
+		if (!strcmp(argv[i], algo->base.name) ||
+		    !strcmp(argv[i], algo->base.driver_name))
+			return 1;
+	}
+
+	return 0;
+}
+
+static int digestbench_one(struct digest_algo *algo, const void *buf,
+			   unsigned long size, uint64_t duration)
+{
+	struct digest *d;
+	unsigned char *hash;
+	uint64_t start, ns, bytes = 0;
+	int ret;
+
+	d = digest_alloc(algo->base.driver_name);
+	if (!d)
+		return -ENOMEM;
+
+	hash = xzalloc(digest_length(d));
+
+	start = get_time_ns();
+
+	ret = digest_init(d);
+	if (ret)
+		goto out;
+
+	/* hash the buffer over and over until the time is up */
+	do {
+		ret = digest_update(d, buf, size);
+		if (ret)
+			goto out;
+		bytes += size;
+	} while (!is_timeout(start, duration));
+
+	ret = digest_final(d, hash);
+	if (ret)
+		goto out;
+
+	ns = get_time_ns() - start;
+
+	printf("%-15s %-20s %8d %16s\n", algo->base.name,
+	       algo->base.driver_name, algo->base.priority,
+	       rate_human_readable(bytes, ns));
+out:
+	free(hash);
+	digest_free(d);
+
+	return ret;
+}
+
+static int do_digestbench(int argc, char *argv[])
+{
+	struct digest_algo *algo;
+	unsigned long size = SZ_64K;
+	uint64_t duration = SECOND;
+	void *buf;
+	int opt, i, ret = 0;
+
+	while ((opt = getopt(argc, argv, "s:T:")) > 0) {
+		switch (opt) {
+		case 's':
+			size = strtoul_suffix(optarg, NULL, 0);
+			break;
+		case 'T':
+			duration = simple_strtoull(optarg, NULL, 0) * MSECOND;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (!size)
+		return COMMAND_ERROR_USAGE;
+
+	argc -= optind;
+	argv += optind;
+
+	buf = malloc(size);
+	if (!buf) {
+		printf("cannot allocate %lu bytes\n", size);
+		return COMMAND_ERROR;
+	}
+
+	for (i = 0; i < size; i++)
+		((u8 *)buf)[i] = i;
+
+	printf("%-15s %-20s %8s %16s\n", "name", "driver", "priority",
+	       "throughput");
+
+	for_each_digest_algo(algo) {
+		/* keyed algorithms cannot be measured without a key */
+		if (algo->base.flags & DIGEST_ALGO_NEED_KEY)
+			continue;
+
+		if (!digestbench_match(algo, argc, argv))
+			continue;
+
+		ret = digestbench_one(algo, buf, size, duration);
+		if (ret) {
+			printf("%s: %s\n", algo->base.driver_name,
+			       strerror(-ret));
+			break;
+		}
+
+		if (ctrlc()) {
+			ret = -EINTR;
+			break;
+		}
+	}
+
+	free(buf);
+
+	return ret ? COMMAND_ERROR : 0;
+}
+
+BAREBOX_CMD_HELP_START(digestbench)
+BAREBOX_CMD_HELP_TEXT("Measure the throughput of all registered digest implementations,")
+BAREBOX_CMD_HELP_TEXT("or of those given by algorithm or driver name.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-s <size>", "size of the buffer passed to each update (default 64k)")
+BAREBOX_CMD_HELP_OPT ("-T <ms>",   "time to spend on each implementation (default 1000)")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(digestbench)
+	.cmd		= do_digestbench,
+	BAREBOX_CMD_DESC("measure digest throughput")
+	BAREBOX_CMD_OPTS("[-s <size>] [-T <ms>] [ALGO...]")
+	BAREBOX_CMD_GROUP(CMD_GRP_MISC)
+	BAREBOX_CMD_HELP(cmd_digestbench_help)
+BAREBOX_CMD_END
@@ -34,14 +34,18 @@ static int do_hash(char *algo, int argc, char *argv[])
 	struct digest *d;
 	unsigned char *key = NULL;
 	size_t keylen = 0;
+	int throughput = 0;
 	int opt, ret;
 
-	while ((opt = getopt(argc, argv, "h:")) > 0) {
+	while ((opt = getopt(argc, argv, "h:t")) > 0) {
 		switch(opt) {
 		case 'h':
 			key = optarg;
 			keylen = strlen(key);
 			break;
+		case 't':
+			throughput = 1;
+			break;
 		default:
 			return COMMAND_ERROR_USAGE;
 		}
@@ -66,7 +70,7 @@ static int do_hash(char *algo, int argc, char *argv[])
 	argc -= optind;
 	argv += optind;
 
-	return __do_digest(d, NULL, argc, argv);
+	return __do_digest(d, NULL, throughput, argc, argv);
 }
 
 #ifdef CONFIG_CMD_MD5SUM
@@ -78,12 +82,15 @@ static int do_md5(int argc, char *argv[])
 
 BAREBOX_CMD_HELP_START(md5sum)
 BAREBOX_CMD_HELP_TEXT("Calculate a MD5 digest over a FILE or a memory area.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-t",  "print throughput")
 BAREBOX_CMD_HELP_END
 
 BAREBOX_CMD_START(md5sum)
 	.cmd		= do_md5,
 	BAREBOX_CMD_DESC("calculate MD5 checksum")
-	BAREBOX_CMD_OPTS("FILE|AREA...")
+	BAREBOX_CMD_OPTS("[-t] FILE|AREA...")
 	BAREBOX_CMD_GROUP(CMD_GRP_FILE)
 	BAREBOX_CMD_HELP(cmd_md5sum_help)
 BAREBOX_CMD_END
@@ -99,12 +106,15 @@ static int do_sha1(int argc, char *argv[])
 
 BAREBOX_CMD_HELP_START(sha1sum)
 BAREBOX_CMD_HELP_TEXT("Calculate a SHA1 digest over a FILE or a memory area.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-t",  "print throughput")
 BAREBOX_CMD_HELP_END
 
 BAREBOX_CMD_START(sha1sum)
 	.cmd		= do_sha1,
 	BAREBOX_CMD_DESC("calculate SHA1 digest")
-	BAREBOX_CMD_OPTS("FILE|AREA")
+	BAREBOX_CMD_OPTS("[-t] FILE|AREA")
 	BAREBOX_CMD_GROUP(CMD_GRP_FILE)
 	BAREBOX_CMD_HELP(cmd_sha1sum_help)
 BAREBOX_CMD_END
@@ -120,12 +130,15 @@ static int do_sha224(int argc, char *argv[])
 
 BAREBOX_CMD_HELP_START(sha224sum)
 BAREBOX_CMD_HELP_TEXT("Calculate a SHA224 digest over a FILE or a memory area.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-t",  "print throughput")
 BAREBOX_CMD_HELP_END
 
 BAREBOX_CMD_START(sha224sum)
 	.cmd		= do_sha224,
 	BAREBOX_CMD_DESC("calculate SHA224 digest")
-	BAREBOX_CMD_OPTS("FILE|AREA")
+	BAREBOX_CMD_OPTS("[-t] FILE|AREA")
 	BAREBOX_CMD_GROUP(CMD_GRP_FILE)
 	BAREBOX_CMD_HELP(cmd_sha224sum_help)
 BAREBOX_CMD_END
@@ -141,12 +154,15 @@ static int do_sha256(int argc, char *argv[])
 
 BAREBOX_CMD_HELP_START(sha256sum)
 BAREBOX_CMD_HELP_TEXT("Calculate a SHA256 digest over a FILE or a memory area.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-t",  "print throughput")
 BAREBOX_CMD_HELP_END
 
 BAREBOX_CMD_START(sha256sum)
 	.cmd		= do_sha256,
 	BAREBOX_CMD_DESC("calculate SHA256 digest")
-	BAREBOX_CMD_OPTS("FILE|AREA")
+	BAREBOX_CMD_OPTS("[-t] FILE|AREA")
 	BAREBOX_CMD_GROUP(CMD_GRP_FILE)
 	BAREBOX_CMD_HELP(cmd_sha256sum_help)
 BAREBOX_CMD_END
@@ -162,12 +178,15 @@ static int do_sha384(int argc, char *argv[])
 
 BAREBOX_CMD_HELP_START(sha384sum)
 BAREBOX_CMD_HELP_TEXT("Calculate a SHA384 digest over a FILE or a memory area.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-t",  "print throughput")
 BAREBOX_CMD_HELP_END
 
 BAREBOX_CMD_START(sha384sum)
 	.cmd		= do_sha384,
 	BAREBOX_CMD_DESC("calculate SHA384 digest")
-	BAREBOX_CMD_OPTS("FILE|AREA")
+	BAREBOX_CMD_OPTS("[-t] FILE|AREA")
 	BAREBOX_CMD_GROUP(CMD_GRP_FILE)
 	BAREBOX_CMD_HELP(cmd_sha384sum_help)
 BAREBOX_CMD_END
@@ -183,12 +202,15 @@ static int do_sha512(int argc, char *argv[])
 
 BAREBOX_CMD_HELP_START(sha512sum)
 BAREBOX_CMD_HELP_TEXT("Calculate a SHA512 digest over a FILE or a memory area.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-t",  "print throughput")
 BAREBOX_CMD_HELP_END
 
 BAREBOX_CMD_START(sha512sum)
 	.cmd		= do_sha512,
 	BAREBOX_CMD_DESC("calculate SHA512 digest")
-	BAREBOX_CMD_OPTS("FILE|AREA")
+	BAREBOX_CMD_OPTS("[-t] FILE|AREA")
 	BAREBOX_CMD_GROUP(CMD_GRP_FILE)
 	BAREBOX_CMD_HELP(cmd_sha512sum_help)
 BAREBOX_CMD_END
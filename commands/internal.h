@@ -1,2 +1,2 @@
-int __do_digest(struct digest *d, unsigned char *sig,
+int __do_digest(struct digest *d, unsigned char *sig, int throughput,
 		       int argc, char *argv[]);
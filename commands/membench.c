@@ -0,0 +1,212 @@
+/*
+ * membench.c - measure the throughput of memcpy, memset and memcmp
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <getopt.h>
+#include <malloc.h>
+#include <clock.h>
+#include <errno.h>
+#include <linux/sizes.h>
+#include <asm-generic/div64.h>
+
+/* the destination or source offsets from a 64 byte aligned address */
+static const struct {
+	const char *name;
+	int dst, src;
+} membench_aligns[] = {
+	{ "aligned", 0, 0 },
+	{ "dst+1", 1, 0 },
+	{ "src+1", 0, 1 },
+};
+
+enum membench_func {
+	MEMBENCH_MEMCPY,
+	MEMBENCH_MEMSET,
+	MEMBENCH_MEMCMP,
+};
+
+static const char * const membench_names[] = {
+	[MEMBENCH_MEMCPY] = "memcpy",
+	[MEMBENCH_MEMSET] = "memset",
+	[MEMBENCH_MEMCMP] = "memcmp",
+};
+
+static void membench_call(enum membench_func func, void *dst, void *src,
+			  size_t size)
+{
+	switch (func) {
+	case MEMBENCH_MEMCPY:
+		memcpy(dst, src, size);
+		break;
+	case MEMBENCH_MEMSET:
+		memset(dst, 0x5a, size);
+		break;
+	case MEMBENCH_MEMCMP:
+		memcmp(dst, src, size);
+		break;
+	}
+}
+
+/* returns the throughput in 1/100 GB/s */
+static uint64_t membench_one(enum membench_func func, void *dst, void *src,
+			     size_t size, uint64_t duration)
+{
+	uint64_t start, ns, rate, bytes = 0;
+	/* check the time only every 256k, reading it is not free */
+	int i, loops = max_t(size_t, SZ_256K / size, 1);
+
+	/* memcmp has to run over the whole buffer */
+	if (func == MEMBENCH_MEMCMP)
+		memcpy(dst, src, size);
+
+	start = get_time_ns();
+
+	do {
+		for (i = 0; i < loops; i++)
+			membench_call(func, dst, src, size);
+		bytes += (uint64_t)size * loops;
+	} while (!is_timeout(start, duration));
+
+	ns = get_time_ns() - start;
+
+	/* bytes per ns is GB/s */
+	rate = bytes * 100;
+	do_div(rate, max_t(uint64_t, ns, 1));
+
+	return rate;
+}
+
+static int membench_match(enum membench_func func, int argc, char *argv[])
+{
+	int i;
+
+	if (!argc)
+		return 1;
+
+	for (i = 0; i < argc; i++)
+		if (!strcmp(argv[i], membench_names[func]))
+			return 1;
+
+	return 0;
+}
+
+static int do_membench(int argc, char *argv[])
+{
+	unsigned long max = SZ_2M, size;
+	uint64_t duration = 100 * MSECOND, rate;
+	void *dbuf, *sbuf;
+	int opt, i, func, frac, ret = 0;
+
+	while ((opt = getopt(argc, argv, "s:T:")) > 0) {
+		switch (opt) {
+		case 's':
+			max = strtoul_suffix(optarg, NULL, 0);
+			break;
+		case 'T':
+			duration = simple_strtoull(optarg, NULL, 0) * MSECOND;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (max < 64)
+		return COMMAND_ERROR_USAGE;
+
+	argc -= optind;
+	argv += optind;
+
+	for (i = 0; i < argc; i++) {
+		for (func = 0; func < ARRAY_SIZE(membench_names); func++)
+			if (!strcmp(argv[i], membench_names[func]))
+				break;
+		if (func == ARRAY_SIZE(membench_names)) {
+			printf("unknown function %s\n", argv[i]);
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	dbuf = memalign(64, max + 64);
+	sbuf = memalign(64, max + 64);
+	if (!dbuf || !sbuf) {
+		printf("cannot allocate %lu bytes\n", max);
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < max + 64; i++)
+		((u8 *)sbuf)[i] = i;
+
+	printf("%-8s %10s", "function", "size");
+	for (i = 0; i < ARRAY_SIZE(membench_aligns); i++)
+		printf(" %10s", membench_aligns[i].name);
+	printf("   (GB/s)\n");
+
+	for (func = 0; func < ARRAY_SIZE(membench_names); func++) {
+		if (!membench_match(func, argc, argv))
+			continue;
+
+		for (size = 64; size <= max; size *= 8) {
+			printf("%-8s %10lu", membench_names[func], size);
+
+			for (i = 0; i < ARRAY_SIZE(membench_aligns); i++) {
+				/* memset has no source */
+				if (func == MEMBENCH_MEMSET &&
+				    membench_aligns[i].src) {
+					printf(" %10s", "-");
+					continue;
+				}
+
+				rate = membench_one(func,
+						dbuf + membench_aligns[i].dst,
+						sbuf + membench_aligns[i].src,
+						size, duration);
+				frac = do_div(rate, 100);
+				printf(" %7llu.%02d", rate, frac);
+
+				if (ctrlc()) {
+					ret = -EINTR;
+					printf("\n");
+					goto out;
+				}
+			}
+
+			printf("\n");
+		}
+	}
+
+out:
+	free(dbuf);
+	free(sbuf);
+
+	return ret ? COMMAND_ERROR : 0;
+}
+
+BAREBOX_CMD_HELP_START(membench)
+BAREBOX_CMD_HELP_TEXT("Measure the throughput of memcpy, memset and memcmp, or of the")
+BAREBOX_CMD_HELP_TEXT("given ones, for sizes from 64 bytes up to the maximum size, with")
+BAREBOX_CMD_HELP_TEXT("aligned buffers and with the destination or source misaligned.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-s <size>", "maximum size (default 2M)")
+BAREBOX_CMD_HELP_OPT ("-T <ms>",   "time to spend on each measurement (default 100)")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(membench)
+	.cmd		= do_membench,
+	BAREBOX_CMD_DESC("measure memcpy/memset/memcmp throughput")
+	BAREBOX_CMD_OPTS("[-s <size>] [-T <ms>] [FUNC...]")
+	BAREBOX_CMD_GROUP(CMD_GRP_MEM)
+	BAREBOX_CMD_HELP(cmd_membench_help)
+BAREBOX_CMD_END
@@ -108,14 +108,14 @@ static int do_memcmp(int argc, char *argv[])
 			goto out;
 		}
 
-		for (i = 0; i < now; i++) {
-			if (mem_rw_buf[i] != rw_buf1[i]) {
-				printf("files differ at offset %d\n", offset);
-				goto out;
-			}
-			offset++;
+		if (memcmp(mem_rw_buf, rw_buf1, now)) {
+			for (i = 0; mem_rw_buf[i] == rw_buf1[i]; i++)
+				;
+			printf("files differ at offset %d\n", offset + i);
+			goto out;
 		}
 
+		offset += now;
 		count -= now;
 	}
 
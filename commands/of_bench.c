@@ -0,0 +1,163 @@
+/*
+ * of_bench.c - measure devicetree lookups
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <libfile.h>
+#include <malloc.h>
+#include <clock.h>
+#include <errno.h>
+#include <getopt.h>
+#include <of.h>
+#include <linux/err.h>
+#include <asm-generic/div64.h>
+
+static void of_bench_print(const char *what, int count, int found,
+			   uint64_t ns)
+{
+	uint64_t per = ns;
+
+	do_div(per, max(count, 1));
+	do_div(ns, 1000);
+
+	printf("%-8s %8d lookups, %8d found, %8llu us, %6llu ns each\n",
+	       what, count, found, ns, per);
+}
+
+/*
+ * Resolve every phandle reference of the given property, the way drivers
+ * resolve their clocks, gpios and the like when probing.
+ */
+static void of_bench_phandle(struct device_node *root, const char *propname)
+{
+	struct device_node *np;
+	const __be32 *list;
+	uint64_t start, ns = 0;
+	int i, len, count = 0, found = 0;
+
+	list_for_each_entry(np, &root->list, list) {
+		list = of_get_property(np, propname, &len);
+		if (!list)
+			continue;
+
+		start = get_time_ns();
+
+		for (i = 0; i < len / 4; i++) {
+			if (of_find_node_by_phandle_from(be32_to_cpu(list[i]),
+							 root))
+				found++;
+			count++;
+		}
+
+		ns += get_time_ns() - start;
+	}
+
+	of_bench_print("phandle", count, found, ns);
+}
+
+/* look up every node by its full path */
+static void of_bench_path(struct device_node *root)
+{
+	struct device_node *np;
+	uint64_t start, ns = 0;
+	int count = 0, found = 0;
+
+	list_for_each_entry(np, &root->list, list) {
+		start = get_time_ns();
+
+		if (of_find_node_by_path_from(root, np->full_name) == np)
+			found++;
+		count++;
+
+		ns += get_time_ns() - start;
+	}
+
+	of_bench_print("path", count, found, ns);
+}
+
+static int do_of_bench(int argc, char *argv[])
+{
+	struct device_node *root, *of_free = NULL;
+	const char *propname = "phandle";
+	char *dtbfile = NULL;
+	size_t size;
+	void *fdt;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:p:")) > 0) {
+		switch (opt) {
+		case 'f':
+			dtbfile = optarg;
+			break;
+		case 'p':
+			propname = optarg;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (dtbfile) {
+		fdt = read_file(dtbfile, &size);
+		if (!fdt) {
+			printf("unable to read %s: %s\n", dtbfile, strerror(errno));
+			return COMMAND_ERROR;
+		}
+
+		root = of_unflatten_dtb(fdt);
+
+		free(fdt);
+
+		if (IS_ERR(root)) {
+			printf("unable to unflatten %s: %s\n", dtbfile,
+			       strerrorp(root));
+			return COMMAND_ERROR;
+		}
+
+		of_free = root;
+	} else {
+		root = of_get_root_node();
+		if (!root) {
+			printf("no devicetree\n");
+			return COMMAND_ERROR;
+		}
+	}
+
+	of_bench_phandle(root, propname);
+	of_bench_path(root);
+
+	if (of_free)
+		of_delete_node(of_free);
+
+	return 0;
+}
+
+BAREBOX_CMD_HELP_START(of_bench)
+BAREBOX_CMD_HELP_TEXT("Measure the time needed to look up devicetree nodes by phandle")
+BAREBOX_CMD_HELP_TEXT("and by path. All phandles found in the given property of all")
+BAREBOX_CMD_HELP_TEXT("nodes are resolved, with the default \"phandle\" property each")
+BAREBOX_CMD_HELP_TEXT("node is looked up by its own phandle. Every node is also looked up")
+BAREBOX_CMD_HELP_TEXT("by its full path.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-f <dtb>", "work on <dtb> instead of the internal devicetree")
+BAREBOX_CMD_HELP_OPT ("-p <prop>", "resolve the phandles in <prop> (default phandle)")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(of_bench)
+	.cmd		= do_of_bench,
+	BAREBOX_CMD_DESC("measure devicetree lookups")
+	BAREBOX_CMD_OPTS("[-f <dtb>] [-p <prop>]")
+	BAREBOX_CMD_GROUP(CMD_GRP_MISC)
+	BAREBOX_CMD_HELP(cmd_of_bench_help)
+BAREBOX_CMD_END
@@ -24,6 +24,7 @@
 #include <command.h>
 #include <fs.h>
 #include <malloc.h>
+#include <arena.h>
 #include <complete.h>
 #include <linux/ctype.h>
 #include <asm/byteorder.h>
@@ -267,12 +268,13 @@ static int do_of_property_set_now(struct device_node *root, const char *path,
 	pp = of_find_property(node, propname, NULL);
 
 	if (pp) {
-		free(pp->value);
+		arena_free(pp->value);
 		pp->value_const = NULL;
 
-		/* limit property data to the actual size */
+		/* the caller keeps data, the node may be freed with its arena */
 		if (len)
-			pp->value = xrealloc(data, len);
+			pp->value = memcpy(arena_alloc(node->arena, len), data,
+					   len);
 		else
 			pp->value = NULL;
 
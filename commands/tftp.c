@@ -25,24 +25,48 @@
 #include <net.h>
 #include <libbb.h>
 #include <libfile.h>
+#include <clock.h>
+#include <asm-generic/div64.h>
 
 #define TFTP_MOUNT_PATH	"/.tftp_tmp_path"
 
+static void tftp_print_throughput(const char *file, uint64_t start)
+{
+	struct stat s;
+	uint64_t ns = get_time_ns() - start;
+	uint64_t ms = ns;
+
+	do_div(ms, MSECOND);
+
+	if (stat(file, &s) || s.st_size == FILESIZE_MAX) {
+		printf("transfer took %llums\n", ms);
+		return;
+	}
+
+	printf("%lld bytes in %llums: %s\n", s.st_size, ms,
+	       rate_human_readable(s.st_size, ns));
+}
+
 static int do_tftpb(int argc, char *argv[])
 {
 	char *source, *dest, *freep;
 	int opt;
 	unsigned long flags;
 	int tftp_push = 0;
+	int throughput = 0;
+	uint64_t start;
 	int ret;
 	IPaddr_t ip;
 	char ip4_str[sizeof("255.255.255.255")];
 
-	while ((opt = getopt(argc, argv, "p")) > 0) {
+	while ((opt = getopt(argc, argv, "pt")) > 0) {
 		switch(opt) {
 		case 'p':
 			tftp_push = 1;
 			break;
+		case 't':
+			throughput = 1;
+			break;
 		default:
 			return COMMAND_ERROR_USAGE;
 		}
@@ -81,7 +105,12 @@ static int do_tftpb(int argc, char *argv[])
 
 	debug("%s: %s -> %s\n", __func__, source, dest);
 
-	ret = copy_file(source, dest, 1);
+	start = get_time_ns();
+
+	ret = copy_file(source, dest, !throughput);
+
+	if (!ret && throughput)
+		tftp_print_throughput(source, start);
 
 	umount(TFTP_MOUNT_PATH);
 
@@ -100,12 +129,15 @@ BAREBOX_CMD_HELP_TEXT("server address is taken from the environment (ethX.server
 BAREBOX_CMD_HELP_TEXT("")
 BAREBOX_CMD_HELP_TEXT("Options:")
 BAREBOX_CMD_HELP_OPT ("-p", "push to TFTP server")
+BAREBOX_CMD_HELP_OPT ("-t", "print transfer throughput instead of a progress bar")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Use /dev/null as DEST to benchmark the network path only.")
 BAREBOX_CMD_HELP_END
 
 BAREBOX_CMD_START(tftp)
 	.cmd		= do_tftpb,
 	BAREBOX_CMD_DESC("load (or save) a file using TFTP")
-	BAREBOX_CMD_OPTS("[-p] SOURCE [DEST]")
+	BAREBOX_CMD_OPTS("[-pt] SOURCE [DEST]")
 	BAREBOX_CMD_GROUP(CMD_GRP_NET)
 	BAREBOX_CMD_HELP(cmd_tftp_help)
 BAREBOX_CMD_END
@@ -22,22 +22,152 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <fs.h>
+#include <getopt.h>
+#include <malloc.h>
+#include <clock.h>
+#include <libfile.h>
 #include <uncompress.h>
+#include <linux/sizes.h>
+
+#define UNCOMPRESS_BENCH_BUFSIZE	SZ_256K
+
+/* decompress @inbuf once, return the decompressed size */
+static ssize_t uncompress_bench_pass(const void *inbuf, size_t insize,
+				     void *outbuf, enum filetype *ft)
+{
+	struct uncompress_stream *us;
+	ssize_t now, total = 0;
+	int ret, i;
+
+	us = uncompress_stream_init(uncompress_err_stdout);
+
+	/* pass all of the input, then signal its end */
+	for (i = 0; i < 2; i++) {
+		ret = uncompress_stream_feed(us, i ? NULL : inbuf,
+					     i ? 0 : insize);
+		if (ret) {
+			total = ret;
+			goto out;
+		}
+
+		while ((now = uncompress_stream_drain(us, outbuf,
+					UNCOMPRESS_BENCH_BUFSIZE)) > 0)
+			total += now;
+
+		if (now < 0) {
+			total = now;
+			goto out;
+		}
+	}
+
+	*ft = uncompress_stream_filetype(us);
+out:
+	uncompress_stream_free(us);
+
+	return total;
+}
+
+static int uncompress_bench(const char *filename, void *outbuf,
+			    uint64_t duration)
+{
+	enum filetype ft = filetype_unknown;
+	uint64_t start, ns, bytes = 0;
+	ssize_t outsize;
+	size_t insize;
+	void *inbuf;
+
+	inbuf = read_file(filename, &insize);
+	if (!inbuf)
+		return -errno;
+
+	start = get_time_ns();
+
+	/* decompress the file over and over until the time is up */
+	do {
+		outsize = uncompress_bench_pass(inbuf, insize, outbuf, &ft);
+		if (outsize < 0)
+			goto out;
+		bytes += outsize;
+	} while (!is_timeout(start, duration));
+
+	ns = get_time_ns() - start;
+
+	printf("%-8s %10zu %10zd %16s  %s\n",
+	       file_type_to_short_string(ft), insize, outsize,
+	       rate_human_readable(bytes, ns), filename);
+out:
+	free(inbuf);
+
+	return outsize < 0 ? outsize : 0;
+}
+
+static int do_uncompress_bench(int argc, char *argv[], uint64_t duration)
+{
+	void *outbuf;
+	int i, ret, err = 0;
+
+	if (!argc)
+		return COMMAND_ERROR_USAGE;
+
+	outbuf = xmalloc(UNCOMPRESS_BENCH_BUFSIZE);
+
+	printf("%-8s %10s %10s %16s  %s\n", "format", "size", "output",
+	       "throughput", "file");
+
+	for (i = 0; i < argc; i++) {
+		/* report a failing file, but go on with the others */
+		ret = uncompress_bench(argv[i], outbuf, duration);
+		if (ret) {
+			printf("%s: %s\n", argv[i], strerror(-ret));
+			err = ret;
+		}
+
+		if (ctrlc()) {
+			err = -EINTR;
+			break;
+		}
+	}
+
+	free(outbuf);
+
+	return err ? COMMAND_ERROR : 0;
+}
 
 static int do_uncompress(int argc, char *argv[])
 {
-	int from, to, ret;
+	int from, to, ret, opt;
+	uint64_t duration = SECOND;
+	int bench = 0;
 
-	if (argc != 3)
+	while ((opt = getopt(argc, argv, "bT:")) > 0) {
+		switch (opt) {
+		case 'b':
+			bench = 1;
+			break;
+		case 'T':
+			duration = simple_strtoull(optarg, NULL, 0) * MSECOND;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (bench)
+		return do_uncompress_bench(argc, argv, duration);
+
+	if (argc != 2)
 		return COMMAND_ERROR_USAGE;
 
-	from = open(argv[1], O_RDONLY);
+	from = open(argv[0], O_RDONLY);
 	if (from < 0) {
 		perror("open");
 		return 1;
 	}
 
-	to = open(argv[2], O_WRONLY | O_CREAT);
+	to = open(argv[1], O_WRONLY | O_CREAT);
 	if (to < 0) {
 		perror("open");
 		ret = 1;
@@ -54,11 +184,21 @@ exit_close:
 	close(from);
 	return ret;
 }
-
+BAREBOX_CMD_HELP_START(uncompress)
+BAREBOX_CMD_HELP_TEXT("Uncompress INFILE to OUTFILE. With -b measure the decompression")
+BAREBOX_CMD_HELP_TEXT("throughput for each FILE instead, e.g. for the same data compressed")
+BAREBOX_CMD_HELP_TEXT("with different algorithms. The throughput is given for the")
+BAREBOX_CMD_HELP_TEXT("uncompressed data, the files are read to memory first.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-b",      "benchmark mode")
+BAREBOX_CMD_HELP_OPT ("-T <ms>", "time to spend on each file in benchmark mode (default 1000)")
+BAREBOX_CMD_HELP_END
 
 BAREBOX_CMD_START(uncompress)
 	.cmd            = do_uncompress,
 	BAREBOX_CMD_DESC("uncompress a compressed file")
-	BAREBOX_CMD_OPTS("INFILE OUTFILE")
+	BAREBOX_CMD_OPTS("INFILE OUTFILE | -b [-T <ms>] FILE...")
 	BAREBOX_CMD_GROUP(CMD_GRP_FILE)
+	BAREBOX_CMD_HELP(cmd_uncompress_help)
 BAREBOX_CMD_END
@@ -0,0 +1,369 @@
+/*
+ * arena.c - size class allocator for many small objects
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * An arena takes chunks from the heap and carves them into objects of a
+ * few fixed sizes, each chunk holds objects of a single size. Freed
+ * objects go to a freelist per size and are reused for the next object
+ * of that size, so many small objects do not fragment the heap. Larger
+ * objects get a chunk of their own. Destroying an arena returns all of
+ * its chunks, objects which are still allocated do not have to be freed
+ * one by one.
+ *
+ * The chunks for small objects are aligned to their size and start with
+ * their header, the header of a large object is right in front of it.
+ * The chunk of an object is found by checking these two candidates in a
+ * hash of all chunks, which never touches memory that is not a chunk.
+ */
+#include <common.h>
+#include <arena.h>
+#include <malloc.h>
+#include <xfuncs.h>
+#include <linux/list.h>
+#include <linux/sizes.h>
+
+#define ARENA_CHUNK_SIZE	SZ_16K
+#define ARENA_ALIGN		16
+#define ARENA_HASH_SIZE		256
+
+static const unsigned short arena_sizes[] = {
+	16, 32, 48, 64, 96, 128, 192, 256,
+};
+
+#define ARENA_NUM_CLASSES	ARRAY_SIZE(arena_sizes)
+/* the class of chunks with a single larger object */
+#define ARENA_LARGE		ARENA_NUM_CLASSES
+
+struct arena_chunk {
+	struct list_head list;
+	struct hlist_node hash;
+	struct arena *arena;
+	void *start;
+	void *end;
+	int class;
+};
+
+struct arena {
+	const char *name;
+	struct list_head list;
+	struct list_head chunks;
+
+	void *free[ARENA_NUM_CLASSES];
+	/* unused space at the end of the newest chunk of each class */
+	void *next[ARENA_NUM_CLASSES];
+	void *limit[ARENA_NUM_CLASSES];
+
+	/* for arena_stats() */
+	unsigned long objects[ARENA_LARGE + 1];
+	unsigned long chunk_bytes;
+	unsigned long large_bytes;
+	unsigned long num_chunks;
+};
+
+static LIST_HEAD(arenas);
+static struct hlist_head arena_hash[ARENA_HASH_SIZE];
+
+#define ARENA_HDR_SIZE		ALIGN(sizeof(struct arena_chunk), ARENA_ALIGN)
+
+static struct hlist_head *arena_hash_head(const void *chunk)
+{
+	unsigned long addr = (unsigned long)chunk;
+
+	return &arena_hash[((addr >> 14) ^ (addr >> 4)) & (ARENA_HASH_SIZE - 1)];
+}
+
+/**
+ * arena_new - create a new arena
+ * @name: name shown by arena_stats()
+ *
+ * Return: the new arena. Pass it to arena_destroy() to free all
+ * objects allocated from it.
+ */
+struct arena *arena_new(const char *name)
+{
+	struct arena *arena;
+
+	arena = xzalloc(sizeof(*arena));
+	arena->name = name;
+	INIT_LIST_HEAD(&arena->chunks);
+	list_add_tail(&arena->list, &arenas);
+
+	return arena;
+}
+
+/**
+ * arena_destroy - free an arena and all objects allocated from it
+ * @arena: the arena, may be NULL
+ */
+void arena_destroy(struct arena *arena)
+{
+	struct arena_chunk *chunk, *tmp;
+
+	if (!arena)
+		return;
+
+	list_for_each_entry_safe(chunk, tmp, &arena->chunks, list) {
+		hlist_del(&chunk->hash);
+		free(chunk);
+	}
+
+	list_del(&arena->list);
+	free(arena);
+}
+
+static struct arena_chunk *arena_new_chunk(struct arena *arena, int class,
+					   size_t size)
+{
+	struct arena_chunk *chunk;
+
+	if (class == ARENA_LARGE) {
+		chunk = xmemalign(ARENA_ALIGN, ARENA_HDR_SIZE + size);
+	} else {
+		chunk = xmemalign(ARENA_CHUNK_SIZE, ARENA_CHUNK_SIZE);
+		size = ARENA_CHUNK_SIZE - ARENA_HDR_SIZE;
+		size -= size % arena_sizes[class];
+	}
+
+	chunk->arena = arena;
+	chunk->class = class;
+	chunk->start = (void *)chunk + ARENA_HDR_SIZE;
+	chunk->end = chunk->start + size;
+
+	list_add(&chunk->list, &arena->chunks);
+	hlist_add_head(&chunk->hash, arena_hash_head(chunk));
+
+	arena->num_chunks++;
+
+	return chunk;
+}
+
+static int arena_class(size_t size)
+{
+	int i;
+
+	for (i = 0; i < ARENA_NUM_CLASSES; i++)
+		if (size <= arena_sizes[i])
+			return i;
+
+	return ARENA_LARGE;
+}
+
+static struct arena_chunk *arena_lookup_chunk(const void *addr, int large)
+{
+	struct arena_chunk *chunk;
+	struct hlist_node *n;
+
+	hlist_for_each_entry(chunk, n, arena_hash_head(addr), hash)
+		if (chunk == addr)
+			return (chunk->class == ARENA_LARGE) == large ? chunk : NULL;
+
+	return NULL;
+}
+
+/* find the chunk of an object returned by arena_alloc() */
+static struct arena_chunk *arena_find_chunk(const void *ptr)
+{
+	struct arena_chunk *chunk;
+
+	chunk = arena_lookup_chunk((void *)((unsigned long)ptr &
+					    ~(ARENA_CHUNK_SIZE - 1)), 0);
+	if (chunk)
+		return chunk;
+
+	return arena_lookup_chunk(ptr - ARENA_HDR_SIZE, 1);
+}
+
+/**
+ * arena_alloc - allocate an object from an arena
+ * @arena: the arena, if NULL the object is allocated with malloc()
+ * @size:  size of the object
+ *
+ * Like xmalloc() this never returns NULL. The object can be freed with
+ * arena_free() or together with the arena.
+ */
+void *arena_alloc(struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk;
+	int class;
+	void *obj;
+
+	if (!arena)
+		return xmalloc(size);
+
+	class = arena_class(size);
+
+	arena->objects[class]++;
+
+	if (class == ARENA_LARGE) {
+		chunk = arena_new_chunk(arena, class, size);
+		arena->large_bytes += size;
+		return chunk->start;
+	}
+
+	obj = arena->free[class];
+	if (obj) {
+		arena->free[class] = *(void **)obj;
+		return obj;
+	}
+
+	if (arena->next[class] == arena->limit[class]) {
+		chunk = arena_new_chunk(arena, class, 0);
+		arena->chunk_bytes += chunk->end - chunk->start;
+		arena->next[class] = chunk->start;
+		arena->limit[class] = chunk->end;
+	}
+
+	obj = arena->next[class];
+	arena->next[class] += arena_sizes[class];
+
+	return obj;
+}
+
+/**
+ * arena_zalloc - allocate a zeroed object from an arena
+ * @arena: the arena, if NULL the object is allocated with malloc()
+ * @size:  size of the object
+ */
+void *arena_zalloc(struct arena *arena, size_t size)
+{
+	void *obj = arena_alloc(arena, size);
+
+	memset(obj, 0, size);
+
+	return obj;
+}
+
+/**
+ * arena_strdup - duplicate a string into an arena
+ * @arena: the arena, if NULL the string is allocated with malloc()
+ * @s:     the string
+ */
+char *arena_strdup(struct arena *arena, const char *s)
+{
+	size_t len = strlen(s) + 1;
+
+	return memcpy(arena_alloc(arena, len), s, len);
+}
+
+/**
+ * arena_free - free an object
+ * @ptr: the object, may be NULL
+ *
+ * This frees objects of any arena. Memory which does not belong to an
+ * arena is passed to free(), so this can be used for objects which are
+ * allocated either from an arena or with malloc().
+ */
+void arena_free(void *ptr)
+{
+	struct arena_chunk *chunk;
+	struct arena *arena;
+
+	if (!ptr)
+		return;
+
+	chunk = arena_find_chunk(ptr);
+	if (!chunk) {
+		free(ptr);
+		return;
+	}
+
+	arena = chunk->arena;
+	arena->objects[chunk->class]--;
+
+	if (chunk->class == ARENA_LARGE) {
+		arena->large_bytes -= chunk->end - chunk->start;
+		arena->num_chunks--;
+		list_del(&chunk->list);
+		hlist_del(&chunk->hash);
+		free(chunk);
+		return;
+	}
+
+	*(void **)ptr = arena->free[chunk->class];
+	arena->free[chunk->class] = ptr;
+}
+
+/**
+ * arena_realloc - change the size of an object
+ * @arena: the arena for new objects, if NULL they are allocated with malloc()
+ * @ptr:   the object, may be NULL
+ * @size:  the new size
+ *
+ * Objects which are not allocated from an arena are resized with
+ * xrealloc(), the others stay in their arena. Like xrealloc() this never
+ * returns NULL.
+ */
+void *arena_realloc(struct arena *arena, void *ptr, size_t size)
+{
+	struct arena_chunk *chunk;
+	size_t old;
+	void *obj;
+
+	if (!ptr)
+		return arena_alloc(arena, size);
+
+	chunk = arena_find_chunk(ptr);
+	if (!chunk)
+		return xrealloc(ptr, size);
+
+	if (chunk->class == ARENA_LARGE)
+		old = chunk->end - chunk->start;
+	else
+		old = arena_sizes[chunk->class];
+
+	if (size <= old)
+		return ptr;
+
+	obj = arena_alloc(chunk->arena, size);
+	memcpy(obj, ptr, old);
+	arena_free(ptr);
+
+	return obj;
+}
+
+/**
+ * arena_stats - print the memory usage of all arenas
+ *
+ * The fragmentation is the part of the chunks for small objects which is
+ * not used by allocated objects, i.e. the freelists and the unused space
+ * at the end of the chunks.
+ */
+void arena_stats(void)
+{
+	struct arena *arena;
+	unsigned long used, frag;
+	int i;
+
+	if (list_empty(&arenas))
+		return;
+
+	printf("arena                chunks   objects   size/KiB   used/KiB   large/KiB  frag\n");
+
+	list_for_each_entry(arena, &arenas, list) {
+		unsigned long objects = arena->objects[ARENA_LARGE];
+
+		used = 0;
+		for (i = 0; i < ARENA_NUM_CLASSES; i++) {
+			used += arena->objects[i] * arena_sizes[i];
+			objects += arena->objects[i];
+		}
+
+		frag = arena->chunk_bytes ?
+			(arena->chunk_bytes - used) * 100 / arena->chunk_bytes : 0;
+
+		printf("%-20s %6lu %9lu %10lu %10lu %11lu %4lu%%\n",
+		       arena->name, arena->num_chunks, objects,
+		       arena->chunk_bytes >> 10, used >> 10,
+		       arena->large_bytes >> 10, frag);
+	}
+}
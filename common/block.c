@@ -19,8 +19,10 @@
 #include <common.h>
 #include <block.h>
 #include <malloc.h>
+#include <param.h>
 #include <linux/err.h>
 #include <linux/list.h>
+#include <linux/log2.h>
 #include <dma.h>
 
 #define BLOCKSIZE(blk)	(1 << blk->blockbits)
@@ -34,9 +36,35 @@ struct chunk {
 	int dirty; /* need to write back to device */
 	int num; /* number of chunk, debugging only */
 	struct list_head list;
+	struct hlist_node hnode; /* lookup hash entry while buffered */
 };
 
 #define BUFSIZE (PAGE_SIZE * 16)
+#define NUM_CHUNKS 8
+#define NUM_READAHEAD 4
+
+static struct hlist_head *chunk_hash_head(struct block_device *blk, int block)
+{
+	int index = block >> (ffs(blk->rdbufsize) - 1);
+
+	return &blk->chunk_hash[index & (blk->chunk_hash_size - 1)];
+}
+
+/*
+ * Write a dirty chunk back to the device. The last chunk may extend
+ * beyond the end of the device, so only write the valid part.
+ */
+static int chunk_writeback(struct block_device *blk, struct chunk *chunk)
+{
+	size_t num_blocks = min(blk->rdbufsize,
+			blk->num_blocks - chunk->block_start);
+	int ret;
+
+	ret = blk->ops->write(blk, chunk->data, chunk->block_start, num_blocks);
+	chunk->dirty = 0;
+
+	return ret;
+}
 
 /*
  * Write all dirty chunks back to the device
@@ -49,10 +77,8 @@ static int writebuffer_flush(struct block_device *blk)
 		return 0;
 
 	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
-		if (chunk->dirty) {
-			blk->ops->write(blk, chunk->data, chunk->block_start, blk->rdbufsize);
-			chunk->dirty = 0;
-		}
+		if (chunk->dirty)
+			chunk_writeback(blk, chunk);
 	}
 
 	if (blk->ops->flush)
@@ -62,28 +88,45 @@ static int writebuffer_flush(struct block_device *blk)
 }
 
 /*
- * get the chunk containing a given block. Will return NULL if the
- * block is not cached, the chunk otherwise.
+ * Find the chunk containing a given block without changing its
+ * position in the LRU list. Returns NULL if the block is not cached.
  */
-static struct chunk *chunk_get_cached(struct block_device *blk, int block)
+static struct chunk *chunk_lookup(struct block_device *blk, int block)
 {
 	struct chunk *chunk;
+	struct hlist_node *node;
+	int block_start = block & ~blk->blkmask;
 
-	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
-		if (block >= chunk->block_start &&
-				block < chunk->block_start + blk->rdbufsize) {
-			debug("%s: found %d in %d\n", __func__, block, chunk->num);
-			/*
-			 * move most recently used entry to the head of the list
-			 */
-			list_move(&chunk->list, &blk->buffered_blocks);
+	hlist_for_each_entry(chunk, node, chunk_hash_head(blk, block), hnode) {
+		if (chunk->block_start == block_start)
 			return chunk;
-		}
 	}
 
 	return NULL;
 }
 
+/*
+ * get the chunk containing a given block. Will return NULL if the
+ * block is not cached, the chunk otherwise.
+ */
+static struct chunk *chunk_get_cached(struct block_device *blk, int block)
+{
+	struct chunk *chunk;
+
+	chunk = chunk_lookup(blk, block);
+	if (!chunk)
+		return NULL;
+
+	debug("%s: found %d in %d\n", __func__, block, chunk->num);
+
+	/*
+	 * move most recently used entry to the head of the list
+	 */
+	list_move(&chunk->list, &blk->buffered_blocks);
+
+	return chunk;
+}
+
 /*
  * Get the data pointer for a given block. Will return NULL if
  * the block is not cached, the data pointer otherwise.
@@ -111,15 +154,12 @@ static struct chunk *get_chunk(struct block_device *blk)
 	if (list_empty(&blk->idle_blocks)) {
 		/* use last entry which is the most unused */
 		chunk = list_last_entry(&blk->buffered_blocks, struct chunk, list);
-		if (chunk->dirty) {
-			size_t num_blocks = min(blk->rdbufsize,
-					blk->num_blocks - chunk->block_start);
-			blk->ops->write(blk, chunk->data, chunk->block_start,
-					num_blocks);
-			chunk->dirty = 0;
-		}
+		if (chunk->dirty)
+			chunk_writeback(blk, chunk);
 
 		list_del(&chunk->list);
+		hlist_del(&chunk->hnode);
+		blk->cache_evictions++;
 	} else {
 		chunk = list_first_entry(&blk->idle_blocks, struct chunk, list);
 		list_del(&chunk->list);
@@ -128,6 +168,90 @@ static struct chunk *get_chunk(struct block_device *blk)
 	return chunk;
 }
 
+static void chunk_add_buffered(struct block_device *blk, struct chunk *chunk)
+{
+	list_add(&chunk->list, &blk->buffered_blocks);
+	hlist_add_head(&chunk->hnode, chunk_hash_head(blk, chunk->block_start));
+}
+
+/*
+ * Number of chunks to read at once for a miss at @block_start. We only
+ * read ahead when the previous miss was on the preceding chunk, and never
+ * more than half of the cache so that a sequential reader does not evict
+ * the whole working set.
+ */
+static int block_readahead_chunks(struct block_device *blk, int block_start)
+{
+	int max = min(blk->cache_readahead, blk->cache_chunks / 2);
+	int n;
+
+	if (block_start != blk->ra_next)
+		return 1;
+
+	for (n = 1; n < max; n++) {
+		int block = block_start + n * blk->rdbufsize;
+
+		if (block >= blk->num_blocks || chunk_lookup(blk, block))
+			break;
+	}
+
+	return n;
+}
+
+/*
+ * dma_alloc() panics when it runs out of memory, but changing the cache
+ * parameters to something too big must fail gracefully. Allocate with the
+ * alignment dma_alloc() uses on ARM, the strictest one, instead. The
+ * buffers are freed with dma_free().
+ */
+static void *block_cache_alloc(size_t size)
+{
+	return memalign(64, ALIGN(size, 64));
+}
+
+/*
+ * Read @n consecutive chunks starting at @block_start with a single
+ * read operation into the readahead buffer and distribute them into
+ * the cache.
+ */
+static int block_cache_readahead(struct block_device *blk, int block_start,
+		int n)
+{
+	size_t chunksize = blk->rdbufsize << blk->blockbits;
+	size_t num_blocks;
+	int i, ret;
+
+	if (!blk->rabuf) {
+		blk->rabuf = block_cache_alloc(blk->cache_readahead * chunksize);
+		if (!blk->rabuf)
+			return -ENOMEM;
+	}
+
+	num_blocks = min(n * blk->rdbufsize, blk->num_blocks - block_start);
+
+	debug("%s: %zu blocks at %d\n", __func__, num_blocks, block_start);
+
+	ret = blk->ops->read(blk, blk->rabuf, block_start, num_blocks);
+	if (ret)
+		return ret;
+
+	/* add in reverse order so that the requested chunk ends up first */
+	for (i = n - 1; i >= 0; i--) {
+		struct chunk *chunk = get_chunk(blk);
+		size_t len = min(chunksize, (num_blocks << blk->blockbits) -
+				i * chunksize);
+
+		chunk->block_start = block_start + i * blk->rdbufsize;
+		memcpy(chunk->data, blk->rabuf + i * chunksize, len);
+		chunk_add_buffered(blk, chunk);
+	}
+
+	blk->cache_readaheads += n - 1;
+	blk->ra_next = block_start + n * blk->rdbufsize;
+
+	return 0;
+}
+
 /*
  * read a block into the cache. This assumes that the block is
  * not cached already. By definition block_get_cached() for
@@ -137,10 +261,21 @@ static int block_cache(struct block_device *blk, int block)
 {
 	struct chunk *chunk;
 	size_t num_blocks;
-	int ret;
+	int block_start = block & ~blk->blkmask;
+	int n, ret;
+
+	n = block_readahead_chunks(blk, block_start);
+	if (n > 1) {
+		ret = block_cache_readahead(blk, block_start, n);
+		if (!ret)
+			return 0;
+
+		/* the chunks ahead may not be readable, read just this one */
+		debug("%s: readahead failed: %d\n", __func__, ret);
+	}
 
 	chunk = get_chunk(blk);
-	chunk->block_start = block & ~blk->blkmask;
+	chunk->block_start = block_start;
 
 	debug("%s: %d to %d\n", __func__, chunk->block_start,
 			chunk->num);
@@ -152,7 +287,9 @@ static int block_cache(struct block_device *blk, int block)
 		list_add_tail(&chunk->list, &blk->idle_blocks);
 		return ret;
 	}
-	list_add(&chunk->list, &blk->buffered_blocks);
+	chunk_add_buffered(blk, chunk);
+
+	blk->ra_next = block_start + blk->rdbufsize;
 
 	return 0;
 }
@@ -170,8 +307,12 @@ static void *block_get(struct block_device *blk, int block)
 		return ERR_PTR(-ENXIO);
 
 	outdata = block_get_cached(blk, block);
-	if (outdata)
+	if (outdata) {
+		blk->cache_hits++;
 		return outdata;
+	}
+
+	blk->cache_misses++;
 
 	ret = block_cache(blk, block);
 	if (ret)
@@ -212,15 +353,18 @@ static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 
 	while (blocks) {
 		void *iobuf = block_get(blk, block);
+		/* copy all requested blocks from this chunk at once */
+		int now = min_t(int, blocks,
+				blk->rdbufsize - (block & blk->blkmask));
 
 		if (IS_ERR(iobuf))
 			return PTR_ERR(iobuf);
 
-		memcpy(buf, iobuf, BLOCKSIZE(blk));
-		buf += BLOCKSIZE(blk);
-		blocks--;
-		block++;
-		count -= BLOCKSIZE(blk);
+		memcpy(buf, iobuf, now << blk->blockbits);
+		buf += now << blk->blockbits;
+		blocks -= now;
+		block += now;
+		count -= now << blk->blockbits;
 	}
 
 	if (count) {
@@ -342,59 +486,228 @@ static struct cdev_operations block_ops = {
 	.lseek	= dev_lseek_default,
 };
 
-int blockdevice_register(struct block_device *blk)
+static void block_cache_free_chunks(struct list_head *chunks)
+{
+	struct chunk *chunk, *tmp;
+
+	list_for_each_entry_safe(chunk, tmp, chunks, list) {
+		dma_free(chunk->data);
+		free(chunk);
+	}
+}
+
+static int block_cache_alloc_chunks(struct list_head *chunks, int n,
+				    size_t size)
 {
-	loff_t size = (loff_t)blk->num_blocks * BLOCKSIZE(blk);
-	int ret;
 	int i;
 
-	blk->cdev.size = size;
-	blk->cdev.dev = blk->dev;
-	blk->cdev.ops = &block_ops;
-	blk->cdev.priv = blk;
-	blk->rdbufsize = BUFSIZE >> blk->blockbits;
+	for (i = 0; i < n; i++) {
+		struct chunk *chunk = xzalloc(sizeof(*chunk));
+		chunk->data = block_cache_alloc(size);
+		if (!chunk->data) {
+			free(chunk);
+			block_cache_free_chunks(chunks);
+			return -ENOMEM;
+		}
+		chunk->num = i;
+		list_add_tail(&chunk->list, chunks);
+	}
+
+	return 0;
+}
+
+static void block_cache_free(struct block_device *blk)
+{
+	writebuffer_flush(blk);
+
+	block_cache_free_chunks(&blk->buffered_blocks);
+	block_cache_free_chunks(&blk->idle_blocks);
+
+	free(blk->chunk_hash);
+	blk->chunk_hash = NULL;
+	dma_free(blk->rabuf);
+	blk->rabuf = NULL;
+}
+
+static void block_cache_set_defaults(struct block_device *blk)
+{
+	blk->cache_chunks = NUM_CHUNKS;
+	blk->cache_chunksize = max(BUFSIZE, BLOCKSIZE(blk));
+	blk->cache_readahead = NUM_READAHEAD;
+}
+
+/* set up the cache for the current parameters with the given @chunks */
+static void block_cache_setup(struct block_device *blk,
+			      struct list_head *chunks)
+{
+	blk->rdbufsize = blk->cache_chunksize >> blk->blockbits;
 
 	INIT_LIST_HEAD(&blk->buffered_blocks);
 	INIT_LIST_HEAD(&blk->idle_blocks);
+	list_splice(chunks, &blk->idle_blocks);
 	blk->blkmask = blk->rdbufsize - 1;
+	blk->ra_next = -1;
 
 	debug("%s: rdbufsize: %d blockbits: %d blkmask: 0x%08x\n", __func__, blk->rdbufsize, blk->blockbits,
 			blk->blkmask);
 
-	for (i = 0; i < 8; i++) {
-		struct chunk *chunk = xzalloc(sizeof(*chunk));
-		chunk->data = dma_alloc(BUFSIZE);
-		chunk->num = i;
-		list_add_tail(&chunk->list, &blk->idle_blocks);
-	}
+	blk->chunk_hash_size = roundup_pow_of_two(blk->cache_chunks);
+	blk->chunk_hash = xzalloc(blk->chunk_hash_size * sizeof(*blk->chunk_hash));
+}
 
-	ret = devfs_create(&blk->cdev);
+static int block_cache_init(struct block_device *blk)
+{
+	LIST_HEAD(chunks);
+	int ret;
+
+	ret = block_cache_alloc_chunks(&chunks, blk->cache_chunks,
+				       blk->cache_chunksize);
 	if (ret)
 		return ret;
 
-	list_add_tail(&blk->list, &block_device_list);
+	block_cache_setup(blk, &chunks);
 
-	cdev_create_default_automount(&blk->cdev);
+	return 0;
+}
+
+static int block_cache_param_set(struct param_d *p, void *priv)
+{
+	struct block_device *blk = priv;
+	LIST_HEAD(chunks);
+	int ret;
+
+	if (!blk->cache_chunks || !blk->cache_readahead ||
+	    !is_power_of_2(blk->cache_chunksize) ||
+	    blk->cache_chunksize < BLOCKSIZE(blk))
+		return -EINVAL;
+
+	/*
+	 * Allocate the new chunks before freeing the old ones, so that the
+	 * old cache stays in place when this fails. The parameter code then
+	 * restores the old value of the parameter.
+	 */
+	ret = block_cache_alloc_chunks(&chunks, blk->cache_chunks,
+				       blk->cache_chunksize);
+	if (ret) {
+		dev_warn(blk->dev, "cannot allocate block cache, keeping the old one\n");
+		return ret;
+	}
+
+	block_cache_free(blk);
+	block_cache_setup(blk, &chunks);
 
 	return 0;
 }
 
-int blockdevice_unregister(struct block_device *blk)
+static const struct {
+	const char *name;
+	size_t offset;
+	bool rw;
+} block_cache_params[] = {
+	{ "cache_chunks", offsetof(struct block_device, cache_chunks), true },
+	{ "cache_chunksize", offsetof(struct block_device, cache_chunksize), true },
+	{ "cache_readahead", offsetof(struct block_device, cache_readahead), true },
+	{ "cache_hits", offsetof(struct block_device, cache_hits) },
+	{ "cache_misses", offsetof(struct block_device, cache_misses) },
+	{ "cache_evictions", offsetof(struct block_device, cache_evictions) },
+	{ "cache_readaheads", offsetof(struct block_device, cache_readaheads) },
+};
+
+static char *block_cache_param_name(struct block_device *blk, int i)
 {
-	struct chunk *chunk, *tmp;
+	if (blk->param_prefix)
+		return basprintf("%s_%s", blk->param_prefix,
+				 block_cache_params[i].name);
 
-	writebuffer_flush(blk);
+	return xstrdup(block_cache_params[i].name);
+}
 
-	list_for_each_entry_safe(chunk, tmp, &blk->buffered_blocks, list) {
-		dma_free(chunk->data);
-		free(chunk);
+static void block_cache_add_params(struct block_device *blk)
+{
+	int i;
+
+	if (!IS_ENABLED(CONFIG_PARAMETER))
+		return;
+
+	/*
+	 * Several block devices may share a device, e.g. the boot partitions
+	 * of an eMMC or the LUNs of a USB mass storage device, so prefix the
+	 * parameters of all but the first one.
+	 */
+	if (blk->cdev.partname)
+		blk->param_prefix = blk->cdev.partname;
+	else if (get_param_by_name(blk->dev, block_cache_params[0].name))
+		blk->param_prefix = blk->cdev.name;
+
+	for (i = 0; i < ARRAY_SIZE(block_cache_params); i++) {
+		char *name = block_cache_param_name(blk, i);
+		uint32_t *value = (void *)blk + block_cache_params[i].offset;
+
+		if (block_cache_params[i].rw)
+			dev_add_param_uint32(blk->dev, name,
+					block_cache_param_set, NULL,
+					value, "%u", blk);
+		else
+			dev_add_param_uint32_ro(blk->dev, name, value, "%u");
+
+		free(name);
 	}
+}
 
-	list_for_each_entry_safe(chunk, tmp, &blk->idle_blocks, list) {
-		dma_free(chunk->data);
-		free(chunk);
+static void block_cache_remove_params(struct block_device *blk)
+{
+	int i;
+
+	if (!IS_ENABLED(CONFIG_PARAMETER))
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(block_cache_params); i++) {
+		char *name = block_cache_param_name(blk, i);
+		struct param_d *p = get_param_by_name(blk->dev, name);
+
+		if (p)
+			dev_remove_param(p);
+
+		free(name);
+	}
+}
+
+int blockdevice_register(struct block_device *blk)
+{
+	loff_t size = (loff_t)blk->num_blocks * BLOCKSIZE(blk);
+	int ret;
+
+	blk->cdev.size = size;
+	blk->cdev.dev = blk->dev;
+	blk->cdev.ops = &block_ops;
+	blk->cdev.priv = blk;
+
+	block_cache_set_defaults(blk);
+
+	ret = block_cache_init(blk);
+	if (ret)
+		return ret;
+
+	ret = devfs_create(&blk->cdev);
+	if (ret) {
+		block_cache_free(blk);
+		return ret;
 	}
 
+	list_add_tail(&blk->list, &block_device_list);
+
+	block_cache_add_params(blk);
+
+	cdev_create_default_automount(&blk->cdev);
+
+	return 0;
+}
+
+int blockdevice_unregister(struct block_device *blk)
+{
+	block_cache_remove_params(blk);
+	block_cache_free(blk);
+
 	devfs_remove(&blk->cdev);
 	list_del(&blk->list);
 
@@ -0,0 +1,293 @@
+/*
+ * boottrace.c - record the time spent in initcalls and driver probes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include <common.h>
+#include <boottrace.h>
+#include <clock.h>
+#include <command.h>
+#include <fcntl.h>
+#include <fs.h>
+#include <getopt.h>
+#include <kallsyms.h>
+#include <malloc.h>
+#include <qsort.h>
+#include <stdio.h>
+#include <asm-generic/div64.h>
+
+#define BOOTTRACE_NAME_LEN	32
+#define BOOTTRACE_MAX_DEPTH	16
+
+struct boottrace_record {
+	/* the initcall or NULL for probes which are recorded by name */
+	void *fn;
+	char name[BOOTTRACE_NAME_LEN];
+	uint64_t start;
+	uint64_t duration;
+	/* index of the enclosing record or -1 */
+	int parent;
+};
+
+static struct boottrace_record records[CONFIG_BOOTTRACE_RECORDS];
+static int num_records;
+static unsigned int dropped;
+/* the innermost record which has not ended yet */
+static int current = -1;
+
+/*
+ * Start a new record, nested into the currently open one. Either @name
+ * or @fn is used to describe the record, @fn is resolved to a symbol
+ * only when the records are shown. Returns the id to pass to
+ * boottrace_end() or -1 when the buffer is full.
+ */
+int boottrace_start(const char *name, void *fn)
+{
+	struct boottrace_record *r;
+
+	if (num_records == ARRAY_SIZE(records)) {
+		dropped++;
+		return -1;
+	}
+
+	r = &records[num_records];
+	r->fn = fn;
+	if (name)
+		strlcpy(r->name, name, sizeof(r->name));
+	r->parent = current;
+	r->start = get_time_ns();
+
+	current = num_records;
+
+	return num_records++;
+}
+
+void boottrace_end(int id)
+{
+	struct boottrace_record *r;
+	uint64_t now;
+
+	if (id < 0)
+		return;
+
+	r = &records[id];
+	now = get_time_ns();
+
+	/*
+	 * The time jumps when a clocksource is registered, only count
+	 * the time after that for records which started before.
+	 */
+	if (r->start < time_beginning)
+		r->start = time_beginning;
+
+	r->duration = now - r->start;
+	current = r->parent;
+}
+
+#ifdef CONFIG_CMD_BOOTTRACE
+static void boottrace_name(struct boottrace_record *r, char *buf, int size)
+{
+	if (r->fn)
+		snprintf(buf, size, "%pS", r->fn);
+	else
+		strlcpy(buf, r->name, size);
+}
+
+static uint64_t ns_to_us(uint64_t ns)
+{
+	do_div(ns, USECOND);
+
+	return ns;
+}
+
+static int boottrace_compare(const void *a, const void *b)
+{
+	uint64_t da = records[*(const int *)a].duration;
+	uint64_t db = records[*(const int *)b].duration;
+
+	if (da == db)
+		return 0;
+
+	return da < db ? 1 : -1;
+}
+
+static void boottrace_list(int fd, int sorted)
+{
+	char name[KSYM_NAME_LEN];
+	int *order, i, j, depth;
+
+	order = xmalloc(num_records * sizeof(*order));
+	for (i = 0; i < num_records; i++)
+		order[i] = i;
+
+	if (sorted)
+		qsort(order, num_records, sizeof(*order), boottrace_compare);
+
+	dprintf(fd, "  start/us   duration/us  name\n");
+
+	for (i = 0; i < num_records; i++) {
+		struct boottrace_record *r = &records[order[i]];
+
+		depth = 0;
+		if (!sorted)
+			for (j = r->parent; j >= 0; j = records[j].parent)
+				depth++;
+
+		boottrace_name(r, name, sizeof(name));
+		dprintf(fd, "%10llu  %12llu  %*s%s\n", ns_to_us(r->start),
+			ns_to_us(r->duration), depth * 2, "", name);
+	}
+
+	free(order);
+}
+
+/*
+ * Folded stacks as used by flamegraph.pl: the frames from the outermost
+ * to the innermost record separated by semicolons, followed by the time
+ * spent in the innermost record itself in microseconds.
+ */
+static void boottrace_folded(int fd)
+{
+	char name[KSYM_NAME_LEN];
+	int stack[BOOTTRACE_MAX_DEPTH];
+	uint64_t *self, us;
+	int i, j, depth;
+
+	self = xmalloc(num_records * sizeof(*self));
+
+	for (i = 0; i < num_records; i++)
+		self[i] = records[i].duration;
+	for (i = 0; i < num_records; i++)
+		if (records[i].parent >= 0)
+			self[records[i].parent] -= records[i].duration;
+
+	for (i = 0; i < num_records; i++) {
+		us = ns_to_us(self[i]);
+		if (!us)
+			continue;
+
+		depth = 0;
+		for (j = i; j >= 0 && depth < BOOTTRACE_MAX_DEPTH;
+		     j = records[j].parent)
+			stack[depth++] = j;
+
+		dprintf(fd, "barebox");
+		while (depth--) {
+			boottrace_name(&records[stack[depth]], name, sizeof(name));
+			dprintf(fd, ";%s", name);
+		}
+		dprintf(fd, " %llu\n", us);
+	}
+
+	free(self);
+}
+
+/*
+ * Trace Event Format as understood by chrome://tracing, Perfetto and
+ * speedscope. Nesting is derived from the timestamps by the viewers.
+ */
+static void boottrace_json(int fd)
+{
+	char name[KSYM_NAME_LEN];
+	int i;
+
+	dprintf(fd, "{\"traceEvents\":[\n");
+
+	for (i = 0; i < num_records; i++) {
+		struct boottrace_record *r = &records[i];
+
+		boottrace_name(r, name, sizeof(name));
+		dprintf(fd, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+			"\"ts\":%llu,\"dur\":%llu,\"pid\":1,\"tid\":1}%s\n",
+			name, r->fn ? "initcall" : "probe",
+			ns_to_us(r->start), ns_to_us(r->duration),
+			i == num_records - 1 ? "" : ",");
+	}
+
+	dprintf(fd, "],\"displayTimeUnit\":\"ms\"}\n");
+}
+
+static int do_boottrace(int argc, char *argv[])
+{
+	const char *filename = NULL;
+	int opt, fd = STDOUT_FILENO, format = 's';
+
+	while ((opt = getopt(argc, argv, "tfjo:")) > 0) {
+		switch (opt) {
+		case 't':
+		case 'f':
+		case 'j':
+			format = opt;
+			break;
+		case 'o':
+			filename = optarg;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (filename) {
+		fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC);
+		if (fd < 0) {
+			perror("open");
+			return 1;
+		}
+	}
+
+	switch (format) {
+	case 'f':
+		boottrace_folded(fd);
+		break;
+	case 'j':
+		boottrace_json(fd);
+		break;
+	default:
+		boottrace_list(fd, format == 's');
+		if (dropped)
+			dprintf(fd, "%u records dropped, increase "
+				"CONFIG_BOOTTRACE_RECORDS\n", dropped);
+		/*
+		 * Timestamps are relative to the start of the clocksource.
+		 * Counters which run since reset also include the time
+		 * spent before barebox, e.g. in the PBL.
+		 */
+		dprintf(fd, "clocksource registered at %llu us\n",
+			ns_to_us(time_beginning));
+		break;
+	}
+
+	if (filename)
+		close(fd);
+
+	return 0;
+}
+
+BAREBOX_CMD_HELP_START(boottrace)
+BAREBOX_CMD_HELP_TEXT("Show the time spent in the initcalls and driver probes, longest")
+BAREBOX_CMD_HELP_TEXT("first. Probes are nested into the initcalls which triggered them.")
+BAREBOX_CMD_HELP_TEXT("Times measured before the clocksource is registered are not")
+BAREBOX_CMD_HELP_TEXT("meaningful.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-t", "show the records in the order they were taken")
+BAREBOX_CMD_HELP_OPT ("-f", "output folded stacks for flamegraph.pl")
+BAREBOX_CMD_HELP_OPT ("-j", "output JSON trace events for chrome://tracing")
+BAREBOX_CMD_HELP_OPT ("-o FILE", "write the output to FILE")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(boottrace)
+	.cmd		= do_boottrace,
+	BAREBOX_CMD_DESC("show the time spent in initcalls and probes")
+	BAREBOX_CMD_OPTS("[-tfjo]")
+	BAREBOX_CMD_GROUP(CMD_GRP_INFO)
+	BAREBOX_CMD_HELP(cmd_boottrace_help)
+BAREBOX_CMD_END
+#endif
@@ -64,6 +64,15 @@ static int dummy_csrc_warn(void)
 }
 late_initcall(dummy_csrc_warn);
 
+/*
+ * Reading the dummy clocksource advances it, code which only takes
+ * timestamps for statistics can check this first.
+ */
+int clocksource_registered(void)
+{
+	return current_clock != &dummy_cs;
+}
+
 /**
  * get_time_ns - get current timestamp in nanoseconds
  */
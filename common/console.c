@@ -35,6 +35,7 @@
 #include <magicvar.h>
 #include <globalvar.h>
 #include <linux/list.h>
+#include <linux/log2.h>
 #include <linux/stringify.h>
 #include <debug_ll.h>
 
@@ -59,6 +60,106 @@ static struct kfifo __console_output_fifo;
 static struct kfifo *console_input_fifo = &__console_input_fifo;
 static struct kfifo *console_output_fifo = &__console_output_fifo;
 
+/*
+ * Pass the buffered output to the hardware. Without @wait only as much as
+ * the hardware takes without waiting for it.
+ */
+static void console_tx_drain(struct console_device *cdev, int wait)
+{
+	unsigned char c;
+
+	if (!cdev->tx_fifo)
+		return;
+
+	while (kfifo_len(cdev->tx_fifo)) {
+		if (!wait && !cdev->tx_ready(cdev))
+			return;
+
+		kfifo_getc(cdev->tx_fifo, &c);
+		cdev->putc(cdev, c);
+	}
+}
+
+static void console_tx_putc(struct console_device *cdev, char c)
+{
+	unsigned char out;
+
+	console_tx_drain(cdev, 0);
+
+	if (!kfifo_len(cdev->tx_fifo) && cdev->tx_ready(cdev)) {
+		cdev->putc(cdev, c);
+		return;
+	}
+
+	/* the buffer is full, wait for the hardware to take a character */
+	if (kfifo_len(cdev->tx_fifo) == cdev->tx_fifo->size) {
+		kfifo_getc(cdev->tx_fifo, &out);
+		cdev->putc(cdev, out);
+	}
+
+	kfifo_putc(cdev->tx_fifo, c);
+}
+
+static void console_cdev_putc(struct console_device *cdev, char c)
+{
+	if (cdev->tx_fifo)
+		console_tx_putc(cdev, c);
+	else
+		cdev->putc(cdev, c);
+}
+
+static int console_cdev_puts(struct console_device *cdev, const char *s)
+{
+	int n = 0;
+
+	if (!cdev->tx_fifo)
+		return cdev->puts(cdev, s);
+
+	while (*s) {
+		if (*s == '\n') {
+			console_tx_putc(cdev, '\r');
+			n++;
+		}
+		console_tx_putc(cdev, *s);
+		n++;
+		s++;
+	}
+
+	return n;
+}
+
+#ifdef CONFIG_CONSOLE_TX_BUFFER
+static void console_tx_poll(struct poller_struct *poller)
+{
+	struct console_device *cdev;
+
+	for_each_console(cdev)
+		console_tx_drain(cdev, 0);
+}
+
+static struct poller_struct console_tx_poller = {
+	.func = console_tx_poll,
+};
+
+static void console_tx_init(struct console_device *cdev)
+{
+	if (!cdev->tx_ready)
+		return;
+
+	cdev->tx_fifo = kfifo_alloc(
+			roundup_pow_of_two(CONFIG_CONSOLE_TX_BUFFER_SIZE));
+	if (!cdev->tx_fifo)
+		return;
+
+	if (!console_tx_poller.registered)
+		poller_register(&console_tx_poller);
+}
+#else
+static inline void console_tx_init(struct console_device *cdev)
+{
+}
+#endif
+
 int console_open(struct console_device *cdev)
 {
 	int ret;
@@ -101,8 +202,11 @@ int console_set_active(struct console_device *cdev, unsigned flag)
 	if (!cdev->putc)
 		flag &= ~(CONSOLE_STDOUT | CONSOLE_STDERR);
 
-	if (!flag && cdev->f_active && cdev->flush)
-		cdev->flush(cdev);
+	if (!flag && cdev->f_active) {
+		console_tx_drain(cdev, 1);
+		if (cdev->flush)
+			cdev->flush(cdev);
+	}
 
 	if (flag == cdev->f_active)
 		return 0;
@@ -191,6 +295,7 @@ int console_set_baudrate(struct console_device *cdev, unsigned baudrate)
 	if (cdev->f_active) {
 		printf("## Switch baudrate on console %s to %d bps and press ENTER ...\n",
 			dev_name(&cdev->class_dev), baudrate);
+		console_tx_drain(cdev, 1);
 		mdelay(50);
 	}
 
@@ -287,6 +392,8 @@ static int fops_flush(struct cdev *dev)
 {
 	struct console_device *priv = dev->priv;
 
+	console_tx_drain(priv, 1);
+
 	if (priv->flush)
 		priv->flush(priv);
 
@@ -298,7 +405,7 @@ static ssize_t fops_write(struct cdev* dev, const void* buf, size_t count,
 {
 	struct console_device *priv = dev->priv;
 
-	priv->puts(priv, buf);
+	console_cdev_puts(priv, buf);
 
 	return 0;
 }
@@ -347,6 +454,8 @@ int console_register(struct console_device *newcdev)
 	if (newcdev->putc && !newcdev->puts)
 		newcdev->puts = __console_puts;
 
+	console_tx_init(newcdev);
+
 	dev_add_param_string(dev, "active", console_active_set, console_active_get,
 			     &newcdev->active_string, newcdev);
 
@@ -406,6 +515,11 @@ int console_unregister(struct console_device *cdev)
 
 	devfs_remove(&cdev->devfs);
 
+	if (cdev->tx_fifo) {
+		console_tx_drain(cdev, 1);
+		kfifo_free(cdev->tx_fifo);
+	}
+
 	list_del(&cdev->list);
 	if (list_empty(&console_list))
 		initialized = CONSOLE_UNINITIALIZED;
@@ -520,8 +634,8 @@ void console_putc(unsigned int ch, char c)
 		for_each_console(cdev) {
 			if (cdev->f_active & ch) {
 				if (c == '\n')
-					cdev->putc(cdev, '\r');
-				cdev->putc(cdev, c);
+					console_cdev_putc(cdev, '\r');
+				console_cdev_putc(cdev, c);
 			}
 		}
 		return;
@@ -543,7 +657,7 @@ int console_puts(unsigned int ch, const char *str)
 	if (initialized == CONSOLE_INIT_FULL) {
 		for_each_console(cdev) {
 			if (cdev->f_active & ch) {
-				n = cdev->puts(cdev, str);
+				n = console_cdev_puts(cdev, str);
 			}
 		}
 		return n;
@@ -567,6 +681,7 @@ void console_flush(void)
 	struct console_device *cdev;
 
 	for_each_console(cdev) {
+		console_tx_drain(cdev, 1);
 		if (cdev->flush)
 			cdev->flush(cdev);
 	}
@@ -21,6 +21,7 @@
 #include <command.h>
 #include <errno.h>
 #include <console_countdown.h>
+#include <driver.h>
 #include <stdio.h>
 
 static bool console_countdown_timeout_abort;
@@ -45,6 +46,8 @@ int console_countdown(int timeout_s, unsigned flags, char *out_key)
 		printf("%4d", countdown--);
 
 	do {
+		device_probe_idle();
+
 		if (tstc()) {
 			key = getchar();
 			if (key >= 0) {
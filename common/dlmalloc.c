@@ -7,6 +7,20 @@
 #include <stdio.h>
 #include <module.h>
 
+#ifdef CONFIG_MALLOC_TRACE
+/* the public functions are provided by the tracing in malloc_trace.c */
+#undef malloc
+#undef free
+#undef realloc
+#undef memalign
+#undef calloc
+#define malloc		__malloc
+#define free		__free
+#define realloc		__realloc
+#define memalign	__memalign
+#define calloc		__calloc
+#endif
+
 /*
   A version of malloc/free/realloc written by Doug Lea and released to the
   public domain.  Send questions/comments/complaints/performance data
@@ -1791,6 +1805,32 @@ static void malloc_update_mallinfo(void)
 
 }
 
+/*
+ * The size of the largest block which can currently be allocated, this is
+ * either a free chunk or the top chunk together with the memory which is
+ * not yet taken with sbrk().
+ */
+size_t malloc_largest_free(void)
+{
+	INTERNAL_SIZE_T size, largest;
+	mbinptr b;
+	mchunkptr p;
+	int i;
+
+	largest = chunksize(top) + mem_malloc_end() - (unsigned long)sbrk(0);
+
+	for (i = 1; i < NAV; ++i) {
+		b = bin_at(i);
+		for (p = last(b); p != b; p = p->bk) {
+			size = chunksize(p);
+			if (size > largest)
+				largest = size;
+		}
+	}
+
+	return largest > SIZE_SZ ? largest - SIZE_SZ : 0;
+}
+
 /*
   malloc_stats:
 
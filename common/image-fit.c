@@ -26,6 +26,8 @@
 #include <digest.h>
 #include <of.h>
 #include <fs.h>
+#include <fcntl.h>
+#include <linux/sizes.h>
 #include <malloc.h>
 #include <linux/ctype.h>
 #include <asm/byteorder.h>
@@ -371,13 +373,24 @@ static int fit_verify_signature(struct device_node *sig_node, const void *fit)
 	return ret;
 }
 
-static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
-			   const void *data, int data_len)
+/*
+ * Images are verified while they are loaded, so the state of a running
+ * hash or signature check is carried in here.
+ */
+struct fit_verify {
+	struct device_node *node;
+	struct digest *digest;
+	enum hash_algo algo;
+	bool signature;
+};
+
+static int fit_verify_hash_start(struct fit_handle *handle,
+				 struct device_node *image,
+				 struct fit_verify *v)
 {
 	struct digest *d;
 	const char *algo;
 	const char *value_read;
-	char *value_calc;
 	int hash_len, ret;
 	struct device_node *hash;
 
@@ -418,40 +431,49 @@ static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
 
 	if (hash_len != digest_length(d)) {
 		pr_err("%s: invalid hash length %d\n", hash->full_name, hash_len);
-		ret = -EINVAL;
-		goto err_digest_free;
+		digest_free(d);
+		return -EINVAL;
 	}
 
+	digest_init(d);
+
+	v->node = hash;
+	v->digest = d;
+
+	return 0;
+}
+
+static int fit_verify_hash_finish(struct fit_verify *v)
+{
+	const char *value_read;
+	char *value_calc;
+	int hash_len, ret;
+
+	value_read = of_get_property(v->node, "value", &hash_len);
 	value_calc = xmalloc(hash_len);
 
-	digest_init(d);
-	digest_update(d, data, data_len);
-	digest_final(d, value_calc);
+	digest_final(v->digest, value_calc);
 
 	if (memcmp(value_read, value_calc, hash_len)) {
-		pr_info("%s: hash BAD\n", hash->full_name);
+		pr_info("%s: hash BAD\n", v->node->full_name);
 		ret =  -EBADMSG;
 	} else {
-		pr_info("%s: hash OK\n", hash->full_name);
+		pr_info("%s: hash OK\n", v->node->full_name);
 		ret = 0;
 	}
 
 	free(value_calc);
 
-err_digest_free:
-	digest_free(d);
-
 	return ret;
 }
 
-static int fit_image_verify_signature(struct fit_handle *handle,
-				      struct device_node *image,
-				      const void *data, int data_len)
+static int fit_image_verify_signature_start(struct fit_handle *handle,
+					    struct device_node *image,
+					    struct fit_verify *v)
 {
 	struct digest *digest;
 	struct device_node *sig_node;
 	enum hash_algo algo = 0;
-	void *hash;
 	int ret;
 
 	if (!IS_ENABLED(CONFIG_FITIMAGE_SIGNATURE))
@@ -477,15 +499,68 @@ static int fit_image_verify_signature(struct fit_handle *handle,
 	if (IS_ERR(digest))
 		return PTR_ERR(digest);
 
-	digest_update(digest, data, data_len);
-	hash = xzalloc(digest_length(digest));
-	digest_final(digest, hash);
+	v->node = sig_node;
+	v->digest = digest;
+	v->algo = algo;
+	v->signature = true;
 
-	ret = fit_check_rsa_signature(sig_node, algo, hash);
+	return 0;
+}
+
+static int fit_image_verify_signature_finish(struct fit_verify *v)
+{
+	void *hash;
+	int ret;
+
+	hash = xzalloc(digest_length(v->digest));
+	digest_final(v->digest, hash);
+
+	ret = fit_check_rsa_signature(v->node, v->algo, hash);
 
 	free(hash);
 
-	digest_free(digest);
+	return ret;
+}
+
+/*
+ * If @conf_node is non NULL only the hash is checked, because opening the
+ * configuration already checked the RSA signature of all involved nodes.
+ * Otherwise the RSA signature of the image is checked if desired.
+ */
+static int fit_image_verify_start(struct fit_handle *handle,
+				  struct device_node *conf_node,
+				  struct device_node *image,
+				  struct fit_verify *v)
+{
+	memset(v, 0, sizeof(*v));
+
+	if (conf_node)
+		return fit_verify_hash_start(handle, image, v);
+	else
+		return fit_image_verify_signature_start(handle, image, v);
+}
+
+static void fit_image_verify_update(struct fit_verify *v, const void *data,
+				    unsigned long len)
+{
+	if (v->digest)
+		digest_update(v->digest, data, len);
+}
+
+static int fit_image_verify_finish(struct fit_verify *v, int ret)
+{
+	if (!v->digest)
+		return ret;
+
+	if (!ret) {
+		if (IS_ENABLED(CONFIG_FITIMAGE_SIGNATURE) && v->signature)
+			ret = fit_image_verify_signature_finish(v);
+		else
+			ret = fit_verify_hash_finish(v);
+	}
+
+	digest_free(v->digest);
+	v->digest = NULL;
 
 	return ret;
 }
@@ -505,6 +580,239 @@ int fit_has_image(struct fit_handle *handle, void *configuration,
 	return 1;
 }
 
+static struct device_node *fit_get_image(struct fit_handle *handle,
+					 struct device_node *conf_node,
+					 const char *name)
+{
+	struct device_node *image;
+	const char *unit, *type = NULL;
+
+	if (conf_node) {
+		if (of_property_read_string(conf_node, name, &unit)) {
+			pr_err("No image named '%s'\n", name);
+			return ERR_PTR(-ENOENT);
+		}
+	} else {
+		unit = name;
+	}
+
+	image = of_get_child_by_name(handle->images, unit);
+	if (!image)
+		return ERR_PTR(-ENOENT);
+
+	of_property_read_string(image, "type", &type);
+	if (!type) {
+		pr_err("No \"type\" property found in %s\n", image->full_name);
+		return ERR_PTR(-EINVAL);
+	}
+
+	return image;
+}
+
+static size_t fit_fdt_size(struct fit_handle *handle)
+{
+	const struct fdt_header *fdt = handle->fit;
+
+	return fdt32_to_cpu(fdt->totalsize);
+}
+
+/*
+ * The image data is either embedded in the "data" property, or, for FIT
+ * images created with 'mkimage -E', stored behind the device tree and
+ * described by "data-size" and "data-offset" (relative to the 4 byte aligned
+ * end of the device tree) or "data-position" (relative to the start of the
+ * FIT image). External data is returned in @offset with @data set to NULL
+ * when the FIT image is read from a file.
+ */
+static int fit_get_image_data(struct fit_handle *handle,
+			      struct device_node *image, const void **data,
+			      loff_t *offset, unsigned long *size)
+{
+	u32 ofs, len;
+	int data_len;
+
+	*data = of_get_property(image, "data", &data_len);
+	if (*data) {
+		*size = data_len;
+		return 0;
+	}
+
+	if (of_property_read_u32(image, "data-size", &len)) {
+		pr_err("data not found\n");
+		return -EINVAL;
+	}
+
+	if (!of_property_read_u32(image, "data-position", &ofs)) {
+		*offset = ofs;
+	} else if (!of_property_read_u32(image, "data-offset", &ofs)) {
+		*offset = ALIGN(fit_fdt_size(handle), 4) + (loff_t)ofs;
+	} else {
+		pr_err("%s: neither \"data-offset\" nor \"data-position\" found\n",
+		       image->full_name);
+		return -EINVAL;
+	}
+
+	*size = len;
+
+	if (handle->fd < 0) {
+		if (*offset + len > handle->size) {
+			pr_err("%s: data outside of the FIT image\n",
+			       image->full_name);
+			return -EINVAL;
+		}
+		*data = handle->fit + *offset;
+	}
+
+	return 0;
+}
+
+static int fit_seek(struct fit_handle *handle, loff_t pos)
+{
+	/*
+	 * Not all filesystems can seek backwards (e.g. TFTP), reopen the
+	 * file in this case.
+	 */
+	if (lseek(handle->fd, pos, SEEK_SET) == pos)
+		return 0;
+
+	close(handle->fd);
+
+	handle->fd = open(handle->filename, O_RDONLY);
+	if (handle->fd < 0)
+		return handle->fd;
+
+	if (lseek(handle->fd, pos, SEEK_SET) != pos)
+		return -errno;
+
+	return 0;
+}
+
+/*
+ * Copy or read the image to @dest in chunks and feed each chunk to the
+ * digest while it is still in the cache, so the data is only passed once.
+ */
+#define FIT_LOAD_CHUNK	SZ_128K
+
+static int fit_load_image_data(struct fit_handle *handle,
+			       struct device_node *conf_node,
+			       struct device_node *image, const void *data,
+			       loff_t offset, unsigned long size, void *dest)
+{
+	struct fit_verify v;
+	unsigned long done, now;
+	int ret;
+
+	ret = fit_image_verify_start(handle, conf_node, image, &v);
+	if (ret)
+		return ret;
+
+	if (data && data == dest) {
+		fit_image_verify_update(&v, data, size);
+		return fit_image_verify_finish(&v, 0);
+	}
+
+	if (!data) {
+		ret = fit_seek(handle, offset);
+		if (ret) {
+			pr_err("cannot seek to image data: %s\n",
+			       strerror(-ret));
+			return fit_image_verify_finish(&v, ret);
+		}
+	}
+
+	for (done = 0; done < size; done += now) {
+		now = min_t(unsigned long, size - done, FIT_LOAD_CHUNK);
+
+		if (data) {
+			memcpy(dest + done, data + done, now);
+		} else {
+			ret = read_full(handle->fd, dest + done, now);
+			if (ret >= 0 && ret < now)
+				ret = -EINVAL;
+			if (ret < 0) {
+				pr_err("cannot read image data: %s\n",
+				       strerror(-ret));
+				return fit_image_verify_finish(&v, ret);
+			}
+		}
+
+		fit_image_verify_update(&v, dest + done, now);
+	}
+
+	return fit_image_verify_finish(&v, 0);
+}
+
+/**
+ * fit_get_image_size - get the size of an image in a FIT image
+ * @handle: The FIT image handle
+ * @configuration: The configuration the image belongs to, or NULL
+ * @name: The name of the image
+ * @outsize: Size of the image
+ *
+ * This allows to reserve the space for fit_load_image() without loading the
+ * image before.
+ *
+ * Return: 0 for success, negative error code otherwise
+ */
+int fit_get_image_size(struct fit_handle *handle, void *configuration,
+		       const char *name, unsigned long *outsize)
+{
+	struct device_node *image;
+	const void *data;
+	loff_t offset;
+
+	image = fit_get_image(handle, configuration, name);
+	if (IS_ERR(image))
+		return PTR_ERR(image);
+
+	return fit_get_image_data(handle, image, &data, &offset, outsize);
+}
+
+/**
+ * fit_load_image - load and verify an image from a FIT image
+ * @handle: The FIT image handle
+ * @configuration: The configuration the image belongs to, or NULL
+ * @name: The name of the image to load
+ * @dest: Where the image is loaded to
+ * @size: Size of the space at @dest
+ *
+ * Like fit_open_image(), but the image is loaded directly to its final
+ * location. It is verified while being loaded, so the data is only passed
+ * once. The contents of @dest are undefined on failure.
+ *
+ * Return: 0 for success, negative error code otherwise
+ */
+int fit_load_image(struct fit_handle *handle, void *configuration,
+		   const char *name, void *dest, unsigned long size)
+{
+	struct device_node *image;
+	const char *desc = "(no description)";
+	const void *data;
+	loff_t offset;
+	unsigned long data_len;
+	int ret;
+
+	image = fit_get_image(handle, configuration, name);
+	if (IS_ERR(image))
+		return PTR_ERR(image);
+
+	of_property_read_string(image, "description", &desc);
+	pr_info("image '%s': '%s'\n", image->name, desc);
+
+	ret = fit_get_image_data(handle, image, &data, &offset, &data_len);
+	if (ret)
+		return ret;
+
+	if (data_len > size) {
+		pr_err("image '%s' does not fit into %lu bytes\n", image->name,
+		       size);
+		return -ENOSPC;
+	}
+
+	return fit_load_image_data(handle, configuration, image, data, offset,
+				   data_len, dest);
+}
+
 /**
  * fit_open_image - Open an image in a FIT image
  * @handle: The FIT image handle
@@ -527,49 +835,52 @@ int fit_open_image(struct fit_handle *handle, void *configuration,
 		   unsigned long *outsize)
 {
 	struct device_node *image;
-	const char *unit, *type = NULL, *desc= "(no description)";
+	const char *desc = "(no description)";
 	const void *data;
-	int data_len;
-	int ret = 0;
-	struct device_node *conf_node = configuration;
-
-	if (conf_node) {
-		if (of_property_read_string(conf_node, name, &unit)) {
-			pr_err("No image named '%s'\n", name);
-			return -ENOENT;
-		}
-	} else {
-		unit = name;
-	}
+	void *buf;
+	loff_t offset;
+	unsigned long data_len;
+	int ret;
 
-	image = of_get_child_by_name(handle->images, unit);
-	if (!image)
-		return -ENOENT;
+	image = fit_get_image(handle, configuration, name);
+	if (IS_ERR(image))
+		return PTR_ERR(image);
 
 	of_property_read_string(image, "description", &desc);
-	pr_info("image '%s': '%s'\n", unit, desc);
+	pr_info("image '%s': '%s'\n", image->name, desc);
 
-	of_property_read_string(image, "type", &type);
-	if (!type) {
-		pr_err("No \"type\" property found in %s\n", image->full_name);
-		return -EINVAL;
-	}
+	ret = fit_get_image_data(handle, image, &data, &offset, &data_len);
+	if (ret)
+		return ret;
 
-	data = of_get_property(image, "data", &data_len);
-	if (!data) {
-		pr_err("data not found\n");
-		return -EINVAL;
+	if (data) {
+		ret = fit_load_image_data(handle, configuration, image, data,
+					  offset, data_len, (void *)data);
+		if (ret < 0)
+			return ret;
+
+		*outdata = data;
+		*outsize = data_len;
+
+		return 0;
 	}
 
-	if (conf_node)
-		ret = fit_verify_hash(handle, image, data, data_len);
-	else
-		ret = fit_image_verify_signature(handle, image, data, data_len);
+	buf = malloc(data_len);
+	if (!buf)
+		return -ENOMEM;
 
-	if (ret < 0)
+	ret = fit_load_image_data(handle, configuration, image, NULL, offset,
+				  data_len, buf);
+	if (ret < 0) {
+		free(buf);
 		return ret;
+	}
+
+	handle->image_bufs = xrealloc(handle->image_bufs,
+			(handle->num_image_bufs + 1) * sizeof(void *));
+	handle->image_bufs[handle->num_image_bufs++] = buf;
 
-	*outdata = data;
+	*outdata = buf;
 	*outsize = data_len;
 
 	return 0;
@@ -738,6 +1049,7 @@ struct fit_handle *fit_open_buf(const void *buf, size_t size, bool verbose,
 	handle->fit = buf;
 	handle->size = size;
 	handle->verify = verify;
+	handle->fd = -1;
 
 	ret = fit_do_open(handle);
 	if (ret) {
@@ -748,6 +1060,50 @@ struct fit_handle *fit_open_buf(const void *buf, size_t size, bool verbose,
 	return handle;
 }
 
+/*
+ * Read the device tree part of a FIT image. When the image data is stored
+ * externally this is all of the FIT image which has to be kept in memory,
+ * the images are read later on by fit_open_image() or fit_load_image().
+ */
+static int fit_read_fdt(struct fit_handle *handle)
+{
+	struct fdt_header header;
+	size_t size;
+	void *buf;
+	int ret;
+
+	ret = read_full(handle->fd, &header, sizeof(header));
+	if (ret < 0)
+		return ret;
+	if (ret < sizeof(header) || fdt32_to_cpu(header.magic) != FDT_MAGIC)
+		return -EINVAL;
+
+	size = fdt32_to_cpu(header.totalsize);
+	if (size < sizeof(header))
+		return -EINVAL;
+
+	buf = malloc(size);
+	if (!buf)
+		return -ENOMEM;
+
+	memcpy(buf, &header, sizeof(header));
+
+	ret = read_full(handle->fd, buf + sizeof(header),
+			size - sizeof(header));
+	if (ret >= 0 && ret < size - sizeof(header))
+		ret = -EINVAL;
+	if (ret < 0) {
+		free(buf);
+		return ret;
+	}
+
+	handle->fit_alloc = buf;
+	handle->fit = buf;
+	handle->size = size;
+
+	return 0;
+}
+
 /**
  * fit_open - open a FIT image
  * @filename:	The filename of the FIT image
@@ -755,7 +1111,8 @@ struct fit_handle *fit_open_buf(const void *buf, size_t size, bool verbose,
  * @verify:	The verify mode
  *
  * This opens a FIT image found in @filename. The returned handle is used as
- * context for the other FIT functions.
+ * context for the other FIT functions. Only the device tree is read here,
+ * externally stored image data is read when the image is opened or loaded.
  *
  * Return: A handle to a FIT image or a ERR_PTR
  */
@@ -769,15 +1126,17 @@ struct fit_handle *fit_open(const char *filename, bool verbose,
 
 	handle->verbose = verbose;
 	handle->verify = verify;
+	handle->filename = xstrdup(filename);
 
-	ret = read_file_2(filename, &handle->size, &handle->fit_alloc,
-			  FILESIZE_MAX);
-	if (ret) {
-		pr_err("unable to read %s: %s\n", filename, strerror(-ret));
-		return ERR_PTR(ret);
+	handle->fd = open(filename, O_RDONLY);
+	if (handle->fd < 0) {
+		ret = handle->fd;
+		goto err;
 	}
 
-	handle->fit = handle->fit_alloc;
+	ret = fit_read_fdt(handle);
+	if (ret)
+		goto err;
 
 	ret = fit_do_open(handle);
 	if (ret) {
@@ -786,13 +1145,28 @@ struct fit_handle *fit_open(const char *filename, bool verbose,
 	}
 
 	return handle;
+err:
+	pr_err("unable to read %s: %s\n", filename, strerror(-ret));
+	fit_close(handle);
+
+	return ERR_PTR(ret);
 }
 
 void fit_close(struct fit_handle *handle)
 {
+	int i;
+
 	if (handle->root)
 		of_delete_node(handle->root);
 
+	if (handle->fd >= 0)
+		close(handle->fd);
+
+	for (i = 0; i < handle->num_image_bufs; i++)
+		free(handle->image_bufs[i]);
+
+	free(handle->image_bufs);
+	free(handle->filename);
 	free(handle->fit_alloc);
 	free(handle);
 }
@@ -0,0 +1,487 @@
+/*
+ * malloc_trace.c - record the live heap allocations and their callers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#define pr_fmt(fmt) "malloc_trace: " fmt
+
+#include <common.h>
+#include <clock.h>
+#include <command.h>
+#include <errno.h>
+#include <getopt.h>
+#include <init.h>
+#include <malloc.h>
+#include <module.h>
+#include <qsort.h>
+#include <asm-generic/div64.h>
+
+#define MALLOC_TRACE_HASH_SIZE	1024
+
+struct malloc_trace_record {
+	void *ptr;
+	void *caller;
+	size_t size;
+	uint64_t time;
+	/* next record in the hash chain or in the freelist */
+	struct malloc_trace_record *next;
+};
+
+/*
+ * The records live in a static table, allocating them from the heap
+ * would trace the tracing. Allocations which do not find a free record
+ * are only counted.
+ */
+static struct malloc_trace_record records[CONFIG_MALLOC_TRACE_RECORDS];
+static struct malloc_trace_record *hash[MALLOC_TRACE_HASH_SIZE];
+static struct malloc_trace_record *free_records;
+static int num_records;
+
+static size_t live_bytes, peak_bytes;
+static unsigned int live_allocs, untracked;
+
+/* set by helpers like xmalloc() to the address they are called from */
+static void *trace_caller;
+
+void *malloc_trace_enter(void *caller)
+{
+	void *prev = trace_caller;
+
+	if (!prev)
+		trace_caller = caller;
+
+	return prev;
+}
+
+void malloc_trace_leave(void **prev)
+{
+	trace_caller = *prev;
+}
+
+static struct malloc_trace_record **malloc_trace_head(const void *ptr)
+{
+	return &hash[((unsigned long)ptr >> 4) & (MALLOC_TRACE_HASH_SIZE - 1)];
+}
+
+static void malloc_trace_add(void *ptr, size_t size, void *caller)
+{
+	struct malloc_trace_record *r, **head;
+
+	if (!ptr)
+		return;
+
+	if (free_records) {
+		r = free_records;
+		free_records = r->next;
+	} else if (num_records < ARRAY_SIZE(records)) {
+		r = &records[num_records++];
+	} else {
+		untracked++;
+		return;
+	}
+
+	r->ptr = ptr;
+	r->caller = trace_caller ? trace_caller : caller;
+	r->size = size;
+	/* taking a timestamp would advance the dummy clocksource */
+	r->time = clocksource_registered() ? get_time_ns() : 0;
+
+	head = malloc_trace_head(ptr);
+	r->next = *head;
+	*head = r;
+
+	live_allocs++;
+	live_bytes += size;
+	if (live_bytes > peak_bytes)
+		peak_bytes = live_bytes;
+}
+
+static struct malloc_trace_record **malloc_trace_find(const void *ptr)
+{
+	struct malloc_trace_record *r, **pr;
+
+	for (pr = malloc_trace_head(ptr); (r = *pr); pr = &r->next)
+		if (r->ptr == ptr)
+			return pr;
+
+	return NULL;
+}
+
+static void malloc_trace_del(void *ptr)
+{
+	struct malloc_trace_record *r, **pr;
+
+	if (!ptr)
+		return;
+
+	pr = malloc_trace_find(ptr);
+	if (!pr)
+		return;
+
+	r = *pr;
+	*pr = r->next;
+	r->ptr = NULL;
+	r->next = free_records;
+	free_records = r;
+
+	live_allocs--;
+	live_bytes -= r->size;
+}
+
+void *malloc(size_t size)
+{
+	void *ptr = __malloc(size);
+
+	malloc_trace_add(ptr, size, __builtin_return_address(0));
+
+	return ptr;
+}
+EXPORT_SYMBOL(malloc);
+
+void *calloc(size_t n, size_t elem_size)
+{
+	void *ptr = __calloc(n, elem_size);
+
+	malloc_trace_add(ptr, n * elem_size, __builtin_return_address(0));
+
+	return ptr;
+}
+EXPORT_SYMBOL(calloc);
+
+void *memalign(size_t alignment, size_t size)
+{
+	void *ptr = __memalign(alignment, size);
+
+	malloc_trace_add(ptr, size, __builtin_return_address(0));
+
+	return ptr;
+}
+EXPORT_SYMBOL(memalign);
+
+void *realloc(void *oldptr, size_t size)
+{
+	void *ptr = __realloc(oldptr, size);
+
+	/* on failure the old allocation is still valid */
+	if (ptr || !size) {
+		malloc_trace_del(oldptr);
+		malloc_trace_add(ptr, size, __builtin_return_address(0));
+	}
+
+	return ptr;
+}
+EXPORT_SYMBOL(realloc);
+
+void free(void *ptr)
+{
+	malloc_trace_del(ptr);
+	__free(ptr);
+}
+EXPORT_SYMBOL(free);
+
+static int malloc_trace_compare(const void *a, const void *b)
+{
+	const struct malloc_trace_record *ra = a, *rb = b;
+
+	/* the free records go to the end */
+	if (!ra->ptr || !rb->ptr)
+		return !ra->ptr - !rb->ptr;
+
+	if (ra->caller == rb->caller)
+		return 0;
+
+	return ra->caller < rb->caller ? -1 : 1;
+}
+
+/*
+ * Sort the records by caller, so that the live records of each call site
+ * are next to each other at the start of the table, and rebuild the hash
+ * chains and the freelist. Summing up the call sites this way needs no
+ * memory, it is also done when barebox is out of memory.
+ */
+static void malloc_trace_sort(void)
+{
+	struct malloc_trace_record *r, **head;
+	int i;
+
+	qsort(records, num_records, sizeof(*records), malloc_trace_compare);
+
+	memset(hash, 0, sizeof(hash));
+	free_records = NULL;
+
+	for (i = num_records - 1; i >= 0; i--) {
+		r = &records[i];
+
+		if (r->ptr) {
+			head = malloc_trace_head(r->ptr);
+			r->next = *head;
+			*head = r;
+		} else {
+			r->next = free_records;
+			free_records = r;
+		}
+	}
+}
+
+/*
+ * Sum up the call site starting at records[*i] of the @live sorted live
+ * records and move *i to the next one.
+ */
+static void *malloc_trace_site(int *i, int live, size_t *bytes,
+			       unsigned int *allocs)
+{
+	void *caller = records[*i].caller;
+
+	*bytes = 0;
+	*allocs = 0;
+
+	for (; *i < live && records[*i].caller == caller; (*i)++) {
+		*bytes += records[*i].size;
+		(*allocs)++;
+	}
+
+	return caller;
+}
+
+/* call sites are shown by size, then by caller address */
+static int malloc_trace_site_before(size_t bytes, void *caller,
+				    size_t than_bytes, void *than_caller)
+{
+	if (bytes != than_bytes)
+		return bytes > than_bytes;
+
+	return caller > than_caller;
+}
+
+static void malloc_trace_sites(int max)
+{
+	size_t bytes, best_bytes = 0, prev_bytes = 0;
+	void *caller, *best = NULL, *prev = NULL;
+	unsigned int allocs, best_allocs = 0, num = 0;
+	int i, n, live;
+
+	malloc_trace_sort();
+
+	/* printing may allocate, only look at what is sorted */
+	live = live_allocs;
+
+	for (i = 0; i < live; num++)
+		malloc_trace_site(&i, live, &bytes, &allocs);
+
+	printf("%10s %8s  caller\n", "bytes", "allocs");
+
+	/*
+	 * Instead of sorting the call sites in a temporary array, every
+	 * round finds the largest one after the one shown before.
+	 */
+	for (n = 0; n < num && n < max; n++) {
+		best = NULL;
+
+		for (i = 0; i < live;) {
+			caller = malloc_trace_site(&i, live, &bytes, &allocs);
+
+			if (n && !malloc_trace_site_before(prev_bytes, prev,
+							   bytes, caller))
+				continue;
+
+			if (!best || malloc_trace_site_before(bytes, caller,
+							      best_bytes, best)) {
+				best = caller;
+				best_bytes = bytes;
+				best_allocs = allocs;
+			}
+		}
+
+		printf("%10zu %8u  %pS\n", best_bytes, best_allocs, best);
+
+		prev = best;
+		prev_bytes = best_bytes;
+	}
+
+	if (num > max)
+		printf("%u more call sites\n", num - max);
+}
+
+static void malloc_trace_summary(void)
+{
+	printf("live: %zu bytes in %u allocations, peak: %zu bytes\n",
+	       live_bytes, live_allocs, peak_bytes);
+	printf("largest free block: %zu bytes\n", malloc_largest_free());
+
+	if (untracked)
+		printf("%u allocations not tracked, increase "
+		       "CONFIG_MALLOC_TRACE_RECORDS\n", untracked);
+}
+
+/*
+ * Show the @max call sites with the most live allocated bytes, used when
+ * barebox runs out of memory.
+ */
+void malloc_trace_show(int max)
+{
+	malloc_trace_sites(max);
+	malloc_trace_summary();
+}
+
+#ifdef CONFIG_MALLOC_TRACE_SELFTEST
+/*
+ * Check the bookkeeping of malloc(), realloc() and free() and that the
+ * records are still found after malloc_trace_sort() rebuilt the hash.
+ */
+static int malloc_trace_selftest(void)
+{
+	unsigned int allocs = live_allocs, site_allocs;
+	size_t bytes = live_bytes, site_bytes;
+	struct malloc_trace_record **pr;
+	void *p[4], *caller, *site = NULL;
+	int i, live;
+
+	if (untracked) {
+		pr_info("selftest skipped, the records are full\n");
+		return 0;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(p); i++)
+		p[i] = malloc(100 * (i + 1));
+
+	if (live_allocs != allocs + 4 || live_bytes != bytes + 1000)
+		goto fail;
+
+	p[0] = realloc(p[0], 500);
+	free(p[1]);
+	p[1] = NULL;
+
+	if (live_allocs != allocs + 3 || live_bytes != bytes + 1200)
+		goto fail;
+
+	/* p[2] and p[3] share the call site of the loop above */
+	pr = malloc_trace_find(p[2]);
+	if (!pr)
+		goto fail;
+	caller = (*pr)->caller;
+
+	malloc_trace_sort();
+
+	live = live_allocs;
+	for (i = 0; i < live;) {
+		site = malloc_trace_site(&i, live, &site_bytes, &site_allocs);
+		if (site == caller)
+			break;
+	}
+
+	if (site != caller || site_bytes != 700 || site_allocs != 2)
+		goto fail;
+
+	for (i = 0; i < ARRAY_SIZE(p); i++) {
+		if (p[i] && !malloc_trace_find(p[i]))
+			goto fail;
+		free(p[i]);
+		p[i] = NULL;
+	}
+
+	if (live_allocs != allocs || live_bytes != bytes)
+		goto fail;
+
+	pr_info("selftest passed\n");
+
+	return 0;
+fail:
+	pr_err("selftest failed: %u allocations with %zu bytes live, %u with "
+	       "%zu before\n", live_allocs, live_bytes, allocs, bytes);
+
+	for (i = 0; i < ARRAY_SIZE(p); i++)
+		free(p[i]);
+
+	return -EINVAL;
+}
+late_initcall(malloc_trace_selftest);
+#endif
+
+#ifdef CONFIG_CMD_MALLOC_TRACE
+static int malloc_trace_age_ms(struct malloc_trace_record *r, uint64_t now)
+{
+	uint64_t age = now - r->time;
+
+	do_div(age, MSECOND);
+
+	return age;
+}
+
+static void malloc_trace_list(void)
+{
+	struct malloc_trace_record *r;
+	uint64_t now = get_time_ns();
+	int i;
+
+	printf("%-18s %10s %10s  caller\n", "address", "size", "age/ms");
+
+	for (i = 0; i < MALLOC_TRACE_HASH_SIZE; i++) {
+		for (r = hash[i]; r; r = r->next) {
+			printf("%-18p %10zu ", r->ptr, r->size);
+			/* made before a clocksource was registered */
+			if (r->time)
+				printf("%10d", malloc_trace_age_ms(r, now));
+			else
+				printf("%10s", "-");
+			printf("  %pS\n", r->caller);
+		}
+	}
+}
+
+static int do_malloc_trace(int argc, char *argv[])
+{
+	int opt, max = 20, all = 0;
+
+	while ((opt = getopt(argc, argv, "an:r")) > 0) {
+		switch (opt) {
+		case 'a':
+			all = 1;
+			break;
+		case 'n':
+			max = simple_strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			peak_bytes = live_bytes;
+			return 0;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (all)
+		malloc_trace_list();
+	else
+		malloc_trace_sites(max);
+
+	malloc_trace_summary();
+
+	return 0;
+}
+
+BAREBOX_CMD_HELP_START(malloc_trace)
+BAREBOX_CMD_HELP_TEXT("Show the live heap allocations summed up by the code which made")
+BAREBOX_CMD_HELP_TEXT("them, largest first, together with the peak heap usage and the")
+BAREBOX_CMD_HELP_TEXT("largest block which can still be allocated. Allocations made")
+BAREBOX_CMD_HELP_TEXT("through helpers like xmalloc() are shown with their caller.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-a", "list every live allocation with its age")
+BAREBOX_CMD_HELP_OPT ("-n NUM", "show at most NUM call sites (default 20)")
+BAREBOX_CMD_HELP_OPT ("-r", "reset the peak usage to the current usage")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(malloc_trace)
+	.cmd		= do_malloc_trace,
+	BAREBOX_CMD_DESC("show the heap allocations and their callers")
+	BAREBOX_CMD_OPTS("[-anr]")
+	BAREBOX_CMD_GROUP(CMD_GRP_INFO)
+	BAREBOX_CMD_HELP(cmd_malloc_trace_help)
+BAREBOX_CMD_END
+#endif
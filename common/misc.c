@@ -197,6 +197,8 @@ void __noreturn panic(const char *fmt, ...)
 
 	dump_stack();
 
+	console_flush();
+
 	led_trigger(LED_TRIGGER_PANIC, TRIGGER_ENABLE);
 
 	if (IS_ENABLED(CONFIG_PANIC_HANG)) {
@@ -6,16 +6,24 @@
  */
 
 #include <common.h>
+#include <command.h>
 #include <driver.h>
+#include <getopt.h>
 #include <malloc.h>
 #include <module.h>
 #include <param.h>
 #include <poller.h>
 #include <clock.h>
+#include <asm-generic/div64.h>
 
 static LIST_HEAD(poller_list);
 static int poller_active;
 
+/* all registered asynchronous pollers */
+static LIST_HEAD(poller_async_list);
+/* the scheduled asynchronous calls, earliest first */
+static LIST_HEAD(poller_queue);
+
 int poller_register(struct poller_struct *poller)
 {
 	if (poller->registered)
@@ -39,20 +47,6 @@ int poller_unregister(struct poller_struct *poller)
 	return 0;
 }
 
-static void poller_async_callback(struct poller_struct *poller)
-{
-	struct poller_async *pa = container_of(poller, struct poller_async, poller);
-
-	if (!pa->active)
-		return;
-
-	if (get_time_ns() < pa->end)
-		return;
-
-	pa->active = 0;
-	pa->fn(pa->ctx);
-}
-
 /*
  * Cancel an outstanding asynchronous function call
  *
@@ -65,6 +59,9 @@ static void poller_async_callback(struct poller_struct *poller)
  */
 int poller_async_cancel(struct poller_async *pa)
 {
+	if (pa->active)
+		list_del_init(&pa->queue);
+
 	pa->active = 0;
 
 	return 0;
@@ -84,38 +81,193 @@ int poller_async_cancel(struct poller_async *pa)
 int poller_call_async(struct poller_async *pa, uint64_t delay_ns,
 		void (*fn)(void *), void *ctx)
 {
+	struct poller_async *pos;
+
+	poller_async_cancel(pa);
+
 	pa->ctx = ctx;
 	pa->end = get_time_ns() + delay_ns;
 	pa->fn = fn;
 	pa->active = 1;
 
+	/* keep the queue sorted, the new call goes after earlier ones */
+	list_for_each_entry(pos, &poller_queue, queue)
+		if (pos->end > pa->end)
+			break;
+
+	list_add_tail(&pa->queue, &pos->queue);
+
 	return 0;
 }
 
 int poller_async_register(struct poller_async *pa)
 {
-	pa->poller.func = poller_async_callback;
+	if (pa->poller.registered)
+		return -EBUSY;
+
 	pa->active = 0;
+	INIT_LIST_HEAD(&pa->queue);
+
+	list_add_tail(&pa->poller.list, &poller_async_list);
+	pa->poller.registered = 1;
 
-	return poller_register(&pa->poller);
+	return 0;
 }
 
 int poller_async_unregister(struct poller_async *pa)
 {
-	return poller_unregister(&pa->poller);
+	if (!pa->poller.registered)
+		return -ENODEV;
+
+	poller_async_cancel(pa);
+
+	list_del(&pa->poller.list);
+	pa->poller.registered = 0;
+
+	return 0;
+}
+
+static void poller_account(struct poller_struct *poller, uint64_t start)
+{
+	if (!IS_ENABLED(CONFIG_CMD_POLLER))
+		return;
+
+	poller->time_ns += get_time_ns() - start;
+	poller->calls++;
+}
+
+static uint64_t poller_start(void)
+{
+	return IS_ENABLED(CONFIG_CMD_POLLER) ? get_time_ns() : 0;
+}
+
+/* run the asynchronous calls which are due */
+static void poller_run_async(void)
+{
+	struct poller_async *pa, *tmp;
+	LIST_HEAD(due);
+	uint64_t now, start;
+
+	if (list_empty(&poller_queue))
+		return;
+
+	now = get_time_ns();
+
+	/*
+	 * Move the due calls away first, so that calls rescheduled from
+	 * their callbacks run in the next round at the earliest.
+	 */
+	list_for_each_entry_safe(pa, tmp, &poller_queue, queue) {
+		if (pa->end > now)
+			break;
+		list_move_tail(&pa->queue, &due);
+	}
+
+	while (!list_empty(&due)) {
+		pa = list_first_entry(&due, struct poller_async, queue);
+
+		list_del_init(&pa->queue);
+		pa->active = 0;
+
+		start = poller_start();
+		pa->fn(pa->ctx);
+		poller_account(&pa->poller, start);
+	}
 }
 
 void poller_call(void)
 {
 	struct poller_struct *poller, *tmp;
+	uint64_t start;
 
 	if (poller_active)
 		return;
 
 	poller_active = 1;
 
-	list_for_each_entry_safe(poller, tmp, &poller_list, list)
+	list_for_each_entry_safe(poller, tmp, &poller_list, list) {
+		start = poller_start();
 		poller->func(poller);
+		poller_account(poller, start);
+	}
+
+	poller_run_async();
 
 	poller_active = 0;
 }
+
+#ifdef CONFIG_CMD_POLLER
+static void poller_print(struct poller_struct *poller, void *fn)
+{
+	uint64_t avg = poller->time_ns, us = poller->time_ns;
+
+	if (poller->calls)
+		do_div(avg, poller->calls);
+	do_div(us, USECOND);
+
+	printf("%10lu %12llu %8llu  %pS\n", poller->calls, us, avg, fn);
+}
+
+static int do_poller(int argc, char *argv[])
+{
+	struct poller_struct *poller;
+	struct poller_async *pa;
+	int opt, clear = 0;
+
+	while ((opt = getopt(argc, argv, "c")) > 0) {
+		switch (opt) {
+		case 'c':
+			clear = 1;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (clear) {
+		list_for_each_entry(poller, &poller_list, list)
+			poller->time_ns = poller->calls = 0;
+		list_for_each_entry(poller, &poller_async_list, list)
+			poller->time_ns = poller->calls = 0;
+		return 0;
+	}
+
+	printf("     calls      time/us   avg/ns  poller\n");
+
+	list_for_each_entry(poller, &poller_list, list)
+		poller_print(poller, poller->func);
+
+	printf("asynchronous:\n");
+
+	list_for_each_entry(pa, &poller_async_list, poller.list) {
+		poller_print(&pa->poller, pa->fn);
+
+		if (pa->active) {
+			uint64_t now = get_time_ns();
+			uint64_t ms = pa->end > now ? pa->end - now : 0;
+
+			do_div(ms, MSECOND);
+			printf("%34s due in %llu ms\n", "", ms);
+		}
+	}
+
+	return 0;
+}
+
+BAREBOX_CMD_HELP_START(poller)
+BAREBOX_CMD_HELP_TEXT("Show the registered pollers with the number of calls and the")
+BAREBOX_CMD_HELP_TEXT("time spent in them. Asynchronous pollers are only called when")
+BAREBOX_CMD_HELP_TEXT("they are due.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-c", "clear the statistics")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(poller)
+	.cmd		= do_poller,
+	BAREBOX_CMD_DESC("show pollers and their CPU usage")
+	BAREBOX_CMD_OPTS("[-c]")
+	BAREBOX_CMD_GROUP(CMD_GRP_INFO)
+	BAREBOX_CMD_HELP(cmd_poller_help)
+BAREBOX_CMD_END
+#endif
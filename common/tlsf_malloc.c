@@ -24,6 +24,20 @@
 #include <module.h>
 #include <tlsf.h>
 
+#ifdef CONFIG_MALLOC_TRACE
+/* the public functions are provided by the tracing in malloc_trace.c */
+#undef malloc
+#undef free
+#undef realloc
+#undef memalign
+#undef calloc
+#define malloc		__malloc
+#define free		__free
+#define realloc		__realloc
+#define memalign	__memalign
+#define calloc		__calloc
+#endif
+
 extern tlsf_pool tlsf_mem_pool;
 
 void *malloc(size_t bytes)
@@ -76,16 +90,29 @@ EXPORT_SYMBOL(memalign);
 struct malloc_stats {
 	size_t free;
 	size_t used;
+	size_t largest;
 };
 
 static void malloc_walker(void* ptr, size_t size, int used, void *user)
 {
 	struct malloc_stats *s = user;
 
-	if (used)
+	if (used) {
 		s->used += size;
-	else
+	} else {
 		s->free += size;
+		if (size > s->largest)
+			s->largest = size;
+	}
+}
+
+size_t malloc_largest_free(void)
+{
+	struct malloc_stats s = {};
+
+	tlsf_walk_heap(tlsf_mem_pool, malloc_walker, &s);
+
+	return s.largest;
 }
 
 void malloc_stats(void)
@@ -94,6 +121,7 @@ void malloc_stats(void)
 
 	s.used = 0;
 	s.free = 0;
+	s.largest = 0;
 
 	tlsf_walk_heap(tlsf_mem_pool, malloc_walker, &s);
 
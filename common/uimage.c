@@ -30,6 +30,7 @@
 #include <rtc.h>
 #include <filetype.h>
 #include <memory.h>
+#include <linux/sizes.h>
 
 static inline int uimage_is_multi_image(struct uimage_handle *handle)
 {
@@ -298,6 +299,64 @@ err:
 }
 EXPORT_SYMBOL(uimage_verify);
 
+#define UIMAGE_LOAD_BUFSIZE	SZ_64K
+
+/*
+ * Decompress @len bytes from @fd to the flush function. The data is
+ * decompressed piecewise while it is read.
+ */
+static int uimage_uncompress(int fd, size_t len,
+			     int(*flush)(void*, unsigned int))
+{
+	struct uncompress_stream *us;
+	void *inbuf, *outbuf;
+	size_t now;
+	ssize_t out;
+	int ret;
+
+	us = uncompress_stream_init(uncompress_err_stdout);
+	inbuf = xmalloc(UIMAGE_LOAD_BUFSIZE);
+	outbuf = xmalloc(UIMAGE_LOAD_BUFSIZE);
+
+	do {
+		now = min_t(size_t, len, UIMAGE_LOAD_BUFSIZE);
+		if (now) {
+			ret = read_full(fd, inbuf, now);
+			if (ret < 0)
+				goto out;
+			if (ret < now) {
+				ret = -EINVAL;
+				goto out;
+			}
+			len -= now;
+		}
+
+		ret = uncompress_stream_feed(us, now ? inbuf : NULL, now);
+		if (ret)
+			goto out;
+
+		while ((out = uncompress_stream_drain(us, outbuf,
+						      UIMAGE_LOAD_BUFSIZE)) > 0) {
+			ret = flush(outbuf, out);
+			if (ret < 0)
+				goto out;
+		}
+
+		if (out < 0) {
+			ret = out;
+			goto out;
+		}
+	} while (now);
+
+	ret = 0;
+out:
+	uncompress_stream_free(us);
+	free(inbuf);
+	free(outbuf);
+
+	return ret;
+}
+
 /*
  * Load a uimage, flushing output to flush function
  */
@@ -307,12 +366,6 @@ int uimage_load(struct uimage_handle *handle, unsigned int image_no,
 	image_header_t *hdr = &handle->header;
 	struct uimage_handle_data *iha;
 	int ret;
-	int (*uncompress_fn)(unsigned char *inbuf, int len,
-		    int(*fill)(void*, unsigned int),
-	            int(*flush)(void*, unsigned int),
-		    unsigned char *output,
-	            int *pos,
-		    void(*error)(char *x));
 
 	if (image_no >= handle->nb_data_entries)
 		return -EINVAL;
@@ -325,17 +378,13 @@ int uimage_load(struct uimage_handle *handle, unsigned int image_no,
 		return ret;
 
 	/* if ramdisk U-Boot expect to ignore the compression type */
-	if (hdr->ih_comp == IH_COMP_NONE || hdr->ih_type == IH_TYPE_RAMDISK)
-		uncompress_fn = uncompress_copy;
-	else
-		uncompress_fn = uncompress;
+	if (hdr->ih_comp != IH_COMP_NONE && hdr->ih_type != IH_TYPE_RAMDISK)
+		return uimage_uncompress(handle->fd, iha->len, flush);
 
 	uimage_fd = handle->fd;
 
-	ret = uncompress_fn(NULL, iha->len, uimage_fill, flush,
-				NULL, NULL,
-				uncompress_err_stdout);
-	return ret;
+	return uncompress_copy(NULL, iha->len, uimage_fill, flush,
+			       NULL, NULL, uncompress_err_stdout);
 }
 EXPORT_SYMBOL(uimage_load);
 
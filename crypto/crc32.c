@@ -22,9 +22,15 @@
 #define STATIC static inline
 #endif
 
-#ifdef CONFIG_DYNAMIC_CRC_TABLE
+/*
+ * Tables for slicing-by-8: crc_slice[k][n] is the CRC of the byte n followed
+ * by k zero bytes, so eight bytes can be processed with eight independent
+ * lookups. crc_slice[0] is the usual byte-wise table.
+ */
+static uint32_t crc_slice[8][256];
+static int crc_slice_valid;
 
-static ulong *crc_table;
+#ifdef CONFIG_DYNAMIC_CRC_TABLE
 
 /*
   Generate a table for a byte-wise 32-bit CRC calculation on the polynomial:
@@ -63,14 +69,12 @@ static void make_crc_table(void)
   for (n = 0; n < sizeof(p)/sizeof(char); n++)
     poly |= 1L << (31 - p[n]);
 
-  crc_table = xmalloc(sizeof(ulong) * 256);
-
   for (n = 0; n < 256; n++)
   {
     c = (ulong)n;
     for (k = 0; k < 8; k++)
       c = c & 1 ? poly ^ (c >> 1) : c >> 1;
-    crc_table[n] = c;
+    crc_slice[0][n] = c;
   }
 }
 #else
@@ -134,58 +138,112 @@ static const ulong crc_table[256] = {
 #endif
 
 
-/* ========================================================================= */
-#define DO1(buf) crc = crc_table[((int)crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
-#define DO2(buf)  DO1(buf); DO1(buf);
-#define DO4(buf)  DO2(buf); DO2(buf);
-#define DO8(buf)  DO4(buf); DO4(buf);
-
-/* ========================================================================= */
-STATIC uint32_t crc32(uint32_t crc, const void *_buf, unsigned int len)
+static void make_crc_slice_table(void)
 {
-    const unsigned char *buf = _buf;
+	uint32_t c;
+	int n, k;
 
 #ifdef CONFIG_DYNAMIC_CRC_TABLE
-	if (!crc_table)
-		make_crc_table();
+	make_crc_table();
+#else
+	for (n = 0; n < 256; n++)
+		crc_slice[0][n] = crc_table[n];
 #endif
-    crc = crc ^ 0xffffffffL;
-    while (len >= 8)
-    {
-      DO8(buf);
-      len -= 8;
-    }
-    if (len) do {
-      DO1(buf);
-    } while (--len);
-    return crc ^ 0xffffffffL;
+	for (n = 0; n < 256; n++) {
+		c = crc_slice[0][n];
+		for (k = 1; k < 8; k++) {
+			c = crc_slice[0][c & 0xff] ^ (c >> 8);
+			crc_slice[k][n] = c;
+		}
+	}
+
+	crc_slice_valid = 1;
+}
+
+/* ========================================================================= */
+#define DO1(buf) crc = crc_slice[0][(crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
+
+/*
+ * The bytes are combined one by one, so this works for any alignment and
+ * endianess of the buffer.
+ */
+#define DO8(buf)							\
+	crc = crc_slice[7][(crc ^ buf[0]) & 0xff] ^			\
+	      crc_slice[6][((crc >> 8) ^ buf[1]) & 0xff] ^		\
+	      crc_slice[5][((crc >> 16) ^ buf[2]) & 0xff] ^		\
+	      crc_slice[4][(crc >> 24) ^ buf[3]] ^			\
+	      crc_slice[3][buf[4]] ^ crc_slice[2][buf[5]] ^		\
+	      crc_slice[1][buf[6]] ^ crc_slice[0][buf[7]];		\
+	buf += 8;
+
+/*
+ * CRC without the ones complement, this is the generic implementation
+ * of crc32_no_comp() which is used when no faster one is registered.
+ */
+STATIC uint32_t crc32_no_comp_generic(uint32_t crc, const void *_buf,
+				      unsigned int len)
+{
+	const unsigned char *buf = _buf;
+
+	if (!crc_slice_valid)
+		make_crc_slice_table();
+
+	while (len >= 8) {
+		DO8(buf);
+		len -= 8;
+	}
+	while (len--) {
+		DO1(buf);
+	}
+
+	return crc;
 }
+
 #ifdef __BAREBOX__
-EXPORT_SYMBOL(crc32);
+EXPORT_SYMBOL(crc32_no_comp_generic);
+
+static uint32_t (*crc32_arch)(uint32_t crc, const void *buf, unsigned int len);
+static const char *crc32_arch_driver;
+
+/*
+ * Register an implementation of crc32_no_comp() which uses special CPU
+ * instructions. Architectures call this once they have checked that the
+ * CPU supports the instructions.
+ */
+void crc32_register_arch(const char *name,
+		uint32_t (*fn)(uint32_t crc, const void *buf, unsigned int len))
+{
+	crc32_arch = fn;
+	crc32_arch_driver = name;
+}
+
+/* The name of the registered implementation or NULL when there is none */
+const char *crc32_arch_name(void)
+{
+	return crc32_arch_driver;
+}
 #endif
 
 /* No ones complement version. JFFS2 (and other things ?)
  * don't use ones compliment in their CRC calculations.
  */
-STATIC uint32_t crc32_no_comp(uint32_t crc, const void *_buf, unsigned int len)
+STATIC uint32_t crc32_no_comp(uint32_t crc, const void *buf, unsigned int len)
 {
-   const unsigned char *buf = _buf;
-
-#ifdef CONFIG_DYNAMIC_CRC_TABLE
-	if (!crc_table)
-		make_crc_table();
+#ifdef __BAREBOX__
+	if (crc32_arch)
+		return crc32_arch(crc, buf, len);
 #endif
-    while (len >= 8)
-    {
-      DO8(buf);
-      len -= 8;
-    }
-    if (len) do {
-      DO1(buf);
-    } while (--len);
-
-    return crc;
+	return crc32_no_comp_generic(crc, buf, len);
+}
+
+/* ========================================================================= */
+STATIC uint32_t crc32(uint32_t crc, const void *buf, unsigned int len)
+{
+	return crc32_no_comp(crc ^ 0xffffffffL, buf, len) ^ 0xffffffffL;
 }
+#ifdef __BAREBOX__
+EXPORT_SYMBOL(crc32);
+#endif
 
 STATIC int file_crc(char *filename, ulong start, ulong size, ulong *crc,
 		    ulong *total)
@@ -52,6 +52,21 @@ static int crc32_update(struct digest *desc, const void *data,
 	return 0;
 }
 
+static int crc32_generic_update(struct digest *desc, const void *data,
+				unsigned long len)
+{
+	struct crc32_state *ctx = digest_ctx(desc);
+
+	while (len) {
+		int now = min((ulong)4096, len);
+		ctx->crc = ~crc32_no_comp_generic(~ctx->crc, data, now);
+		len -= now;
+		data += now;
+	}
+
+	return 0;
+}
+
 static int crc32_final(struct digest *desc, unsigned char *md)
 {
 	struct crc32_state *ctx = digest_ctx(desc);
@@ -74,6 +89,23 @@ static struct digest_algo m = {
 		.algo		=	HASH_ALGO_CRC32,
 	},
 
+	.init		= crc32_init,
+	.update		= crc32_generic_update,
+	.final		= crc32_final,
+	.digest		= digest_generic_digest,
+	.verify		= digest_generic_verify,
+	.length		= CRC32_DIGEST_SIZE,
+	.ctx_length = sizeof(struct crc32_state),
+};
+
+/* crc32() with the implementation registered by the architecture */
+static struct digest_algo m_arch = {
+	.base = {
+		.name		=	"crc32",
+		.priority	=	200,
+		.algo		=	HASH_ALGO_CRC32,
+	},
+
 	.init		= crc32_init,
 	.update		= crc32_update,
 	.final		= crc32_final,
@@ -85,6 +117,15 @@ static struct digest_algo m = {
 
 static int crc32_digest_register(void)
 {
-	return digest_algo_register(&m);
+	const char *arch = crc32_arch_name();
+	int ret;
+
+	ret = digest_algo_register(&m);
+	if (ret || !arch)
+		return ret;
+
+	m_arch.base.driver_name = (char *)arch;
+
+	return digest_algo_register(&m_arch);
 }
 device_initcall(crc32_digest_register);
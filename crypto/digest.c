@@ -25,9 +25,11 @@
 #include <errno.h>
 #include <module.h>
 #include <linux/err.h>
+#include <dma.h>
+#include <libfile.h>
 #include <crypto/internal.h>
 
-static LIST_HEAD(digests);
+LIST_HEAD(digest_algo_list);
 
 static struct digest_algo *digest_algo_get_by_name(const char *name);
 
@@ -89,7 +91,7 @@ int digest_algo_register(struct digest_algo *d)
 	if (!d->free)
 		d->free = dummy_free;
 
-	list_add_tail(&d->list, &digests);
+	list_add_tail(&d->list, &digest_algo_list);
 
 	return 0;
 }
@@ -113,7 +115,7 @@ static struct digest_algo *digest_algo_get_by_name(const char *name)
 	if (!name)
 		return NULL;
 
-	list_for_each_entry(tmp, &digests, list) {
+	list_for_each_entry(tmp, &digest_algo_list, list) {
 		if (strcmp(tmp->base.name, name) != 0)
 			continue;
 
@@ -133,7 +135,7 @@ static struct digest_algo *digest_algo_get_by_algo(enum hash_algo algo)
 	struct digest_algo *tmp;
 	int priority = -1;
 
-	list_for_each_entry(tmp, &digests, list) {
+	list_for_each_entry(tmp, &digest_algo_list, list) {
 		if (tmp->base.algo != algo)
 			continue;
 
@@ -153,21 +155,32 @@ void digest_algo_prints(const char *prefix)
 
 	printf("%s%-15s\t%-20s\t%-15s\n", prefix, "name", "driver", "priority");
 	printf("%s--------------------------------------------------\n", prefix);
-	list_for_each_entry(d, &digests, list) {
+	list_for_each_entry(d, &digest_algo_list, list) {
 		printf("%s%-15s\t%-20s\t%d\n", prefix, d->base.name,
 			d->base.driver_name, d->base.priority);
 	}
 }
 
-struct digest *digest_alloc(const char *name)
+static struct digest_algo *digest_algo_get_by_driver_name(const char *name)
 {
-	struct digest *d;
-	struct digest_algo *algo;
+	struct digest_algo *tmp;
 
-	algo = digest_algo_get_by_name(name);
-	if (!algo)
+	if (!name)
 		return NULL;
 
+	list_for_each_entry(tmp, &digest_algo_list, list) {
+		if (tmp->base.driver_name &&
+		    !strcmp(tmp->base.driver_name, name))
+			return tmp;
+	}
+
+	return NULL;
+}
+
+static struct digest *digest_alloc_algo(struct digest_algo *algo)
+{
+	struct digest *d;
+
 	d = xzalloc(sizeof(*d));
 	d->algo = algo;
 	d->ctx = xzalloc(algo->ctx_length);
@@ -178,26 +191,35 @@ struct digest *digest_alloc(const char *name)
 
 	return d;
 }
+
+/*
+ * Allocate a digest by algorithm name ("sha256"), which picks the
+ * implementation with the highest priority, or by driver name
+ * ("sha256-generic") to get a specific one.
+ */
+struct digest *digest_alloc(const char *name)
+{
+	struct digest_algo *algo;
+
+	algo = digest_algo_get_by_name(name);
+	if (!algo)
+		algo = digest_algo_get_by_driver_name(name);
+	if (!algo)
+		return NULL;
+
+	return digest_alloc_algo(algo);
+}
 EXPORT_SYMBOL_GPL(digest_alloc);
 
 struct digest *digest_alloc_by_algo(enum hash_algo hash_algo)
 {
-	struct digest *d;
 	struct digest_algo *algo;
 
 	algo = digest_algo_get_by_algo(hash_algo);
 	if (!algo)
 		return NULL;
 
-	d = xzalloc(sizeof(*d));
-	d->algo = algo;
-	d->ctx = xzalloc(algo->ctx_length);
-	if (d->algo->alloc(d)) {
-		digest_free(d);
-		return NULL;
-	}
-
-	return d;
+	return digest_alloc_algo(algo);
 }
 EXPORT_SYMBOL_GPL(digest_alloc_by_algo);
 
@@ -216,7 +238,7 @@ int digest_file_window(struct digest *d, const char *filename,
 		       const unsigned char *sig,
 		       ulong start, ulong size)
 {
-	ulong len = 0;
+	ulong len = 0, bufsize = CONFIG_DIGEST_FILE_BUFSIZE;
 	int fd, now, ret = 0;
 	unsigned char *buf;
 	int flags = 0;
@@ -233,7 +255,16 @@ int digest_file_window(struct digest *d, const char *filename,
 
 	buf = memmap(fd, PROT_READ);
 	if (buf == (void *)-1) {
-		buf = xmalloc(4096);
+		/*
+		 * stream through a DMA capable buffer, no bigger than needed
+		 * but at least one page, also for an empty file
+		 */
+		bufsize = ALIGN(max_t(ulong, min(bufsize, size), 1), 4096);
+		buf = dma_alloc(bufsize);
+		if (!buf) {
+			ret = -ENOMEM;
+			goto out;
+		}
 		flags = 1;
 	}
 
@@ -242,7 +273,7 @@ int digest_file_window(struct digest *d, const char *filename,
 			ret = lseek(fd, start, SEEK_SET);
 			if (ret == -1) {
 				perror("lseek");
-				goto out;
+				goto out_free;
 			}
 		} else {
 			buf += start;
@@ -250,9 +281,9 @@ int digest_file_window(struct digest *d, const char *filename,
 	}
 
 	while (size) {
-		now = min((ulong)4096, size);
+		now = min(bufsize, size);
 		if (flags) {
-			now = read(fd, buf, now);
+			now = read_full(fd, buf, now);
 			if (now < 0) {
 				ret = now;
 				perror("read");
@@ -284,7 +315,7 @@ int digest_file_window(struct digest *d, const char *filename,
 
 out_free:
 	if (flags)
-		free(buf);
+		dma_free(buf);
 out:
 	close(fd);
 
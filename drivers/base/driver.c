@@ -36,6 +36,7 @@
 #include <linux/err.h>
 #include <complete.h>
 #include <pinctrl.h>
+#include <boottrace.h>
 
 LIST_HEAD(device_list);
 EXPORT_SYMBOL(device_list);
@@ -45,8 +46,10 @@ EXPORT_SYMBOL(driver_list);
 
 static LIST_HEAD(active);
 static LIST_HEAD(deferred);
+/* devices matched by a probe_async driver, waiting to be probed */
+static LIST_HEAD(async);
 
-struct device_d *get_device_by_name(const char *name)
+static struct device_d *__get_device_by_name(const char *name)
 {
 	struct device_d *dev;
 
@@ -58,6 +61,21 @@ struct device_d *get_device_by_name(const char *name)
 	return NULL;
 }
 
+struct device_d *get_device_by_name(const char *name)
+{
+	struct device_d *dev;
+
+	dev = __get_device_by_name(name);
+	if (dev)
+		return dev;
+
+	/* the device may be registered by a driver still waiting to be probed */
+	if (IS_ENABLED(CONFIG_ASYNC_PROBE) && wait_for_device_probe())
+		dev = __get_device_by_name(name);
+
+	return dev;
+}
+
 static struct device_d *get_device_by_name_id(const char *name, int id)
 {
 	struct device_d *dev;
@@ -83,13 +101,15 @@ int get_free_deviceid(const char *name_template)
 
 int device_probe(struct device_d *dev)
 {
-	int ret;
+	int ret, trace;
 
 	pinctrl_select_state_default(dev);
 
 	list_add(&dev->active, &active);
 
+	trace = boottrace_start(dev_name(dev), NULL);
 	ret = dev->bus->probe(dev);
+	boottrace_end(trace);
 	if (ret == 0)
 		return 0;
 
@@ -108,8 +128,126 @@ int device_probe(struct device_d *dev)
 	return ret;
 }
 
+static bool device_probe_pending(struct device_d *dev)
+{
+	struct device_d *pending;
+
+	list_for_each_entry(pending, &async, active)
+		if (pending == dev)
+			return true;
+
+	return false;
+}
+
+static void device_reprobe_deferred(void);
+
+static int device_probe_pending_one(struct device_d *dev)
+{
+	int ret;
+
+	list_del_init(&dev->active);
+
+	ret = device_probe(dev);
+	if (ret) {
+		dev->driver = NULL;
+		return ret;
+	}
+
+	/* devices depending on this one may have been deferred */
+	device_reprobe_deferred();
+
+	return 0;
+}
+
+/**
+ * device_probe_idle - probe a device waiting to be probed
+ *
+ * Called by the console while it waits for input, i.e. from the shell
+ * prompt and the autoboot countdown. This is not done from a poller:
+ * pollers also run from is_timeout() and ctrlc() in arbitrary code, which
+ * may itself be probing a device or be in the middle of accessing one
+ * the probe would touch. Only one device is probed per call so that the
+ * console stays responsive.
+ */
+void device_probe_idle(void)
+{
+	if (list_empty(&async))
+		return;
+
+	device_probe_pending_one(list_first_entry(&async, struct device_d,
+						  active));
+}
+
+/**
+ * device_wait_probe - make sure a device is probed
+ * @dev: the device
+ *
+ * Devices of drivers with probe_async set are probed in the background.
+ * Users which need the device, its children or its cdevs call this to
+ * probe it right away when this hasn't happened yet. Returns the result
+ * of the probe or 0 when the device wasn't waiting to be probed.
+ */
+int device_wait_probe(struct device_d *dev)
+{
+	if (!device_probe_pending(dev))
+		return 0;
+
+	return device_probe_pending_one(dev);
+}
+
+/**
+ * wait_for_device_probe - probe all devices waiting to be probed
+ *
+ * Returns the number of devices probed, so that callers looking up
+ * something by name can retry when the lookup failed before.
+ */
+int wait_for_device_probe(void)
+{
+	int n = 0;
+
+	while (!list_empty(&async)) {
+		device_probe_pending_one(list_first_entry(&async,
+					 struct device_d, active));
+		n++;
+	}
+
+	return n;
+}
+
+/**
+ * device_probe_on_demand - give devices a chance to provide @name
+ * @name: the name of a device file or network interface which wasn't found
+ *
+ * Probes the devices waiting to be probed in the background. With
+ * CONFIG_DETECT_ON_ACCESS the devices @name belongs to by its name are
+ * detected, e.g. mmc0 for mmc0.0. Returns nonzero when the lookup should
+ * be retried.
+ */
+int device_probe_on_demand(const char *name)
+{
+	static int in_probe_on_demand;
+	int n;
+
+	/* the detection itself may look for device files */
+	if (in_probe_on_demand)
+		return 0;
+
+	in_probe_on_demand = 1;
+
+	n = wait_for_device_probe();
+
+	if (IS_ENABLED(CONFIG_DETECT_ON_ACCESS) && !device_detect_by_name(name))
+		n++;
+
+	in_probe_on_demand = 0;
+
+	return n;
+}
+
 int device_detect(struct device_d *dev)
 {
+	device_wait_probe(dev);
+
 	if (!dev->detect)
 		return -ENOSYS;
 	return dev->detect(dev);
@@ -144,6 +282,8 @@ void device_detect_all(void)
 {
 	struct device_d *dev;
 
+	wait_for_device_probe();
+
 	for_each_device(dev)
 		device_detect(dev);
 }
@@ -159,6 +299,13 @@ static int match(struct driver_d *drv, struct device_d *dev)
 
 	if (dev->bus->match(dev, drv))
 		goto err_out;
+
+	if (IS_ENABLED(CONFIG_ASYNC_PROBE) && drv->probe_async) {
+		dev_dbg(dev, "probe in background\n");
+		list_add_tail(&dev->active, &async);
+		return 0;
+	}
+
 	ret = device_probe(dev);
 	if (ret)
 		goto err_out;
@@ -220,6 +367,9 @@ int unregister_device(struct device_d *old_dev)
 
 	dev_remove_parameters(old_dev);
 
+	if (device_probe_pending(old_dev))
+		old_dev->driver = NULL;
+
 	if (old_dev->driver)
 		old_dev->bus->remove(old_dev);
 
@@ -251,10 +401,8 @@ EXPORT_SYMBOL(unregister_device);
  * Loop over list of deferred devices as long as at least one
  * device is successfully probed. Devices that again request
  * deferral are re-added to deferred list in device_probe().
- * For devices finally left in deferred list -EPROBE_DEFER
- * becomes a fatal error.
  */
-static int device_probe_deferred(void)
+static void device_reprobe_deferred(void)
 {
 	struct device_d *dev, *tmp;
 	struct driver_d *drv;
@@ -279,6 +427,21 @@ static int device_probe_deferred(void)
 			}
 		}
 	} while (success);
+}
+
+/*
+ * For devices finally left in deferred list -EPROBE_DEFER
+ * becomes a fatal error.
+ */
+static int device_probe_deferred(void)
+{
+	struct device_d *dev;
+
+	/* the deferred devices may wait for one probed in the background */
+	if (!list_empty(&deferred))
+		wait_for_device_probe();
+
+	device_reprobe_deferred();
 
 	if (list_empty(&deferred))
 		return 0;
@@ -763,5 +763,6 @@ static struct driver_d dw_mmc_driver = {
 	.name  = "dw_mmc",
 	.probe = dw_mmc_probe,
 	.of_compatible = DRV_OF_COMPAT(dw_mmc_compatible),
+	.probe_async = IS_ENABLED(CONFIG_MCI_STARTUP),
 };
 device_platform_driver(dw_mmc_driver);
@@ -736,5 +736,6 @@ static struct driver_d fsl_esdhc_driver = {
 	.name  = "imx-esdhc",
 	.probe = fsl_esdhc_probe,
 	.of_compatible = DRV_OF_COMPAT(fsl_esdhc_compatible),
+	.probe_async = IS_ENABLED(CONFIG_MCI_STARTUP),
 };
 device_platform_driver(fsl_esdhc_driver);
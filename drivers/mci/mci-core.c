@@ -1911,7 +1911,7 @@ void mci_of_parse(struct mci_host *host)
 	return mci_of_parse_node(host, host->hw_dev->device_node);
 }
 
-struct mci *mci_get_device_by_name(const char *name)
+static struct mci *__mci_get_device_by_name(const char *name)
 {
 	struct mci *mci;
 
@@ -1924,3 +1924,18 @@ struct mci *mci_get_device_by_name(const char *name)
 
 	return NULL;
 }
+
+struct mci *mci_get_device_by_name(const char *name)
+{
+	struct mci *mci;
+
+	mci = __mci_get_device_by_name(name);
+	if (mci)
+		return mci;
+
+	/* the host may be waiting to be probed in the background */
+	if (IS_ENABLED(CONFIG_ASYNC_PROBE) && wait_for_device_probe())
+		mci = __mci_get_device_by_name(name);
+
+	return mci;
+}
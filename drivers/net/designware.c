@@ -284,21 +284,19 @@ static int dwc_ether_open(struct eth_device *dev)
 	return 0;
 }
 
-static int dwc_ether_send(struct eth_device *dev, void *packet, int length)
+static u32 dwc_ether_tx_owndma(struct dw_eth_dev *priv)
+{
+	return priv->enh_desc ? DESC_ENH_TXSTS_OWNBYDMA : DESC_TXSTS_OWNBYDMA;
+}
+
+/* hand the frame in the buffer of the current descriptor to the DMA */
+static int dwc_ether_tx_submit(struct eth_device *dev, void *packet, int length)
 {
 	struct dw_eth_dev *priv = dev->priv;
 	struct eth_dma_regs *dma_p = priv->dma_regs_p;
-	u32 owndma, desc_num = priv->tx_currdescnum;
+	u32 desc_num = priv->tx_currdescnum;
 	struct dmamacdescr *desc_p = &priv->tx_mac_descrtable[desc_num];
 
-	owndma = priv->enh_desc ? DESC_ENH_TXSTS_OWNBYDMA : DESC_TXSTS_OWNBYDMA;
-	/* Check if the descriptor is owned by CPU */
-	if (desc_p->txrx_status & owndma) {
-		dev_err(&dev->dev, "CPU not owner of tx frame\n");
-		return -1;
-	}
-
-	memcpy((void *)desc_p->dmamac_addr, packet, length);
 	dma_sync_single_for_device((unsigned long)desc_p->dmamac_addr, length,
 				   DMA_TO_DEVICE);
 
@@ -331,41 +329,86 @@ static int dwc_ether_send(struct eth_device *dev, void *packet, int length)
 	return 0;
 }
 
-static int dwc_ether_rx(struct eth_device *dev)
+/* the buffer of the current descriptor, once the CPU owns it */
+static void *dwc_ether_tx_buffer(struct eth_device *dev)
+{
+	struct dw_eth_dev *priv = dev->priv;
+	struct dmamacdescr *desc_p = &priv->tx_mac_descrtable[priv->tx_currdescnum];
+
+	if (desc_p->txrx_status & dwc_ether_tx_owndma(priv))
+		return NULL;
+
+	return (void *)desc_p->dmamac_addr;
+}
+
+static int dwc_ether_send(struct eth_device *dev, void *packet, int length)
+{
+	void *buf = dwc_ether_tx_buffer(dev);
+
+	/* Check if the descriptor is owned by CPU */
+	if (!buf) {
+		dev_err(&dev->dev, "CPU not owner of tx frame\n");
+		return -1;
+	}
+
+	memcpy(buf, packet, length);
+
+	return dwc_ether_tx_submit(dev, buf, length);
+}
+
+static int dwc_ether_rx(struct eth_device *dev, int budget)
 {
 	struct dw_eth_dev *priv = dev->priv;
 	u32 desc_num = priv->rx_currdescnum;
 	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
+	unsigned long start, size;
+	int i, count = 0, length = 0;
+
+	/*
+	 * Collect the frames owned by the CPU. Stop at the end of the ring
+	 * so that their buffers form one contiguous range.
+	 */
+	budget = min_t(int, budget, CONFIG_RX_DESCR_NUM - desc_num);
 
-	u32 status = desc_p->txrx_status;
-	int length = 0;
+	while (count < budget &&
+	       !(desc_p[count].txrx_status & DESC_RXSTS_OWNBYDMA))
+		count++;
 
-	/* Check  if the owner is the CPU */
-	if (status & DESC_RXSTS_OWNBYDMA)
+	if (!count)
 		return 0;
 
-	length = (status & DESC_RXSTS_FRMLENMSK) >>
+	length = (desc_p[count - 1].txrx_status & DESC_RXSTS_FRMLENMSK) >>
 		 DESC_RXSTS_FRMLENSHFT;
 
+	/* a single cache invalidation for the whole batch */
+	start = (unsigned long)desc_p[0].dmamac_addr;
+	size = (count - 1) * CONFIG_ETH_BUFSIZE + length;
+
+	dma_sync_single_for_cpu(start, size, DMA_FROM_DEVICE);
+
+	for (i = 0; i < count; i++) {
+		length = (desc_p[i].txrx_status & DESC_RXSTS_FRMLENMSK) >>
+			 DESC_RXSTS_FRMLENSHFT;
+
+		net_receive(dev, desc_p[i].dmamac_addr, length);
+	}
+
+	dma_sync_single_for_device(start, size, DMA_FROM_DEVICE);
+
 	/*
-	 * Make the current descriptor valid again and go to
-	 * the next one
+	 * Make the descriptors valid again and go to the next one
 	 */
-	dma_sync_single_for_cpu((unsigned long)desc_p->dmamac_addr, length,
-				DMA_FROM_DEVICE);
-	net_receive(dev, desc_p->dmamac_addr, length);
-	dma_sync_single_for_device((unsigned long)desc_p->dmamac_addr, length,
-				   DMA_FROM_DEVICE);
-
-	desc_p->txrx_status |= DESC_RXSTS_OWNBYDMA;
+	for (i = 0; i < count; i++)
+		desc_p[i].txrx_status |= DESC_RXSTS_OWNBYDMA;
 
 	/* Test the wrap-around condition. */
-	if (++desc_num >= CONFIG_RX_DESCR_NUM)
+	desc_num += count;
+	if (desc_num >= CONFIG_RX_DESCR_NUM)
 		desc_num = 0;
 
 	priv->rx_currdescnum = desc_num;
 
-	return length;
+	return count;
 }
 
 static void dwc_ether_halt (struct eth_device *dev)
@@ -474,7 +517,9 @@ struct dw_eth_dev *dwc_drv_probe(struct device_d *dev)
 	edev->parent = dev;
 	edev->open = dwc_ether_open;
 	edev->send = dwc_ether_send;
-	edev->recv = dwc_ether_rx;
+	edev->tx_buffer = dwc_ether_tx_buffer;
+	edev->tx_submit = dwc_ether_tx_submit;
+	edev->recv_batch = dwc_ether_rx;
 	edev->halt = dwc_ether_halt;
 	edev->get_ethaddr = dwc_ether_get_ethaddr;
 	edev->set_ethaddr = dwc_ether_set_ethaddr;
@@ -524,12 +524,12 @@ static int fec_send(struct eth_device *dev, void *eth_data, int data_length)
  * @param[in] dev Our ethernet device to handle
  * @return Length of packet read
  */
-static int fec_recv(struct eth_device *dev)
+static int fec_recv(struct eth_device *dev, int budget)
 {
 	struct fec_priv *fec = (struct fec_priv *)dev->priv;
-	struct buffer_descriptor __iomem *rbd = &fec->rbd_base[fec->rbd_index];
+	struct buffer_descriptor __iomem *rbd;
 	uint32_t ievent;
-	int frame_length, len = 0;
+	int frame_length, received = 0;
 	struct fec_frame *frame;
 	uint16_t bd_status;
 
@@ -563,12 +563,17 @@ static int fec_recv(struct eth_device *dev)
 		}
 	}
 
-	/*
-	 * ensure reading the right buffer status
-	 */
-	bd_status = readw(&rbd->status);
+	while (received < budget) {
+		rbd = &fec->rbd_base[fec->rbd_index];
+
+		/*
+		 * ensure reading the right buffer status
+		 */
+		bd_status = readw(&rbd->status);
+
+		if (bd_status & FEC_RBD_EMPTY)
+			break;
 
-	if (!(bd_status & FEC_RBD_EMPTY)) {
 		if ((bd_status & FEC_RBD_LAST) && !(bd_status & FEC_RBD_ERR) &&
 			((readw(&rbd->data_length) - 4) > 14)) {
 
@@ -578,27 +583,31 @@ static int fec_recv(struct eth_device *dev)
 					(readw(&rbd->data_length) + 3) >> 2);
 
 			/*
-			 * Get buffer address and size
+			 * Get buffer address and size. The buffers are
+			 * coherent, so they are handed over without copying
+			 * or cache maintenance.
 			 */
 			frame = phys_to_virt(readl(&rbd->data_pointer));
 			frame_length = readw(&rbd->data_length) - 4;
 			net_receive(dev, frame->data, frame_length);
-			len = frame_length;
 		} else {
 			if (bd_status & FEC_RBD_ERR) {
 				dev_warn(&dev->dev, "error frame: 0x%p 0x%08x\n", rbd, bd_status);
 			}
 		}
 		/*
-		 * free the current buffer, restart the engine
-		 * and move forward to the next buffer
+		 * free the current buffer and move forward to the next buffer
 		 */
 		fec_rbd_clean(fec->rbd_index == (FEC_RBD_NUM - 1) ? 1 : 0, rbd);
-		fec_rx_task_enable(fec);
 		fec->rbd_index = (fec->rbd_index + 1) % FEC_RBD_NUM;
+		received++;
 	}
 
-	return len;
+	/* restart the engine once for all buffers freed above */
+	if (received)
+		fec_rx_task_enable(fec);
+
+	return received;
 }
 
 static int fec_alloc_receive_packets(struct fec_priv *fec, int count, int size)
@@ -756,7 +765,7 @@ static int fec_probe(struct device_d *dev)
 	edev->priv = fec;
 	edev->open = fec_open;
 	edev->send = fec_send;
-	edev->recv = fec_recv;
+	edev->recv_batch = fec_recv;
 	edev->halt = fec_halt;
 	edev->get_ethaddr = fec_get_hwaddr;
 	edev->set_ethaddr = fec_set_hwaddr;
@@ -27,6 +27,7 @@
 struct tap_priv {
 	int fd;
 	char *name;
+	void *txbuf;
 };
 
 static int tap_eth_send(struct eth_device *edev, void *packet, int length)
@@ -37,17 +38,30 @@ static int tap_eth_send(struct eth_device *edev, void *packet, int length)
 	return 0;
 }
 
-static int tap_eth_rx(struct eth_device *edev)
+/* frames are written synchronously, so a single buffer is enough */
+static void *tap_eth_tx_buffer(struct eth_device *edev)
 {
 	struct tap_priv *priv = edev->priv;
-	int length;
 
-	length = linux_read_nonblock(priv->fd, NetRxPackets[0], PKTSIZE);
+	return priv->txbuf;
+}
+
+static int tap_eth_rx(struct eth_device *edev, int budget)
+{
+	struct tap_priv *priv = edev->priv;
+	int length, received = 0;
+
+	/* net_receive() is done with the buffer when it returns, reuse it */
+	while (received < budget) {
+		length = linux_read_nonblock(priv->fd, NetRxPackets[0], PKTSIZE);
+		if (length <= 0)
+			break;
 
-	if (length > 0)
 		net_receive(edev, NetRxPackets[0], length);
+		received++;
+	}
 
-	return 0;
+	return received;
 }
 
 static int tap_eth_open(struct eth_device *edev)
@@ -77,7 +91,8 @@ static int tap_probe(struct device_d *dev)
 	int ret = 0;
 
 	priv = xzalloc(sizeof(struct tap_priv));
-	priv->name = "barebox";
+	/* tap_alloc() copies the name the kernel chose back into the buffer */
+	priv->name = xstrdup("barebox");
 
 	priv->fd = tap_alloc(priv->name);
 	if (priv->fd < 0) {
@@ -85,6 +100,8 @@ static int tap_probe(struct device_d *dev)
 		goto out;
 	}
 
+	priv->txbuf = net_alloc_packet();
+
 	edev = xzalloc(sizeof(struct eth_device));
 	edev->priv = priv;
 	edev->parent = dev;
@@ -92,7 +109,9 @@ static int tap_probe(struct device_d *dev)
 	edev->init = tap_eth_open;
 	edev->open = tap_eth_open;
 	edev->send = tap_eth_send;
-	edev->recv = tap_eth_rx;
+	edev->tx_buffer = tap_eth_tx_buffer;
+	edev->tx_submit = tap_eth_send;
+	edev->recv_batch = tap_eth_rx;
 	edev->halt = tap_eth_halt;
 	edev->get_ethaddr = tap_get_ethaddr;
 	edev->set_ethaddr = tap_set_ethaddr;
@@ -102,6 +121,7 @@ static int tap_probe(struct device_d *dev)
 	return 0;
 
 out:
+	free(priv->name);
 	free(priv);
 	return ret;
 }
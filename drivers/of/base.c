@@ -22,6 +22,7 @@
 #include <of_address.h>
 #include <errno.h>
 #include <malloc.h>
+#include <arena.h>
 #include <init.h>
 #include <memory.h>
 #include <linux/sizes.h>
@@ -266,6 +267,58 @@ struct device_node *of_find_node_by_alias(struct device_node *root, const char *
 }
 EXPORT_SYMBOL_GPL(of_find_node_by_alias);
 
+/*
+ * All nodes with a phandle, of all trees, are hashed by their phandle so
+ * that resolving phandles does not need to walk the whole tree. dtc hands
+ * out phandles sequentially, so the lower bits make a good hash.
+ */
+#define OF_PHANDLE_HASH_SIZE	256
+
+static struct hlist_head of_phandle_hash[OF_PHANDLE_HASH_SIZE];
+
+static struct hlist_head *of_phandle_hash_head(phandle phandle)
+{
+	return &of_phandle_hash[phandle & (OF_PHANDLE_HASH_SIZE - 1)];
+}
+
+/*
+ * of_node_set_phandle - set the phandle of a node
+ * @node:    The node to set the phandle for
+ * @phandle: The new phandle, 0 to remove it
+ *
+ * This only updates the node and the phandle lookup, the "phandle"
+ * property has to be updated by the caller.
+ */
+void of_node_set_phandle(struct device_node *node, phandle phandle)
+{
+	hlist_del_init(&node->phandle_hash);
+
+	node->phandle = phandle;
+
+	if (phandle)
+		hlist_add_head(&node->phandle_hash,
+			       of_phandle_hash_head(phandle));
+}
+
+/*
+ * All nodes except the roots are also hashed by their full path, so that
+ * looking up a node by its path does not need to compare the names of all
+ * siblings on each level. Node names are compared case insensitive.
+ */
+#define OF_PATH_HASH_SIZE	256
+
+static struct hlist_head of_path_hash[OF_PATH_HASH_SIZE];
+
+static struct hlist_head *of_path_hash_head(const char *path)
+{
+	unsigned int hash = 0;
+
+	while (*path)
+		hash = hash * 31 + tolower(*path++);
+
+	return &of_path_hash[hash & (OF_PATH_HASH_SIZE - 1)];
+}
+
 /*
  * of_find_node_by_phandle_from - Find a node given a phandle from given
  * root node.
@@ -277,9 +330,19 @@ struct device_node *of_find_node_by_phandle_from(phandle phandle,
 		struct device_node *root)
 {
 	struct device_node *node;
+	struct hlist_node *n;
 
-	of_tree_for_each_node_from(node, root)
-		if (node->phandle == phandle)
+	if (!root)
+		root = root_node;
+	if (!root || !phandle)
+		return NULL;
+
+	root = of_find_root_node(root);
+
+	hlist_for_each_entry(node, n, of_phandle_hash_head(phandle),
+			     phandle_hash)
+		if (node->phandle == phandle &&
+		    of_find_root_node(node) == root)
 			return node;
 
 	return NULL;
@@ -334,7 +397,7 @@ phandle of_node_create_phandle(struct device_node *node)
 
 	p = of_get_tree_max_phandle(root) + 1;
 
-	node->phandle = p;
+	of_node_set_phandle(node, p);
 
 	p = cpu_to_be32(p);
 
@@ -1480,6 +1543,8 @@ EXPORT_SYMBOL(of_machine_is_compatible);
 struct device_node *of_find_node_by_path_from(struct device_node *from,
 					const char *path)
 {
+	struct device_node *node;
+	struct hlist_node *n;
 	char *slash, *p, *freep;
 
 	if (!from)
@@ -1488,6 +1553,22 @@ struct device_node *of_find_node_by_path_from(struct device_node *from,
 	if (!from || !path || *path != '/')
 		return NULL;
 
+	/*
+	 * The full paths of the nodes are hashed, so paths relative to the
+	 * root of a tree can be looked up directly. Anything else, e.g. a
+	 * trailing slash, is left to the walk below.
+	 */
+	if (!from->parent && path[1] && !strstr(path, "//") &&
+	    path[strlen(path) - 1] != '/') {
+		hlist_for_each_entry(node, n, of_path_hash_head(path),
+				     path_hash)
+			if (!of_node_cmp(node->full_name, path) &&
+			    of_find_root_node(node) == from)
+				return node;
+
+		return NULL;
+	}
+
 	path++;
 
 	freep = p = xstrdup(path);
@@ -1812,10 +1893,12 @@ void of_print_nodes(struct device_node *node, int indent)
 
 struct device_node *of_new_node(struct device_node *parent, const char *name)
 {
+	struct arena *arena = parent ? parent->arena : NULL;
 	struct device_node *node;
 
-	node = xzalloc(sizeof(*node));
+	node = arena_zalloc(arena, sizeof(*node));
 	node->parent = parent;
+	node->arena = arena;
 	if (parent)
 		list_add_tail(&node->parent_list, &parent->children);
 
@@ -1823,10 +1906,13 @@ struct device_node *of_new_node(struct device_node *parent, const char *name)
 	INIT_LIST_HEAD(&node->properties);
 
 	if (parent) {
-		node->name = xstrdup(name);
-		node->full_name = basprintf("%s/%s",
-					      node->parent->full_name, name);
+		node->name = arena_strdup(arena, name);
+		node->full_name = arena_alloc(arena,
+				strlen(parent->full_name) + strlen(name) + 2);
+		sprintf(node->full_name, "%s/%s", parent->full_name, name);
 		list_add(&node->list, &parent->list);
+		hlist_add_head(&node->path_hash,
+			       of_path_hash_head(node->full_name));
 	} else {
 		node->name = xstrdup("");
 		node->full_name = xstrdup("");
@@ -1853,10 +1939,10 @@ struct property *of_new_property(struct device_node *node, const char *name,
 {
 	struct property *prop;
 
-	prop = xzalloc(sizeof(*prop));
-	prop->name = xstrdup(name);
+	prop = arena_zalloc(node->arena, sizeof(*prop));
+	prop->name = arena_strdup(node->arena, name);
 	prop->length = len;
-	prop->value = xzalloc(len);
+	prop->value = arena_zalloc(node->arena, len);
 
 	if (data)
 		memcpy(prop->value, data, len);
@@ -1885,8 +1971,8 @@ struct property *of_new_property_const(struct device_node *node, const char *nam
 {
 	struct property *prop;
 
-	prop = xzalloc(sizeof(*prop));
-	prop->name = xstrdup(name);
+	prop = arena_zalloc(node->arena, sizeof(*prop));
+	prop->name = arena_strdup(node->arena, name);
 	prop->length = len;
 	prop->value_const = data;
 
@@ -1902,9 +1988,9 @@ void of_delete_property(struct property *pp)
 
 	list_del(&pp->list);
 
-	free(pp->name);
-	free(pp->value);
-	free(pp);
+	arena_free(pp->name);
+	arena_free(pp->value);
+	arena_free(pp);
 }
 
 /**
@@ -2056,21 +2142,49 @@ struct device_node *of_copy_node(struct device_node *parent, const struct device
 	list_for_each_entry(pp, &other->properties, list)
 		of_new_property(np, pp->name, pp->value, pp->length);
 
+	if (other->phandle)
+		of_node_set_phandle(np, other->phandle);
+
 	for_each_child_of_node(other, child)
 		of_copy_node(np, child);
 
 	return np;
 }
 
+/*
+ * Drop the references to @node and its children from outside of the tree
+ */
+static void of_node_detach(struct device_node *node)
+{
+	struct device_node *n;
+	struct device_d *dev;
+
+	list_for_each_entry(n, &node->children, parent_list)
+		of_node_detach(n);
+
+	dev = of_find_device_by_node(node);
+	if (dev)
+		dev->device_node = NULL;
+
+	of_node_set_phandle(node, 0);
+	hlist_del_init(&node->path_hash);
+}
+
 void of_delete_node(struct device_node *node)
 {
 	struct device_node *n, *nt;
 	struct property *p, *pt;
-	struct device_d *dev;
 
 	if (!node)
 		return;
 
+	if (!node->parent && node->arena) {
+		/* a whole unflattened tree, free it together with its arena */
+		of_node_detach(node);
+		arena_destroy(node->arena);
+		goto out;
+	}
+
 	list_for_each_entry_safe(p, pt, &node->properties, list)
 		of_delete_property(p);
 
@@ -2082,13 +2196,11 @@ void of_delete_node(struct device_node *node)
 		list_del(&node->list);
 	}
 
-	dev = of_find_device_by_node(node);
-	if (dev)
-		dev->device_node = NULL;
-
-	free(node->name);
-	free(node->full_name);
-	free(node);
+	of_node_detach(node);
+out:
+	arena_free(node->name);
+	arena_free(node->full_name);
+	arena_free(node);
 
 	if (node == root_node)
 		of_set_root_node(NULL);
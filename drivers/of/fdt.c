@@ -21,6 +21,7 @@
 #include <of.h>
 #include <errno.h>
 #include <malloc.h>
+#include <arena.h>
 #include <init.h>
 #include <memory.h>
 #include <linux/sizes.h>
@@ -167,6 +168,12 @@ static struct device_node *__of_unflatten_dtb(const void *infdt, bool constprops
 	if (!root)
 		return ERR_PTR(-ENOMEM);
 
+	/*
+	 * The nodes and properties are many small objects which are freed
+	 * together, keep them out of the heap.
+	 */
+	root->arena = arena_new("devicetree");
+
 	ret = of_unflatten_reservemap(root, fdt);
 	if (ret)
 		goto err;
@@ -227,7 +234,7 @@ static struct device_node *__of_unflatten_dtb(const void *infdt, bool constprops
 				p = of_new_property(node, name, nodep, len);
 
 			if (!strcmp(name, "phandle") && len == 4)
-				node->phandle = be32_to_cpup(p->value);
+				of_node_set_phandle(node, be32_to_cpup(p->value));
 
 			dt_struct = dt_struct_advance(&f, dt_struct,
 					sizeof(struct fdt_property) + len);
@@ -268,6 +268,18 @@ static void ns16550_putc(struct console_device *cdev, char c)
 	ns16550_write(cdev, c, thr);
 }
 
+/**
+ * @brief Test if the transmitter takes a character
+ *
+ * @param[in] cdev pointer to console device
+ *
+ * @return  - nonzero if putc does not have to wait
+ */
+static int ns16550_tx_ready(struct console_device *cdev)
+{
+	return (ns16550_read(cdev, lsr) & LSR_THRE) != 0;
+}
+
 /**
  * @brief Retrieve a character from serial port
  *
@@ -477,6 +489,7 @@ static int ns16550_probe(struct device_d *dev)
 	cdev->dev = dev;
 	cdev->tstc = ns16550_tstc;
 	cdev->putc = ns16550_putc;
+	cdev->tx_ready = ns16550_tx_ready;
 	cdev->getc = ns16550_getc;
 	cdev->setbrg = ns16550_setbaudrate;
 	cdev->linux_console_name = devtype->linux_console_name;
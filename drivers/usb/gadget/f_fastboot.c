@@ -49,6 +49,7 @@
 #include <linux/stat.h>
 #include <linux/mtd/mtd-abi.h>
 #include <linux/mtd/mtd.h>
+#include <asm-generic/div64.h>
 
 #define FASTBOOT_VERSION		"0.4"
 
@@ -74,6 +75,8 @@ struct f_fastboot {
 	/* IN/OUT EP's and corresponding requests */
 	struct usb_ep *in_ep, *out_ep;
 	struct usb_request *in_req, *out_req;
+	/* second OUT request, so that downloading continues during writes */
+	struct usb_request *dl_req;
 	struct file_list *files;
 	int (*cmd_exec)(struct f_fastboot *, const char *cmd);
 	int (*cmd_flash)(struct f_fastboot *, struct file_list_entry *entry,
@@ -83,7 +86,17 @@ struct f_fastboot {
 
 	size_t download_bytes;
 	size_t download_size;
+	size_t download_queued;
 	struct list_head variables;
+
+	/* streaming flash, see cb_oem_stream() */
+	struct file_list_entry *stream_entry;
+	struct file_list_entry *streamed_entry;
+	struct sparse_image_ctx *stream_sparse;
+	int stream_fd;
+	int stream_ret;
+	bool stream_truncate;
+	uint64_t stream_start;
 };
 
 static inline bool fastboot_download_to_buf(struct f_fastboot *f_fb)
@@ -181,6 +194,7 @@ static struct usb_gadget_strings *fastboot_strings[] = {
 };
 
 static void rx_handler_command(struct usb_ep *ep, struct usb_request *req);
+static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req);
 
 static int in_req_complete;
 
@@ -337,7 +351,7 @@ static int fastboot_bind(struct usb_configuration *c, struct usb_function *f)
 	fb_setvar(var, "0.4");
 	var = fb_addvar(f_fb, "bootloader-version");
 	fb_setvar(var, release_string);
-	if (IS_ENABLED(USB_GADGET_FASTBOOT_SPARSE)) {
+	if (IS_ENABLED(CONFIG_USB_GADGET_FASTBOOT_SPARSE)) {
 		var = fb_addvar(f_fb, "max-download-size");
 		fb_setvar(var, "%u", fastboot_max_download_size);
 	}
@@ -401,6 +415,16 @@ static int fastboot_bind(struct usb_configuration *c, struct usb_function *f)
 	f_fb->in_req->complete = fastboot_complete;
 	f_fb->out_req->context = f_fb;
 
+	f_fb->dl_req = fastboot_alloc_request(f_fb->out_ep);
+	if (!f_fb->dl_req) {
+		puts("failed to alloc download req\n");
+		ret = -EINVAL;
+		return ret;
+	}
+
+	f_fb->dl_req->complete = rx_handler_dl_image;
+	f_fb->dl_req->context = f_fb;
+
 	ret = usb_assign_descriptors(f, fb_fs_descs, fb_hs_descs, NULL);
 	if (ret)
 		return ret;
@@ -423,6 +447,11 @@ static void fastboot_unbind(struct usb_configuration *c, struct usb_function *f)
 	usb_ep_free_request(f_fb->out_ep, f_fb->out_req);
 	f_fb->out_req = NULL;
 
+	usb_ep_dequeue(f_fb->out_ep, f_fb->dl_req);
+	free(f_fb->dl_req->buf);
+	usb_ep_free_request(f_fb->out_ep, f_fb->dl_req);
+	f_fb->dl_req = NULL;
+
 	list_for_each_entry_safe(var, tmp, &f_fb->variables, list) {
 		free(var->name);
 		free(var->value);
@@ -609,9 +638,27 @@ static void cb_getvar(struct f_fastboot *f_fb, const char *cmd)
 	fastboot_tx_print(f_fb, "OKAY");
 }
 
+/* length for the next download request, 0 when everything is queued */
+static unsigned int fastboot_dl_next_length(struct f_fastboot *f_fb)
+{
+	unsigned int len;
+
+	len = min_t(size_t, f_fb->download_size - f_fb->download_queued,
+		    EP_BUFFER_SIZE);
+	f_fb->download_queued += len;
+
+	return len;
+}
+
+static int fastboot_stream_start(struct f_fastboot *f_fb);
+static int fastboot_stream_data(struct f_fastboot *f_fb, const void *buf,
+				size_t len);
+static int fastboot_stream_finish(struct f_fastboot *f_fb);
+
 static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 {
 	struct f_fastboot *f_fb = req->context;
+	struct usb_request *out_req = f_fb->out_req;
 	const unsigned char *buffer = req->buf;
 	int ret;
 
@@ -620,7 +667,11 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 		return;
 	}
 
-	if (fastboot_download_to_buf(f_fb)) {
+	if (f_fb->stream_entry) {
+		if (!f_fb->stream_ret)
+			f_fb->stream_ret = fastboot_stream_data(f_fb, buffer,
+								req->actual);
+	} else if (fastboot_download_to_buf(f_fb)) {
 		memcpy(f_fb->buf + f_fb->download_bytes, buffer, req->actual);
 	} else {
 		ret = write(f_fb->download_fd, buffer, req->actual);
@@ -632,17 +683,21 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 
 	f_fb->download_bytes += req->actual;
 
-	req->length = f_fb->download_size - f_fb->download_bytes;
-	if (req->length > EP_BUFFER_SIZE)
-		req->length = EP_BUFFER_SIZE;
-
 	show_progress(f_fb->download_bytes);
 
 	/* Check if transfer is done */
 	if (f_fb->download_bytes >= f_fb->download_size) {
-		req->complete = rx_handler_command;
-		req->length = EP_BUFFER_SIZE;
-		close(f_fb->download_fd);
+		if (f_fb->stream_entry) {
+			ret = fastboot_stream_finish(f_fb);
+			if (ret) {
+				fastboot_tx_print(f_fb, "FAILwriting %s: %s",
+						  f_fb->streamed_entry->name,
+						  strerror(-ret));
+				goto command;
+			}
+		} else if (!fastboot_download_to_buf(f_fb)) {
+			close(f_fb->download_fd);
+		}
 
 		fastboot_tx_print(f_fb, "INFODownloading %d bytes finished",
 				f_fb->download_bytes);
@@ -650,22 +705,50 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 		fastboot_tx_print(f_fb, "OKAY");
 
 		printf("\n");
+command:
+		/* the command request may already be done with downloading */
+		out_req->complete = rx_handler_command;
+		out_req->length = EP_BUFFER_SIZE;
+		out_req->actual = 0;
+		usb_ep_queue(ep, out_req);
+
+		return;
 	}
 
+	/*
+	 * Both requests are queued while downloading, so the next one is
+	 * received while this one is written. Only requeue when there is
+	 * data left which is not covered by the other request.
+	 */
+	req->length = fastboot_dl_next_length(f_fb);
 	req->actual = 0;
-	usb_ep_queue(ep, req);
+	if (req->length)
+		usb_ep_queue(ep, req);
 }
 
 static void cb_download(struct f_fastboot *f_fb, const char *cmd)
 {
 	f_fb->download_size = simple_strtoul(cmd, NULL, 16);
 	f_fb->download_bytes = 0;
+	f_fb->download_queued = 0;
+	f_fb->streamed_entry = NULL;
 
 	fastboot_tx_print(f_fb, "INFODownloading %d bytes...", f_fb->download_size);
 
 	init_progression_bar(f_fb->download_size);
 
-	if (fastboot_download_to_buf(f_fb)) {
+	if (f_fb->stream_entry) {
+		int ret = fastboot_stream_start(f_fb);
+
+		if (ret) {
+			fastboot_tx_print(f_fb, "FAILcannot open %s: %s",
+					  f_fb->stream_entry->name,
+					  strerror(-ret));
+			/* streaming is for a single download only */
+			f_fb->stream_entry = NULL;
+			return;
+		}
+	} else if (fastboot_download_to_buf(f_fb)) {
 		free(f_fb->buf);
 		f_fb->buf = malloc(f_fb->download_size);
 		if (!f_fb->buf) {
@@ -687,9 +770,16 @@ static void cb_download(struct f_fastboot *f_fb, const char *cmd)
 		struct usb_ep *ep = f_fb->out_ep;
 		fastboot_tx_print(f_fb, "DATA%08x", f_fb->download_size);
 		req->complete = rx_handler_dl_image;
-		req->length = EP_BUFFER_SIZE;
+		req->length = fastboot_dl_next_length(f_fb);
 		if (req->length < ep->maxpacket)
 			req->length = ep->maxpacket;
+
+		/* out_req is queued when we return to rx_handler_command() */
+		req = f_fb->dl_req;
+		req->length = fastboot_dl_next_length(f_fb);
+		req->actual = 0;
+		if (req->length)
+			usb_ep_queue(ep, req);
 	}
 }
 
@@ -803,16 +893,130 @@ static int check_ubi(struct f_fastboot *f_fb, struct file_list_entry *fentry,
 	}
 }
 
+/*
+ * Fill callback for the sparse image writer: A fill with 0xffffffff is what
+ * erasing a MTD device produces, so erase the region instead of writing it
+ * when it covers whole eraseblocks. Everything else is written.
+ */
+static int fastboot_sparse_erase_fill(int fd, loff_t pos, loff_t len,
+				      uint32_t val)
+{
+	struct mtd_info_user meminfo;
+
+	if (val != 0xffffffff)
+		return -EOPNOTSUPP;
+
+	if (ioctl(fd, MEMGETINFO, &meminfo))
+		return -EOPNOTSUPP;
+
+	if (meminfo.mtd->numeraseregions ||
+	    !IS_ALIGNED(pos, meminfo.erasesize) ||
+	    !IS_ALIGNED(len, meminfo.erasesize))
+		return -EOPNOTSUPP;
+
+	if (erase(fd, len, pos))
+		return -errno;
+
+	return 0;
+}
+
+struct fastboot_sparse {
+	struct f_fastboot *f_fb;
+	struct file_list_entry *fentry;
+	int fd;
+};
+
+static int fastboot_sparse_write(void *ctx, loff_t pos, const void *buf,
+				 size_t len)
+{
+	struct fastboot_sparse *fs = ctx;
+	int ret;
+
+	if (pos == 0) {
+		ret = check_ubi(fs->f_fb, fs->fentry, file_detect_type(buf, len));
+		if (ret < 0)
+			return ret;
+	}
+
+	if (lseek(fs->fd, pos, SEEK_SET) != pos)
+		return -errno;
+
+	ret = write_full(fs->fd, buf, len);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static int fastboot_sparse_fill(void *ctx, loff_t pos, loff_t len,
+				uint32_t val)
+{
+	struct fastboot_sparse *fs = ctx;
+
+	return fastboot_sparse_erase_fill(fs->fd, pos, len, val);
+}
+
+static int fastboot_sparse_ubi(struct f_fastboot *f_fb,
+			       struct file_list_entry *fentry,
+			       struct sparse_image_ctx *sparse)
+{
+	struct mtd_info *mtd;
+	int bufsiz = SZ_128K;
+	void *buf;
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_UBIFORMAT)) {
+		fastboot_tx_print(f_fb, "FAILformat not available");
+		return -ENOSYS;
+	}
+
+	mtd = get_mtd(f_fb, fentry->filename);
+	if (IS_ERR(mtd))
+		return PTR_ERR(mtd);
+
+	buf = malloc(bufsiz);
+	if (!buf)
+		return -ENOMEM;
+
+	while (1) {
+		int retlen;
+		loff_t pos;
+
+		ret = sparse_image_read(sparse, buf, &pos, bufsiz, &retlen);
+		if (ret)
+			goto out;
+		if (!retlen)
+			break;
+
+		if (pos == 0) {
+			ret = check_ubi(f_fb, fentry, file_detect_type(buf, retlen));
+			if (ret < 0)
+				goto out;
+
+			ret = do_ubiformat(f_fb, mtd, NULL, NULL, 0);
+			if (ret)
+				goto out;
+		}
+
+		ret = ubiformat_write(mtd, buf, retlen, pos);
+		if (ret)
+			goto out;
+	}
+
+	ret = 0;
+out:
+	free(buf);
+
+	return ret;
+}
+
 static int fastboot_handle_sparse(struct f_fastboot *f_fb,
 				  struct file_list_entry *fentry)
 {
 	struct sparse_image_ctx *sparse;
-	void *buf = NULL;
 	int ret, fd;
 	unsigned int flags = O_RDWR;
-	int bufsiz = SZ_128K;
 	struct stat s;
-	struct mtd_info *mtd = NULL;
 
 	ret = stat(fentry->filename, &s);
 	if (ret) {
@@ -843,73 +1047,153 @@ static int fastboot_handle_sparse(struct f_fastboot *f_fb,
 			goto out;
 	}
 
-	buf = malloc(bufsiz);
-	if (!buf) {
-		ret = -ENOMEM;
-		goto out;
+	if (fentry->flags & FILE_LIST_FLAG_UBI) {
+		ret = fastboot_sparse_ubi(f_fb, fentry, sparse);
+	} else {
+		struct fastboot_sparse fs = {
+			.f_fb = f_fb,
+			.fentry = fentry,
+			.fd = fd,
+		};
+
+		ret = sparse_image_write(sparse, fastboot_sparse_write,
+					 fastboot_sparse_fill, &fs);
 	}
 
-	if (fentry->flags & FILE_LIST_FLAG_UBI) {
-		mtd = get_mtd(f_fb, fentry->filename);
-		if (IS_ERR(mtd)) {
-			ret = PTR_ERR(mtd);
-			goto out;
-		}
+out:
+	sparse_image_close(sparse);
+out_close_fd:
+	close(fd);
+
+	return ret;
+}
+
+/*
+ * Streaming flash: The fastboot protocol names the partition only after
+ * the download, so the data has to be stored until then. With
+ * "oem stream <partition>" the partition is known in advance and the data
+ * is written while it is received, sparse images are unpacked on the fly.
+ */
+static int fastboot_stream_start(struct f_fastboot *f_fb)
+{
+	struct file_list_entry *fentry = f_fb->stream_entry;
+	unsigned int flags = O_RDWR;
+	struct stat s;
+	int ret;
+
+	ret = stat(fentry->filename, &s);
+	if (ret) {
+		if (!(fentry->flags & FILE_LIST_FLAG_CREATE))
+			return ret;
+		flags |= O_CREAT;
 	}
 
-	while (1) {
-		int retlen;
-		loff_t pos;
+	f_fb->stream_fd = open(fentry->filename, flags);
+	if (f_fb->stream_fd < 0)
+		return -errno;
 
-		ret = sparse_image_read(sparse, buf, &pos, bufsiz, &retlen);
+	f_fb->stream_truncate = ret || S_ISREG(s.st_mode);
+	f_fb->stream_sparse = NULL;
+	f_fb->stream_ret = 0;
+	f_fb->stream_start = get_time_ns();
+
+	return 0;
+}
+
+static int fastboot_stream_write(void *ctx, loff_t pos, const void *buf,
+				 size_t len)
+{
+	struct f_fastboot *f_fb = ctx;
+	loff_t size;
+	int ret;
+
+	if (f_fb->stream_truncate) {
+		if (f_fb->stream_sparse)
+			size = sparse_image_size(f_fb->stream_sparse);
+		else
+			size = f_fb->download_size;
+
+		ret = ftruncate(f_fb->stream_fd, size);
 		if (ret)
-			goto out;
-		if (!retlen)
-			break;
+			return ret;
 
-		if (pos == 0) {
-			ret = check_ubi(f_fb, fentry, file_detect_type(buf, retlen));
-			if (ret < 0)
-				goto out;
-		}
+		f_fb->stream_truncate = false;
+	}
 
-		if (fentry->flags & FILE_LIST_FLAG_UBI) {
-			if (!IS_ENABLED(CONFIG_UBIFORMAT)) {
-				ret = -ENOSYS;
-				goto out;
-			}
+	if (lseek(f_fb->stream_fd, pos, SEEK_SET) != pos)
+		return -errno;
 
-			if (pos == 0) {
-				ret = do_ubiformat(f_fb, mtd, NULL, NULL, 0);
-				if (ret)
-					goto out;
-			}
+	ret = write_full(f_fb->stream_fd, buf, len);
+	if (ret < 0)
+		return ret;
 
-			ret = ubiformat_write(mtd, buf, retlen, pos);
-			if (ret)
-				goto out;
-		} else {
-			pos = lseek(fd, pos, SEEK_SET);
-			if (pos == -1) {
-				ret = -errno;
-				goto out;
-			}
+	return 0;
+}
 
-			ret = write_full(fd, buf, retlen);
-			if (ret < 0)
-				goto out;
-		}
+static int fastboot_stream_fill(void *ctx, loff_t pos, loff_t len,
+				uint32_t val)
+{
+	struct f_fastboot *f_fb = ctx;
+
+	return fastboot_sparse_erase_fill(f_fb->stream_fd, pos, len, val);
+}
+
+static int fastboot_stream_data(struct f_fastboot *f_fb, const void *buf,
+				size_t len)
+{
+	/* the first request decides whether this is a sparse image */
+	if (!f_fb->download_bytes && len >= sizeof(struct sparse_header) &&
+	    is_sparse_image(buf)) {
+		if (!IS_ENABLED(CONFIG_USB_GADGET_FASTBOOT_SPARSE))
+			return -EOPNOTSUPP;
+
+		f_fb->stream_sparse = sparse_image_stream_open(fastboot_stream_write,
+							       fastboot_stream_fill,
+							       f_fb);
 	}
 
-	ret = 0;
+	if (f_fb->stream_sparse)
+		return sparse_image_stream_feed(f_fb->stream_sparse, buf, len);
 
-out:
-	free(buf);
-	sparse_image_close(sparse);
-out_close_fd:
-	close(fd);
+	return fastboot_stream_write(f_fb, f_fb->download_bytes, buf, len);
+}
 
-	return ret;
+static int fastboot_stream_finish(struct f_fastboot *f_fb)
+{
+	uint64_t ns, ms;
+	int ret = f_fb->stream_ret;
+
+	if (f_fb->stream_sparse) {
+		if (!ret)
+			ret = sparse_image_stream_finish(f_fb->stream_sparse);
+		sparse_image_close(f_fb->stream_sparse);
+		f_fb->stream_sparse = NULL;
+	}
+
+	if (close(f_fb->stream_fd) && !ret)
+		ret = -errno;
+
+	/*
+	 * Streaming is for a single download only. Remember the result for
+	 * the following flash command, it must not fall back to flashing
+	 * whatever was downloaded before.
+	 */
+	f_fb->streamed_entry = f_fb->stream_entry;
+	f_fb->stream_entry = NULL;
+	f_fb->stream_ret = ret;
+
+	if (ret)
+		return ret;
+
+	ns = get_time_ns() - f_fb->stream_start;
+	ms = ns;
+	do_div(ms, MSECOND);
+
+	fastboot_tx_print(f_fb, "INFOdownloaded and written in %llums", ms);
+	fastboot_tx_print(f_fb, "INFOthat is %s",
+			  rate_human_readable(f_fb->download_bytes, ns));
+
+	return 0;
 }
 
 static void cb_flash(struct f_fastboot *f_fb, const char *cmd)
@@ -919,6 +1203,31 @@ static void cb_flash(struct f_fastboot *f_fb, const char *cmd)
 	const char *filename = NULL, *sourcefile;
 	enum filetype filetype;
 
+	if (f_fb->stream_entry) {
+		fastboot_tx_print(f_fb, "FAILno data has been streamed");
+		return;
+	}
+
+	if (f_fb->streamed_entry) {
+		fentry = f_fb->streamed_entry;
+		f_fb->streamed_entry = NULL;
+
+		if (f_fb->stream_ret) {
+			fastboot_tx_print(f_fb, "FAILstreaming to %s failed",
+					  fentry->name);
+			return;
+		}
+
+		if (strcmp(cmd, fentry->name)) {
+			fastboot_tx_print(f_fb, "FAILdata has been streamed to %s",
+					  fentry->name);
+			return;
+		}
+
+		fastboot_tx_print(f_fb, "OKAY");
+		return;
+	}
+
 	if (fastboot_download_to_buf(f_fb)) {
 		sourcefile = NULL;
 		filetype = file_detect_type(f_fb->buf, f_fb->download_bytes);
@@ -947,7 +1256,7 @@ static void cb_flash(struct f_fastboot *f_fb, const char *cmd)
 	filename = fentry->filename;
 
 	if (filetype == filetype_android_sparse) {
-		if (!IS_ENABLED(USB_GADGET_FASTBOOT_SPARSE)) {
+		if (!IS_ENABLED(CONFIG_USB_GADGET_FASTBOOT_SPARSE)) {
 			fastboot_tx_print(f_fb, "FAILsparse image not supported");
 			ret = -EOPNOTSUPP;
 			goto out;
@@ -1158,6 +1467,61 @@ static void cb_oem_exec(struct f_fastboot *f_fb, const char *cmd)
 		fastboot_tx_print(f_fb, "OKAY");
 }
 
+static void cb_oem_stream(struct f_fastboot *f_fb, const char *cmd)
+{
+	struct file_list_entry *fentry;
+
+	pr_debug("%s: \"%s\"\n", __func__, cmd);
+
+	cmd = skip_spaces(cmd);
+
+	f_fb->stream_entry = NULL;
+	f_fb->streamed_entry = NULL;
+
+	if (!*cmd) {
+		fastboot_tx_print(f_fb, "INFOstreaming disabled");
+		fastboot_tx_print(f_fb, "OKAY");
+		return;
+	}
+
+	fentry = file_list_entry_by_name(f_fb->files, cmd);
+	if (!fentry) {
+		fastboot_tx_print(f_fb, "FAILNo such partition: %s", cmd);
+		return;
+	}
+
+	if (fentry->flags & FILE_LIST_FLAG_UBI) {
+		fastboot_tx_print(f_fb, "FAILcannot stream to UBI partitions");
+		return;
+	}
+
+	/*
+	 * The board hook and the barebox update handlers need the whole
+	 * image, cb_flash() passes it to them instead of writing it.
+	 */
+	if (f_fb->cmd_flash) {
+		fastboot_tx_print(f_fb, "FAILflashing is handled by the board");
+		return;
+	}
+
+	if (IS_ENABLED(CONFIG_BAREBOX_UPDATE)) {
+		struct bbu_data data = {
+			.devicefile = fentry->filename,
+		};
+
+		if (barebox_update_handler_exists(&data)) {
+			fastboot_tx_print(f_fb, "FAILcannot stream to %s, it has a barebox update handler",
+					  fentry->name);
+			return;
+		}
+	}
+
+	f_fb->stream_entry = fentry;
+
+	fastboot_tx_print(f_fb, "INFOstreaming to %s", fentry->name);
+	fastboot_tx_print(f_fb, "OKAY");
+}
+
 static const struct cmd_dispatch_info cmd_oem_dispatch_info[] = {
 	{
 		.cmd = "getenv ",
@@ -1168,6 +1532,9 @@ static const struct cmd_dispatch_info cmd_oem_dispatch_info[] = {
 	}, {
 		.cmd = "exec ",
 		.cb = cb_oem_exec,
+	}, {
+		.cmd = "stream",
+		.cb = cb_oem_stream,
 	},
 };
 
@@ -1233,7 +1600,7 @@ done:
 
 static int fastboot_globalvars_init(void)
 {
-	if (IS_ENABLED(USB_GADGET_FASTBOOT_SPARSE))
+	if (IS_ENABLED(CONFIG_USB_GADGET_FASTBOOT_SPARSE))
 		globalvar_add_simple_int("usbgadget.fastboot_max_download_size",
 				 &fastboot_max_download_size, "%u");
 
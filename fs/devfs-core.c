@@ -159,6 +159,8 @@ struct cdev *cdev_open(const char *name, unsigned long flags)
 		name += 5;
 
 	cdev = cdev_by_name(name);
+	if (!cdev && device_probe_on_demand(name))
+		cdev = cdev_by_name(name);
 	if (!cdev)
 		return NULL;
 
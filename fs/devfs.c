@@ -114,6 +114,8 @@ static int devfs_open(struct device_d *_dev, FILE *f, const char *filename)
 	int ret;
 
 	cdev = cdev_by_name(filename + 1);
+	if (!cdev && device_probe_on_demand(filename + 1))
+		cdev = cdev_by_name(filename + 1);
 
 	if (!cdev)
 		return -ENOENT;
@@ -186,6 +188,8 @@ static DIR* devfs_opendir(struct device_d *dev, const char *pathname)
 
 	dir = xzalloc(sizeof(DIR));
 
+	wait_for_device_probe();
+
 	if (!list_empty(&cdev_list))
 		dir->priv = list_first_entry(&cdev_list, struct cdev, list);
 
@@ -218,6 +222,8 @@ static int devfs_stat(struct device_d *_dev, const char *filename, struct stat *
 	struct cdev *cdev;
 
 	cdev = lcdev_by_name(filename + 1);
+	if (!cdev && device_probe_on_demand(filename + 1))
+		cdev = lcdev_by_name(filename + 1);
 	if (!cdev)
 		return -ENOENT;
 
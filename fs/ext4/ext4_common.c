@@ -38,43 +38,188 @@
 
 #include "ext4_common.h"
 
-static struct ext4_extent_header *ext4fs_get_extent_block(struct ext2_data *data,
-		char *buf, struct ext4_extent_header *ext_block,
-		uint32_t fileblock, int log2_blksz)
+static int ext4fs_extent_map_add(struct ext2fs_node *node, int *alloc,
+		uint32_t block, uint32_t len, uint64_t start)
 {
-	struct ext4_extent_idx *index;
-	unsigned long long block;
+	struct ext4_extent_map *map;
+
+	if (node->num_extents) {
+		map = &node->extents[node->num_extents - 1];
+
+		if (block < map->block + map->len)
+			return -EINVAL;
+
+		/* merge extents which are contiguous on disk as well */
+		if (block == map->block + map->len &&
+		    start == map->start + map->len) {
+			map->len += len;
+			return 0;
+		}
+	}
+
+	if (node->num_extents == *alloc) {
+		*alloc = *alloc ? *alloc * 2 : 8;
+		node->extents = xrealloc(node->extents,
+					 *alloc * sizeof(*node->extents));
+	}
+
+	map = &node->extents[node->num_extents++];
+	map->block = block;
+	map->len = len;
+	map->start = start;
+
+	return 0;
+}
+
+static int ext4fs_extent_map_walk(struct ext2fs_node *node,
+		struct ext4_extent_header *ext_block, int depth, int *alloc)
+{
+	struct ext2_data *data = node->data;
 	struct ext_filesystem *fs = data->fs;
 	int blksz = EXT2_BLOCK_SIZE(data);
-	int i, ret;
+	int log2_blksz = LOG2_EXT2_BLOCK_SIZE(data);
+	int entries = le16_to_cpu(ext_block->eh_entries);
+	int i, ret = 0;
+	char *buf;
 
-	while (1) {
-		index = (struct ext4_extent_idx *)(ext_block + 1);
+	if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC)
+		return -EINVAL;
 
-		if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC)
-			return 0;
+	if (depth >= 0 && le16_to_cpu(ext_block->eh_depth) != depth)
+		return -EINVAL;
 
-		if (ext_block->eh_depth == 0)
-			return ext_block;
-		i = -1;
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
-				break;
-		} while (fileblock >= le32_to_cpu(index[i].ei_block));
+	depth = le16_to_cpu(ext_block->eh_depth);
+	if (depth > EXT4_EXT_MAX_DEPTH)
+		return -EINVAL;
 
-		if (--i < 0)
-			return 0;
+	if (depth == 0) {
+		struct ext4_extent *extent = (struct ext4_extent *)(ext_block + 1);
+
+		for (i = 0; i < entries; i++) {
+			uint32_t len = le16_to_cpu(extent[i].ee_len);
+			uint64_t start;
+
+			/* uninitialized extents read as zeroes, leave a hole */
+			if (len > EXT4_EXT_INIT_MAX_LEN)
+				continue;
+
+			start = le16_to_cpu(extent[i].ee_start_hi);
+			start = (start << 32) +
+					le32_to_cpu(extent[i].ee_start_lo);
+
+			ret = ext4fs_extent_map_add(node, alloc,
+					le32_to_cpu(extent[i].ee_block), len,
+					start);
+			if (ret)
+				return ret;
+		}
+
+		return 0;
+	}
+
+	buf = zalloc(blksz);
+	if (!buf)
+		return -ENOMEM;
+
+	for (i = 0; i < entries; i++) {
+		struct ext4_extent_idx *index =
+			(struct ext4_extent_idx *)(ext_block + 1);
+		unsigned long long block;
 
 		block = le16_to_cpu(index[i].ei_leaf_hi);
 		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
 
 		ret = ext4fs_devread(fs, block << log2_blksz, 0, blksz, buf);
 		if (ret)
-			return NULL;
+			break;
+
+		ret = ext4fs_extent_map_walk(node,
+				(struct ext4_extent_header *)buf, depth - 1,
+				alloc);
+		if (ret)
+			break;
+	}
+
+	free(buf);
+
+	return ret;
+}
+
+/*
+ * Flatten the extent tree of an inode into a sorted array of runs, so
+ * that mapping a file block no longer reads the index blocks again.
+ */
+static int ext4fs_read_extent_map(struct ext2fs_node *node)
+{
+	int alloc = 0;
+	int ret;
+
+	if (node->extents_read)
+		return 0;
+
+	ret = ext4fs_extent_map_walk(node,
+			(struct ext4_extent_header *)node->inode.b.blocks.dir_blocks,
+			-1, &alloc);
+	if (ret) {
+		pr_err("invalid extent block\n");
+		free(node->extents);
+		node->extents = NULL;
+		node->num_extents = 0;
+		return ret;
+	}
+
+	node->extents_read = 1;
+
+	return 0;
+}
+
+static long int ext4fs_map_extent(struct ext2fs_node *node, int fileblock,
+		int maxblocks, int *num)
+{
+	struct ext4_extent_map *map;
+	uint32_t block = fileblock;
+	int lo = 0, hi, ret;
+
+	ret = ext4fs_read_extent_map(node);
+	if (ret)
+		return ret;
+
+	/* find the first run which ends behind the requested block */
+	hi = node->num_extents;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		map = &node->extents[mid];
+		if (map->block + map->len <= block)
+			lo = mid + 1;
 		else
-			ext_block = (struct ext4_extent_header *)buf;
+			hi = mid;
+	}
+
+	if (lo == node->num_extents) {
+		*num = maxblocks;
+		return 0;
+	}
+
+	map = &node->extents[lo];
+
+	if (block < map->block) {
+		/* hole up to the next run */
+		*num = min_t(uint32_t, maxblocks, map->block - block);
+		return 0;
 	}
+
+	*num = min_t(uint32_t, maxblocks, map->block + map->len - block);
+
+	return map->start + block - map->block;
+}
+
+void ext4fs_free_extent_map(struct ext2fs_node *node)
+{
+	free(node->extents);
+	node->extents = NULL;
+	node->num_extents = 0;
+	node->extents_read = 0;
 }
 
 static int ext4fs_blockgroup(struct ext2_data *data, int group,
@@ -157,7 +302,6 @@ long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 	long int rblock;
 	long int perblock_parent;
 	long int perblock_child;
-	unsigned long long start;
 	struct ext2_inode *inode = &node->inode;
 	struct ext2_data *data = node->data;
 	int ret;
@@ -167,47 +311,9 @@ long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 	log2_blksz = LOG2_EXT2_BLOCK_SIZE(node->data);
 
 	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		char *buf = zalloc(blksz);
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i = -1;
-
-		if (!buf)
-			return -ENOMEM;
-
-		ext_block = ext4fs_get_extent_block(node->data, buf,
-				(struct ext4_extent_header *)inode->b.blocks.dir_blocks,
-				fileblock, log2_blksz);
-		if (!ext_block) {
-			pr_err("invalid extent block\n");
-			free(buf);
-			return -EINVAL;
-		}
-
-		extent = (struct ext4_extent *)(ext_block + 1);
-
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
-				break;
-		} while (fileblock >= le32_to_cpu(extent[i].ee_block));
-
-		if (--i >= 0) {
-			fileblock -= le32_to_cpu(extent[i].ee_block);
-			if (fileblock >= le16_to_cpu(extent[i].ee_len)) {
-				free(buf);
-				return 0;
-			}
-
-			start = le16_to_cpu(extent[i].ee_start_hi);
-			start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-			free(buf);
-			return fileblock + start;
-		}
+		int num;
 
-		free(buf);
-		return -EIO;
+		return ext4fs_map_extent(node, fileblock, 1, &num);
 	}
 
 	if (fileblock < INDIRECT_BLOCKS) {
@@ -265,6 +371,36 @@ long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 	return blknr;
 }
 
+/*
+ * Map up to maxblocks file blocks starting at fileblock. Returns the first
+ * physical block of the run (0 for a hole) and the number of blocks in the
+ * run in *num.
+ */
+long int ext4fs_map_blocks(struct ext2fs_node *node, int fileblock,
+		int maxblocks, int *num)
+{
+	long int blknr, next;
+	int i;
+
+	if (le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL)
+		return ext4fs_map_extent(node, fileblock, maxblocks, num);
+
+	blknr = read_allocated_block(node, fileblock);
+	if (blknr < 0)
+		return blknr;
+
+	/* the indirect blocks are cached, so coalescing is cheap here */
+	for (i = 1; i < maxblocks; i++) {
+		next = read_allocated_block(node, fileblock + i);
+		if (next != (blknr ? blknr + i : 0))
+			break;
+	}
+
+	*num = i;
+
+	return blknr;
+}
+
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
@@ -557,6 +693,7 @@ fail:
 
 void ext4fs_umount(struct ext_filesystem *fs)
 {
+	ext4fs_free_extent_map(&fs->data->diropen);
 	free(fs->data->indir1.data);
 	free(fs->data->indir2.data);
 	free(fs->data->indir3.data);
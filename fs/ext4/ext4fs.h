@@ -30,6 +30,8 @@
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
 #define EXT4_FEATURE_INCOMPAT_64BIT	0x0080
 #define EXT4_INDIRECT_BLOCKS		12
+#define EXT4_EXT_MAX_DEPTH		5
+#define EXT4_EXT_INIT_MAX_LEN		(1 << 15)
 
 #define EXT4_BG_INODE_UNINIT		0x0001
 #define EXT4_BG_BLOCK_UNINIT		0x0002
@@ -126,5 +128,7 @@ char *ext4fs_read_symlink(struct ext2fs_node *node);
 void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot);
 int ext4fs_devread(struct ext_filesystem *fs, int sector, int byte_offset, int byte_len, char *buf);
 long int read_allocated_block(struct ext2fs_node *node, int fileblock);
+long int ext4fs_map_blocks(struct ext2fs_node *node, int fileblock,
+			   int maxblocks, int *num);
 
 #endif
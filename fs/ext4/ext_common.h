@@ -207,11 +207,22 @@ struct ext2_dirent {
 	__u8 filetype;
 };
 
+/* A run of logically contiguous blocks of an extent mapped inode */
+struct ext4_extent_map {
+	uint32_t block;		/* first logical block */
+	uint32_t len;		/* number of blocks */
+	uint64_t start;		/* first physical block */
+};
+
 struct ext2fs_node {
 	struct ext2_data *data;
 	struct ext2_inode inode;
 	int ino;
 	int inode_read;
+	/* extent tree flattened on first read, sorted by logical block */
+	struct ext4_extent_map *extents;
+	int num_extents;
+	int extents_read;
 };
 
 struct ext4fs_indir_block {
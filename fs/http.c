@@ -0,0 +1,432 @@
+/*
+ * http.c - read-only filesystem on top of HTTP GET requests
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#define pr_fmt(fmt) "http: " fmt
+
+#include <common.h>
+#include <net.h>
+#include <tcp.h>
+#include <driver.h>
+#include <fs.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <init.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <linux/stat.h>
+#include <linux/err.h>
+#include <linux/sizes.h>
+
+#define HTTP_PORT	80
+
+/* longest header line we look at, longer lines are truncated */
+#define HTTP_LINE_MAX	256
+
+struct http_priv {
+	IPaddr_t server;
+	uint16_t port;
+	/* host[:port] as given by the user, sent as Host header */
+	const char *host;
+};
+
+struct file_priv {
+	struct http_priv *hpriv;
+	char *path;
+	struct tcp_connection *tcp;
+	/* position of the response body in the file */
+	loff_t pos;
+	/* file size or FILE_SIZE_STREAM if the server didn't tell */
+	loff_t size;
+};
+
+static int http_getline(struct tcp_connection *tcp, char *line, int size)
+{
+	int len = 0, ret;
+	char c;
+
+	while (1) {
+		ret = tcp_recv(tcp, &c, 1);
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			return -EIO;
+
+		if (c == '\n')
+			break;
+
+		if (c != '\r' && len < size - 1)
+			line[len++] = c;
+	}
+
+	line[len] = 0;
+
+	return len;
+}
+
+static int http_status_to_errno(int status)
+{
+	switch (status) {
+	case 200:
+	case 206:
+		return 0;
+	case 403:
+		return -EACCES;
+	case 404:
+		return -ENOENT;
+	default:
+		return -EIO;
+	}
+}
+
+/*
+ * Send a request for the file starting at @offset and parse the response
+ * header. HTTP/1.0 is used so that the server neither uses chunked encoding
+ * nor keeps the connection open. Servers without support for ranges
+ * respond with the whole file, *@start tells where the body begins.
+ */
+static int http_request(struct file_priv *priv, const char *method,
+			loff_t offset, loff_t *start)
+{
+	struct http_priv *hpriv = priv->hpriv;
+	struct tcp_connection *tcp;
+	char *req, *line;
+	loff_t length = -1, total = -1;
+	int status = 0, ret;
+
+	tcp = tcp_connect(hpriv->server, hpriv->port);
+	if (IS_ERR(tcp))
+		return PTR_ERR(tcp);
+
+	if (offset)
+		req = basprintf("%s %s HTTP/1.0\r\nHost: %s\r\n"
+				"User-Agent: barebox\r\n"
+				"Range: bytes=%lld-\r\n\r\n",
+				method, priv->path, hpriv->host, offset);
+	else
+		req = basprintf("%s %s HTTP/1.0\r\nHost: %s\r\n"
+				"User-Agent: barebox\r\n\r\n",
+				method, priv->path, hpriv->host);
+
+	ret = tcp_send(tcp, req, strlen(req));
+	free(req);
+	if (ret)
+		goto out;
+
+	line = xmalloc(HTTP_LINE_MAX);
+
+	while (1) {
+		ret = http_getline(tcp, line, HTTP_LINE_MAX);
+		if (ret < 0)
+			goto out_free;
+
+		/* an empty line terminates the header */
+		if (!ret)
+			break;
+
+		if (!status) {
+			if (strncmp(line, "HTTP/", 5) || !strchr(line, ' ')) {
+				ret = -EIO;
+				goto out_free;
+			}
+			status = simple_strtoul(strchr(line, ' ') + 1, NULL, 10);
+		} else if (!strncasecmp(line, "Content-Length:", 15)) {
+			length = simple_strtoull(skip_spaces(line + 15), NULL, 10);
+		} else if (!strncasecmp(line, "Content-Range:", 14)) {
+			char *p = strchr(line, '/');
+
+			if (p && p[1] != '*')
+				total = simple_strtoull(p + 1, NULL, 10);
+		}
+	}
+
+	pr_debug("%s %s: status %d\n", method, priv->path, status);
+
+	ret = http_status_to_errno(status);
+	if (ret)
+		goto out_free;
+
+	if (status == 206) {
+		*start = offset;
+		if (total < 0 && length >= 0)
+			total = offset + length;
+	} else {
+		*start = 0;
+		total = length;
+	}
+
+	priv->size = total >= 0 ? total : FILE_SIZE_STREAM;
+	priv->tcp = tcp;
+	free(line);
+
+	return 0;
+
+out_free:
+	free(line);
+out:
+	tcp_close(tcp);
+
+	return ret;
+}
+
+static int http_skip(struct file_priv *priv, loff_t count)
+{
+	char *buf = xmalloc(SZ_4K);
+	int ret = 0;
+
+	while (count) {
+		ret = tcp_recv(priv->tcp, buf, min_t(loff_t, count, SZ_4K));
+		if (!ret)
+			ret = -EINVAL;
+		if (ret < 0)
+			break;
+
+		count -= ret;
+		ret = 0;
+	}
+
+	free(buf);
+
+	return ret;
+}
+
+/* (re)start the response body at @pos */
+static int http_get(struct file_priv *priv, loff_t pos)
+{
+	loff_t start;
+	int ret;
+
+	if (priv->tcp) {
+		tcp_close(priv->tcp);
+		priv->tcp = NULL;
+	}
+
+	ret = http_request(priv, "GET", pos, &start);
+	if (ret)
+		return ret;
+
+	priv->pos = pos;
+
+	return http_skip(priv, pos - start);
+}
+
+static struct file_priv *http_do_open(struct device_d *dev,
+				      const char *filename)
+{
+	struct file_priv *priv = xzalloc(sizeof(*priv));
+
+	priv->hpriv = dev->priv;
+	priv->path = xstrdup(filename);
+
+	return priv;
+}
+
+static void http_do_close(struct file_priv *priv)
+{
+	if (priv->tcp)
+		tcp_close(priv->tcp);
+
+	free(priv->path);
+	free(priv);
+}
+
+static int http_open(struct device_d *dev, FILE *file, const char *filename)
+{
+	struct file_priv *priv;
+	int ret;
+
+	if ((file->flags & O_ACCMODE) != O_RDONLY)
+		return -EROFS;
+
+	priv = http_do_open(dev, filename);
+
+	ret = http_get(priv, 0);
+	if (ret) {
+		http_do_close(priv);
+		return ret;
+	}
+
+	file->priv = priv;
+	file->size = priv->size;
+
+	return 0;
+}
+
+static int http_close(struct device_d *dev, FILE *f)
+{
+	http_do_close(f->priv);
+
+	return 0;
+}
+
+static int http_read(struct device_d *dev, FILE *f, void *buf, size_t insize)
+{
+	struct file_priv *priv = f->priv;
+	size_t outsize = 0;
+	int ret;
+
+	/* seeking is done by starting a new request at the new position */
+	if (priv->pos != f->pos || !priv->tcp) {
+		ret = http_get(priv, f->pos);
+		if (ret)
+			return ret;
+	}
+
+	while (insize) {
+		ret = tcp_recv(priv->tcp, buf, insize);
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			break;
+
+		outsize += ret;
+		buf += ret;
+		insize -= ret;
+	}
+
+	priv->pos += outsize;
+
+	return outsize;
+}
+
+static loff_t http_lseek(struct device_d *dev, FILE *f, loff_t pos)
+{
+	f->pos = pos;
+
+	return f->pos;
+}
+
+static int http_create(struct device_d *dev, const char *pathname, mode_t mode)
+{
+	return -EROFS;
+}
+
+static int http_unlink(struct device_d *dev, const char *pathname)
+{
+	return -EROFS;
+}
+
+static int http_mkdir(struct device_d *dev, const char *pathname)
+{
+	return -EROFS;
+}
+
+static int http_rmdir(struct device_d *dev, const char *pathname)
+{
+	return -EROFS;
+}
+
+static int http_write(struct device_d *dev, FILE *f, const void *buf,
+		      size_t insize)
+{
+	return -EROFS;
+}
+
+static int http_truncate(struct device_d *dev, FILE *f, ulong size)
+{
+	return -EROFS;
+}
+
+static DIR *http_opendir(struct device_d *dev, const char *pathname)
+{
+	/* HTTP has no standard way to list directories */
+	return NULL;
+}
+
+static int http_stat(struct device_d *dev, const char *filename, struct stat *s)
+{
+	struct file_priv *priv;
+	loff_t start;
+	int ret;
+
+	priv = http_do_open(dev, filename);
+
+	ret = http_request(priv, "HEAD", 0, &start);
+	if (ret)
+		goto out;
+
+	s->st_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH;
+	if (priv->size != FILE_SIZE_STREAM)
+		s->st_size = priv->size;
+	else
+		s->st_size = FILESIZE_MAX;
+out:
+	http_do_close(priv);
+
+	return ret;
+}
+
+static int http_probe(struct device_d *dev)
+{
+	struct fs_device_d *fsdev = dev_to_fs_device(dev);
+	struct http_priv *priv;
+	char *host, *port;
+
+	if (!fsdev->backingstore)
+		return -EINVAL;
+
+	priv = xzalloc(sizeof(*priv));
+	priv->host = fsdev->backingstore;
+	priv->port = HTTP_PORT;
+
+	host = xstrdup(fsdev->backingstore);
+	port = strchr(host, ':');
+	if (port) {
+		*port++ = 0;
+		priv->port = simple_strtoul(port, NULL, 10);
+	}
+
+	priv->server = resolv(host);
+	free(host);
+
+	if (!priv->server) {
+		free(priv);
+		return -EINVAL;
+	}
+
+	dev->priv = priv;
+
+	return 0;
+}
+
+static void http_remove(struct device_d *dev)
+{
+	struct http_priv *priv = dev->priv;
+
+	free(priv);
+}
+
+static struct fs_driver_d http_driver = {
+	.open      = http_open,
+	.close     = http_close,
+	.read      = http_read,
+	.lseek     = http_lseek,
+	.opendir   = http_opendir,
+	.stat      = http_stat,
+	.create    = http_create,
+	.unlink    = http_unlink,
+	.mkdir     = http_mkdir,
+	.rmdir     = http_rmdir,
+	.write     = http_write,
+	.truncate  = http_truncate,
+	.flags     = 0,
+	.drv = {
+		.probe  = http_probe,
+		.remove = http_remove,
+		.name = "http",
+	}
+};
+
+static int http_init(void)
+{
+	return register_fs_driver(&http_driver);
+}
+coredevice_initcall(http_init);
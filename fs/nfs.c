@@ -32,7 +32,6 @@
 #include <init.h>
 #include <linux/stat.h>
 #include <linux/err.h>
-#include <kfifo.h>
 #include <linux/sizes.h>
 #include <byteorder.h>
 #include <globalvar.h>
@@ -57,6 +56,7 @@
 #define NFSPROC3_READLINK	5
 #define NFSPROC3_READ		6
 #define NFSPROC3_READDIR	16
+#define NFSPROC3_FSINFO		19
 
 #define NFS3_FHSIZE      64
 #define NFS3_COOKIEVERFSIZE	8
@@ -127,6 +127,28 @@ struct rpc_reply {
 #define NFS_TIMEOUT	(2 * SECOND)
 #define NFS_MAX_RESEND	5
 
+/*
+ * Without IP fragment reassembly READ replies have to fit into a single
+ * ethernet frame. Otherwise use the maximum Linux allows for NFS over UDP.
+ */
+#define NFS_MAX_RSIZE	(IS_ENABLED(CONFIG_NET_IP_REASSEMBLY) ? SZ_32K : SZ_1K)
+
+/* number of READ requests in flight when filling the file buffer */
+#define NFS_READ_WINDOW	8
+
+struct nfs_read_slot {
+	uint32_t rpc_id;
+	uint64_t offset;
+	uint32_t count;
+	void *buf;
+	uint32_t rlen;
+	int eof;
+	/* 0 while in flight, 1 when done, negative error code on failure */
+	int status;
+	uint64_t sent;
+	int tries;
+};
+
 struct nfs_priv {
 	struct net_connection *con;
 	IPaddr_t server;
@@ -138,11 +160,18 @@ struct nfs_priv {
 	uint32_t rpc_id;
 	uint32_t rootfh_len;
 	char rootfh[NFS3_FHSIZE];
+	uint32_t rsize;
+	/* READ requests in flight, their replies are handled in nfs_handler() */
+	struct nfs_read_slot *reads;
+	int num_reads;
 };
 
 struct file_priv {
-	struct kfifo *fifo;
+	/* file data cache, holds buf_len bytes starting at file offset buf_pos */
 	void *buf;
+	size_t buf_size;
+	uint64_t buf_pos;
+	size_t buf_len;
 	uint32_t filefh_len;
 	char filefh[NFS3_FHSIZE];
 	struct nfs_priv *npriv;
@@ -376,21 +405,16 @@ static int rpc_check_reply(unsigned char *pkt,
 }
 
 /*
- * rpc_req - synchronous RPC request
+ * rpc_send - send a RPC request without waiting for the reply
  */
-static int rpc_req(struct nfs_priv *npriv, int rpc_prog, int rpc_proc,
-		uint32_t *data, int datalen)
+static int rpc_send(struct nfs_priv *npriv, int rpc_prog, int rpc_proc,
+		uint32_t rpc_id, uint32_t *data, int datalen)
 {
 	struct rpc_call pkt;
 	unsigned short dport;
-	int ret;
 	unsigned char *payload = net_udp_get_payload(npriv->con);
-	int nfserr;
-	int tries = 0;
 
-	npriv->rpc_id++;
-
-	pkt.id = hton32(npriv->rpc_id);
+	pkt.id = hton32(rpc_id);
 	pkt.type = hton32(MSG_CALL);
 	pkt.rpcvers = hton32(2);	/* use RPC version 2 */
 	pkt.prog = hton32(rpc_prog);
@@ -414,9 +438,24 @@ static int rpc_req(struct nfs_priv *npriv, int rpc_prog, int rpc_proc,
 
 	npriv->con->udp->uh_dport = hton16(dport);
 
-again:
-	ret = net_udp_send(npriv->con,
+	return net_udp_send(npriv->con,
 			sizeof(pkt) + datalen * sizeof(uint32_t));
+}
+
+/*
+ * rpc_req - synchronous RPC request
+ */
+static int rpc_req(struct nfs_priv *npriv, int rpc_prog, int rpc_proc,
+		uint32_t *data, int datalen)
+{
+	int ret;
+	int nfserr;
+	int tries = 0;
+
+	npriv->rpc_id++;
+
+again:
+	ret = rpc_send(npriv, rpc_prog, rpc_proc, npriv->rpc_id, data, datalen);
 
 	nfs_timer_start = get_time_ns();
 
@@ -780,6 +819,78 @@ static int nfs_attr_req(struct file_priv *priv, struct stat *s)
 	return 0;
 }
 
+/*
+ * nfs_fsinfo_req - Get the transfer sizes supported by the server
+ */
+static int nfs_fsinfo_req(struct nfs_priv *npriv)
+{
+	uint32_t data[1024];
+	uint32_t *p;
+	uint32_t rtmax, rtpref;
+	int len;
+	int ret;
+
+	/*
+	 * struct FSINFOargs {
+	 * 	nfs_fh3 fsroot;
+	 * }
+	 *
+	 * struct FSINFO3resok {
+	 * 	post_op_attr obj_attributes;
+	 * 	uint32 rtmax;
+	 * 	uint32 rtpref;
+	 * 	uint32 rtmult;
+	 * 	uint32 wtmax;
+	 * 	uint32 wtpref;
+	 * 	uint32 wtmult;
+	 * 	uint32 dtpref;
+	 * 	size3 maxfilesize;
+	 * 	nfstime3 time_delta;
+	 * 	uint32 properties;
+	 * };
+	 *
+	 * struct FSINFO3resfail {
+	 * 	post_op_attr obj_attributes;
+	 * };
+	 *
+	 * union FSINFO3res switch (nfsstat3 status) {
+	 * case NFS3_OK:
+	 * 	FSINFO3resok resok;
+	 * default:
+	 * 	FSINFO3resfail resfail;
+	 * };
+	 */
+
+	p = &(data[0]);
+	p = rpc_add_credentials(p);
+
+	/* fsroot */
+	p = nfs_add_fh3(p, npriv->rootfh_len, npriv->rootfh);
+
+	len = p - &(data[0]);
+
+	ret = rpc_req(npriv, PROG_NFS, NFSPROC3_FSINFO, data, len);
+	if (ret)
+		return ret;
+
+	p = nfs_packet + sizeof(struct rpc_reply) + 4;
+
+	p = nfs_read_post_op_attr(p, NULL);
+
+	rtmax = ntoh32(net_read_uint32(p++));
+	rtpref = ntoh32(net_read_uint32(p++));
+
+	debug("%s: rtmax: %u rtpref: %u\n", __func__, rtmax, rtpref);
+
+	/* same as Linux: use the preferred size unless told otherwise */
+	if (!npriv->rsize)
+		npriv->rsize = rtpref;
+	if (rtmax && npriv->rsize > rtmax)
+		npriv->rsize = rtmax;
+
+	return 0;
+}
+
 /*
  * returns with dir->stream pointing to the first entry
  * of dirlist3 res.resok.reply
@@ -870,16 +981,13 @@ static void *nfs_readdirattr_req(struct file_priv *priv, struct nfs_dir *dir)
 }
 
 /*
- * nfs_read_req - Read File on NFS Server
+ * nfs_read_send - Send a READ request for a slot of the read window
  */
-static int nfs_read_req(struct file_priv *priv, uint64_t offset,
-		uint32_t readlen)
+static int nfs_read_send(struct file_priv *priv, struct nfs_read_slot *slot)
 {
 	uint32_t data[1024];
 	uint32_t *p;
 	int len;
-	int ret;
-	uint32_t rlen, eof;
 
 	/*
 	 * struct READ3args {
@@ -887,7 +995,55 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 * 	offset3 offset;
 	 * 	count3 count;
 	 * };
-	 *
+	 */
+	p = &(data[0]);
+	p = rpc_add_credentials(p);
+
+	p = nfs_add_fh3(p, priv->filefh_len, priv->filefh);
+	p = nfs_add_uint64(p, slot->offset);
+	p = nfs_add_uint32(p, slot->count);
+
+	len = p - &(data[0]);
+
+	slot->sent = get_time_ns();
+
+	return rpc_send(priv->npriv, PROG_NFS, NFSPROC3_READ, slot->rpc_id,
+			data, len);
+}
+
+/*
+ * nfs_read_reply - Handle the reply to a READ request in flight
+ *
+ * Returns true if the packet answers one of the requests in the read window.
+ */
+static bool nfs_read_reply(struct nfs_priv *npriv, unsigned char *pkt,
+		int len)
+{
+	struct nfs_read_slot *slot = NULL;
+	uint32_t *p, rlen;
+	uint32_t id;
+	int i, ret, nfserr;
+
+	if (!npriv->num_reads || len < sizeof(struct rpc_reply) + 4)
+		return false;
+
+	id = ntoh32(net_read_uint32(pkt));
+
+	for (i = 0; i < npriv->num_reads; i++) {
+		if (npriv->reads[i].rpc_id == id) {
+			slot = &npriv->reads[i];
+			break;
+		}
+	}
+
+	if (!slot)
+		return false;
+
+	/* duplicate reply to a retransmitted request */
+	if (slot->status)
+		return true;
+
+	/*
 	 * struct READ3resok {
 	 * 	post_op_attr file_attributes;
 	 * 	count3 count;
@@ -906,20 +1062,13 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 * 	READ3resfail resfail;
 	 * };
 	 */
-	p = &(data[0]);
-	p = rpc_add_credentials(p);
-
-	p = nfs_add_fh3(p, priv->filefh_len, priv->filefh);
-	p = nfs_add_uint64(p, offset);
-	p = nfs_add_uint32(p, readlen);
-
-	len = p - &(data[0]);
-
-	ret = rpc_req(priv->npriv, PROG_NFS, NFSPROC3_READ, data, len);
-	if (ret)
-		return ret;
+	ret = rpc_check_reply(pkt, PROG_NFS, slot->rpc_id, &nfserr);
+	if (ret || nfserr) {
+		slot->status = ret ? ret : nfserr;
+		return true;
+	}
 
-	p = nfs_packet + sizeof(struct rpc_reply) + 4;
+	p = (uint32_t *)(pkt + sizeof(struct rpc_reply) + 4);
 
 	p = nfs_read_post_op_attr(p, NULL);
 
@@ -928,7 +1077,7 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	/* skip over count */
 	p += 1;
 
-	eof = ntoh32(net_read_uint32(p));
+	slot->eof = ntoh32(net_read_uint32(p));
 
 	/*
 	 * skip over eof and count embedded in the representation of data
@@ -936,17 +1085,124 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 */
 	p += 2;
 
-	if (readlen && !rlen && !eof)
-		return -EIO;
+	if (rlen > slot->count || (void *)p + rlen > (void *)pkt + len) {
+		slot->status = -EIO;
+		return true;
+	}
 
-	kfifo_put(priv->fifo, (char *)p, rlen);
+	memcpy(slot->buf, p, rlen);
 
-	return 0;
+	slot->rlen = rlen;
+	slot->status = 1;
+
+	return true;
+}
+
+/*
+ * nfs_read_fill - Read file data starting at @offset into the file buffer
+ *
+ * Up to NFS_READ_WINDOW READ requests are sent before waiting for the
+ * replies, so filling the buffer costs a single round trip instead of
+ * one per request.
+ */
+static int nfs_read_fill(struct file_priv *priv, uint64_t offset,
+		loff_t size)
+{
+	struct nfs_priv *npriv = priv->npriv;
+	struct nfs_read_slot slots[NFS_READ_WINDOW] = {};
+	size_t len = priv->buf_size;
+	int i, num, pending, ret;
+
+	priv->buf_pos = offset;
+	priv->buf_len = 0;
+
+	/* don't bother the server with reads past the end of file */
+	if (size > offset && size - offset < len)
+		len = size - offset;
+
+	num = DIV_ROUND_UP(len, npriv->rsize);
+
+	for (i = 0; i < num; i++) {
+		struct nfs_read_slot *slot = &slots[i];
+
+		slot->rpc_id = ++npriv->rpc_id;
+		slot->offset = offset + i * npriv->rsize;
+		slot->count = min_t(size_t, npriv->rsize, len - i * npriv->rsize);
+		slot->buf = priv->buf + i * npriv->rsize;
+
+		ret = nfs_read_send(priv, slot);
+		if (ret)
+			return ret;
+	}
+
+	npriv->reads = slots;
+	npriv->num_reads = num;
+
+	do {
+		if (ctrlc()) {
+			ret = -EINTR;
+			goto out;
+		}
+
+		net_poll();
+
+		pending = 0;
+
+		for (i = 0; i < num; i++) {
+			struct nfs_read_slot *slot = &slots[i];
+
+			if (slot->status < 0) {
+				ret = slot->status;
+				goto out;
+			}
+
+			if (slot->status)
+				continue;
+
+			pending++;
+
+			if (is_timeout(slot->sent, NFS_TIMEOUT)) {
+				if (++slot->tries == NFS_MAX_RESEND) {
+					ret = -ETIMEDOUT;
+					goto out;
+				}
+				nfs_read_send(priv, slot);
+			}
+		}
+	} while (pending);
+
+	if (!slots[0].rlen && !slots[0].eof) {
+		ret = -EIO;
+		goto out;
+	}
+
+	/* the buffer ends with the first short read */
+	for (i = 0; i < num; i++) {
+		priv->buf_len += slots[i].rlen;
+		if (slots[i].rlen < slots[i].count)
+			break;
+	}
+
+	ret = 0;
+out:
+	npriv->reads = NULL;
+	npriv->num_reads = 0;
+
+	return ret;
 }
 
 static void nfs_handler(void *ctx, char *packet, unsigned len)
 {
+	struct nfs_priv *npriv = ctx;
 	char *pkt = net_eth_to_udp_payload(packet);
+	int udplen = net_eth_to_udplen(packet);
+
+	if (nfs_read_reply(npriv, pkt, udplen))
+		return;
+
+	/* drop late replies to earlier requests */
+	if (udplen < 4 || ntoh32(net_read_uint32(pkt)) != npriv->rpc_id)
+		return;
 
 	nfs_state = STATE_DONE;
 	nfs_packet = pkt;
@@ -1031,9 +1287,7 @@ out:
 
 static void nfs_do_close(struct file_priv *priv)
 {
-	if (priv->fifo)
-		kfifo_free(priv->fifo);
-
+	free(priv->buf);
 	free(priv);
 }
 
@@ -1149,8 +1403,9 @@ static int nfs_open(struct device_d *dev, FILE *file, const char *filename)
 	file->priv = priv;
 	file->size = s.st_size;
 
-	priv->fifo = kfifo_alloc(1024);
-	if (!priv->fifo) {
+	priv->buf_size = priv->npriv->rsize * NFS_READ_WINDOW;
+	priv->buf = malloc(priv->buf_size);
+	if (!priv->buf) {
 		free(priv);
 		return -ENOMEM;
 	}
@@ -1176,25 +1431,31 @@ static int nfs_write(struct device_d *_dev, FILE *file, const void *inbuf,
 static int nfs_read(struct device_d *dev, FILE *file, void *buf, size_t insize)
 {
 	struct file_priv *priv = file->priv;
+	uint64_t pos = file->pos;
+	size_t now;
 
-	if (insize > 1024)
-		insize = 1024;
+	if (!insize)
+		return 0;
 
-	if (insize && !kfifo_len(priv->fifo)) {
-		int ret = nfs_read_req(priv, file->pos, insize);
+	if (pos < priv->buf_pos || pos >= priv->buf_pos + priv->buf_len) {
+		int ret = nfs_read_fill(priv, pos, file->size);
 		if (ret)
 			return ret;
 	}
 
-	return kfifo_get(priv->fifo, buf, insize);
+	if (pos >= priv->buf_pos + priv->buf_len)
+		return 0;
+
+	now = min_t(size_t, insize, priv->buf_pos + priv->buf_len - pos);
+
+	memcpy(buf, priv->buf + (pos - priv->buf_pos), now);
+
+	return now;
 }
 
 static loff_t nfs_lseek(struct device_d *dev, FILE *file, loff_t pos)
 {
-	struct file_priv *priv = file->priv;
-
 	file->pos = pos;
-	kfifo_reset(priv->fifo);
 
 	return file->pos;
 }
@@ -1349,6 +1610,7 @@ static int nfs_probe(struct device_d *dev)
 	struct nfs_priv *npriv = xzalloc(sizeof(struct nfs_priv));
 	char *tmp = xstrdup(fsdev->backingstore);
 	char *path;
+	unsigned long long rsize = 0;
 	int ret;
 
 	dev->priv = npriv;
@@ -1410,6 +1672,20 @@ static int nfs_probe(struct device_d *dev)
 		goto err2;
 	}
 
+	parseopt_llu_suffix(fsdev->options, "rsize", &rsize);
+	npriv->rsize = min_t(unsigned long long, rsize, NFS_MAX_RSIZE);
+
+	ret = nfs_fsinfo_req(npriv);
+	if (ret)
+		debug("nfs: fsinfo failed with %d\n", ret);
+
+	if (!npriv->rsize || npriv->rsize > NFS_MAX_RSIZE)
+		npriv->rsize = NFS_MAX_RSIZE;
+
+	debug("nfs: rsize: %u\n", npriv->rsize);
+
+	dev_add_param_uint32_ro(dev, "rsize", &npriv->rsize, "%u");
+
 	nfs_set_rootarg(npriv, fsdev);
 
 	free(tmp);
@@ -32,6 +32,7 @@
 #include <linux/err.h>
 #include <kfifo.h>
 #include <linux/sizes.h>
+#include <linux/log2.h>
 
 #define TFTP_PORT	69	/* Well known TFTP port number */
 
@@ -54,6 +55,9 @@
 #define TFTP_ERROR	5
 #define TFTP_OACK	6
 
+/* error code for a failed option negotiation, RFC 2347 */
+#define TFTP_ERR_OPTION_NEGOTIATION	8
+
 #define STATE_RRQ	1
 #define STATE_WRQ	2
 #define STATE_RDATA	3
@@ -64,7 +68,15 @@
 #define STATE_DONE	8
 
 #define TFTP_BLOCK_SIZE		512	/* default TFTP block size */
-#define TFTP_FIFO_SIZE		4096
+
+/* largest block size which fits into a single ethernet frame */
+#define TFTP_MAX_BLOCK_SIZE	(PKTSIZE - ETHER_HDR_SIZE - 4 /* FCS */ - \
+				 sizeof(struct iphdr) - sizeof(struct udphdr) - \
+				 4 /* TFTP header */)
+
+/* room for a full window of blocks, kfifo needs a power of two */
+#define TFTP_FIFO_SIZE		roundup_pow_of_two(CONFIG_FS_TFTP_MAX_WINDOW_SIZE * \
+						   TFTP_MAX_BLOCK_SIZE)
 
 #define TFTP_ERR_RESEND	1
 
@@ -82,7 +94,9 @@ struct file_priv {
 	struct kfifo *fifo;
 	void *buf;
 	int blocksize;
+	int windowsize;
 	int block_requested;
+	int gap;
 };
 
 struct tftp_priv {
@@ -142,15 +156,25 @@ static int tftp_send(struct file_priv *priv)
 				"tsize%c"
 				"%d%c"
 				"blksize%c"
-				"1432",
+				"%d",
 				priv->filename, 0,
 				0,
 				0,
 				TIMEOUT, 0,
 				0,
 				priv->filesize, 0,
-				0);
+				0,
+				(int)TFTP_MAX_BLOCK_SIZE);
 		pkt++;
+		/* windowed transfers (RFC 7440) are only supported for reading */
+		if (priv->state == STATE_RRQ && CONFIG_FS_TFTP_MAX_WINDOW_SIZE > 1) {
+			pkt += sprintf((unsigned char *)pkt,
+					"windowsize%c"
+					"%d",
+					0,
+					CONFIG_FS_TFTP_MAX_WINDOW_SIZE);
+			pkt++;
+		}
 		len = pkt - xp;
 		break;
 
@@ -173,10 +197,29 @@ static int tftp_send(struct file_priv *priv)
 	return ret;
 }
 
+/*
+ * Acknowledge the last block received in sequence, but only when the
+ * current window is complete or a resend was requested. The server sends
+ * the next window right after our ACK, so make sure the fifo can take it.
+ */
+static int tftp_send_window_ack(struct file_priv *priv)
+{
+	if (priv->block_requested >= 0 &&
+	    (uint16_t)(priv->block - priv->block_requested) < priv->windowsize)
+		return 0;
+
+	if (priv->fifo->size - kfifo_len(priv->fifo) <
+	    priv->windowsize * priv->blocksize)
+		return 0;
+
+	return tftp_send(priv);
+}
+
 static int tftp_send_write(struct file_priv *priv, void *buf, int len)
 {
 	uint16_t *s;
-	unsigned char *pkt = net_udp_get_payload(priv->tftp_con);
+	/* build the block in a transmit buffer of the driver if possible */
+	unsigned char *pkt = net_udp_get_tx_payload(priv->tftp_con);
 	int ret;
 
 	s = (uint16_t *)pkt;
@@ -187,7 +230,7 @@ static int tftp_send_write(struct file_priv *priv, void *buf, int len)
 		priv->state = STATE_LAST;
 	len += 4;
 
-	ret = net_udp_send(priv->tftp_con, len);
+	ret = net_udp_send_tx_payload(priv->tftp_con, pkt, len);
 	priv->last_block = priv->block;
 	priv->state = STATE_WAITACK;
 
@@ -220,7 +263,23 @@ static int tftp_poll(struct file_priv *priv)
 	return 0;
 }
 
-static void tftp_parse_oack(struct file_priv *priv, unsigned char *pkt, int len)
+static void tftp_send_error(struct file_priv *priv, uint16_t code,
+			    const char *msg)
+{
+	uint16_t *pkt = net_udp_get_payload(priv->tftp_con);
+
+	*pkt++ = htons(TFTP_ERROR);
+	*pkt++ = htons(code);
+	strcpy((char *)pkt, msg);
+
+	net_udp_send(priv->tftp_con, 4 + strlen(msg) + 1);
+}
+
+/*
+ * The server may only lower the values we asked for. Anything else fails
+ * the option negotiation and, as RFC 2347 demands, aborts the transfer.
+ */
+static int tftp_parse_oack(struct file_priv *priv, unsigned char *pkt, int len)
 {
 	unsigned char *opt, *val, *s;
 
@@ -237,14 +296,33 @@ static void tftp_parse_oack(struct file_priv *priv, unsigned char *pkt, int len)
 		opt = s;
 		val = s + strlen(s) + 1;
 		if (val > s + len)
-			return;
+			return 0;
 		if (!strcmp(opt, "tsize"))
 			priv->filesize = simple_strtoul(val, NULL, 10);
 		if (!strcmp(opt, "blksize"))
 			priv->blocksize = simple_strtoul(val, NULL, 10);
+		if (!strcmp(opt, "windowsize"))
+			priv->windowsize = simple_strtoul(val, NULL, 10);
 		debug("OACK opt: %s val: %s\n", opt, val);
 		s = val + strlen(val) + 1;
 	}
+
+	if (priv->blocksize < 8 || priv->blocksize > TFTP_MAX_BLOCK_SIZE) {
+		pr_err("tftp: invalid blksize %d in OACK\n", priv->blocksize);
+		tftp_send_error(priv, TFTP_ERR_OPTION_NEGOTIATION,
+				"invalid blksize");
+		return -EINVAL;
+	}
+
+	if (priv->windowsize < 1 ||
+	    priv->windowsize > CONFIG_FS_TFTP_MAX_WINDOW_SIZE) {
+		pr_err("tftp: invalid windowsize %d in OACK\n", priv->windowsize);
+		tftp_send_error(priv, TFTP_ERR_OPTION_NEGOTIATION,
+				"invalid windowsize");
+		return -EINVAL;
+	}
+
+	return 0;
 }
 
 static void tftp_timer_reset(struct file_priv *priv)
@@ -255,7 +333,7 @@ static void tftp_timer_reset(struct file_priv *priv)
 static void tftp_recv(struct file_priv *priv,
 			uint8_t *pkt, unsigned len, uint16_t uh_sport)
 {
-	uint16_t opcode;
+	uint16_t opcode, block;
 
 	/* according to RFC1350 minimal tftp packet length is 4 bytes */
 	if (len < 4)
@@ -297,9 +375,14 @@ static void tftp_recv(struct file_priv *priv,
 		break;
 
 	case TFTP_OACK:
-		tftp_parse_oack(priv, pkt, len);
 		priv->tftp_con->udp->uh_dport = uh_sport;
 
+		if (tftp_parse_oack(priv, pkt, len)) {
+			priv->err = -EINVAL;
+			priv->state = STATE_DONE;
+			break;
+		}
+
 		if (priv->push) {
 			/* send first block */
 			priv->state = STATE_WDATA;
@@ -314,7 +397,7 @@ static void tftp_recv(struct file_priv *priv,
 		break;
 	case TFTP_DATA:
 		len -= 2;
-		priv->block = ntohs(*(uint16_t *)pkt);
+		block = ntohs(*(uint16_t *)pkt);
 
 		if (priv->state == STATE_RRQ || priv->state == STATE_OACK) {
 			/* first block received */
@@ -322,26 +405,42 @@ static void tftp_recv(struct file_priv *priv,
 			priv->tftp_con->udp->uh_dport = uh_sport;
 			priv->last_block = 0;
 
-			if (priv->block != 1) {	/* Assertion */
+			if (block != 1) {	/* Assertion */
 				printf("error: First block is not block 1 (%d)\n",
-					priv->block);
+					block);
 				priv->err = -EINVAL;
 				priv->state = STATE_DONE;
 				break;
 			}
 		}
 
-		if (priv->block == priv->last_block)
-			/* Same block again; ignore it. */
+		if (block != (uint16_t)(priv->last_block + 1)) {
+			/*
+			 * A block from the current window got lost. Ack the
+			 * last block received in sequence once so that the
+			 * server restarts the window from there. Older blocks
+			 * are duplicates and are ignored.
+			 */
+			if ((uint16_t)(block - priv->last_block) <=
+			    priv->windowsize && !priv->gap) {
+				debug("tftp: expected block %d, got %d\n",
+				      (uint16_t)(priv->last_block + 1), block);
+				priv->gap = 1;
+				priv->block_requested = -1;
+				tftp_send_window_ack(priv);
+			}
 			break;
+		}
 
-		priv->last_block = priv->block;
+		priv->block = priv->last_block = block;
+		priv->gap = 0;
 
 		tftp_timer_reset(priv);
 
 		kfifo_put(priv->fifo, pkt + 2, len);
 
 		if (len < priv->blocksize) {
+			priv->block_requested = -1;
 			tftp_send(priv);
 			priv->err = 0;
 			priv->state = STATE_DONE;
@@ -415,6 +514,7 @@ static struct file_priv *tftp_do_open(struct device_d *dev,
 	priv->err = -EINVAL;
 	priv->filename = filename;
 	priv->blocksize = TFTP_BLOCK_SIZE;
+	priv->windowsize = 1;
 	priv->block_requested = -1;
 
 	priv->fifo = kfifo_alloc(TFTP_FIFO_SIZE);
@@ -574,12 +674,11 @@ static int tftp_read(struct device_d *dev, FILE *f, void *buf, size_t insize)
 		if (priv->state == STATE_DONE)
 			return outsize;
 
-		if (TFTP_FIFO_SIZE - kfifo_len(priv->fifo) >= priv->blocksize)
-			tftp_send(priv);
+		tftp_send_window_ack(priv);
 
 		ret = tftp_poll(priv);
 		if (ret == TFTP_ERR_RESEND)
-			tftp_send(priv);
+			tftp_send_window_ack(priv);
 		if (ret < 0)
 			return ret;
 	}
@@ -0,0 +1,59 @@
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include <linux/types.h>
+#include <malloc.h>
+#include <xfuncs.h>
+
+struct arena;
+
+#ifdef CONFIG_MALLOC_ARENA
+struct arena *arena_new(const char *name);
+void arena_destroy(struct arena *arena);
+void *arena_alloc(struct arena *arena, size_t size);
+void *arena_zalloc(struct arena *arena, size_t size);
+void *arena_realloc(struct arena *arena, void *ptr, size_t size);
+char *arena_strdup(struct arena *arena, const char *s);
+void arena_free(void *ptr);
+void arena_stats(void);
+#else
+static inline struct arena *arena_new(const char *name)
+{
+	return NULL;
+}
+
+static inline void arena_destroy(struct arena *arena)
+{
+}
+
+static inline void *arena_alloc(struct arena *arena, size_t size)
+{
+	return xmalloc(size);
+}
+
+static inline void *arena_zalloc(struct arena *arena, size_t size)
+{
+	return xzalloc(size);
+}
+
+static inline void *arena_realloc(struct arena *arena, void *ptr, size_t size)
+{
+	return xrealloc(ptr, size);
+}
+
+static inline char *arena_strdup(struct arena *arena, const char *s)
+{
+	return xstrdup(s);
+}
+
+static inline void arena_free(void *ptr)
+{
+	free(ptr);
+}
+
+static inline void arena_stats(void)
+{
+}
+#endif
+
+#endif /* __ARENA_H */
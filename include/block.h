@@ -25,6 +25,22 @@ struct block_device {
 
 	struct list_head buffered_blocks;
 	struct list_head idle_blocks;
+	struct hlist_head *chunk_hash;
+	int chunk_hash_size;
+	void *rabuf;
+	int ra_next;
+
+	/* cache tunables, exported as device parameters */
+	uint32_t cache_chunks;
+	uint32_t cache_chunksize;
+	uint32_t cache_readahead;
+
+	/* cache statistics, exported as device parameters */
+	uint32_t cache_hits;
+	uint32_t cache_misses;
+	uint32_t cache_evictions;
+	uint32_t cache_readaheads;
+	const char *param_prefix;
 
 	struct cdev cdev;
 };
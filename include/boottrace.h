@@ -0,0 +1,18 @@
+#ifndef __BOOTTRACE_H
+#define __BOOTTRACE_H
+
+#ifdef CONFIG_BOOTTRACE
+int boottrace_start(const char *name, void *fn);
+void boottrace_end(int id);
+#else
+static inline int boottrace_start(const char *name, void *fn)
+{
+	return -1;
+}
+
+static inline void boottrace_end(int id)
+{
+}
+#endif
+
+#endif /* __BOOTTRACE_H */
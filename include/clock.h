@@ -24,6 +24,7 @@ static inline uint32_t cyc2ns(struct clocksource *cs, uint64_t cycles)
 }
 
 int init_clock(struct clocksource *);
+int clocksource_registered(void);
 
 uint64_t get_time_ns(void);
 
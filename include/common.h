@@ -61,6 +61,7 @@ void reginfo(void);
 void __noreturn hang (void);
 
 char *size_human_readable(unsigned long long size);
+char *rate_human_readable(unsigned long long bytes, unsigned long long ns);
 
 int	readline	(const char *prompt, char *buf, int len);
 
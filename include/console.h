@@ -46,6 +46,8 @@ struct console_device {
 	int  (*getc)(struct console_device *cdev);
 	int (*setbrg)(struct console_device *cdev, int baudrate);
 	void (*flush)(struct console_device *cdev);
+	/* nonzero when putc can take a character without waiting */
+	int (*tx_ready)(struct console_device *cdev);
 	int (*set_mode)(struct console_device *cdev, enum console_mode mode);
 	int (*open)(struct console_device *cdev);
 	int (*close)(struct console_device *cdev);
@@ -63,6 +65,9 @@ struct console_device {
 	unsigned int baudrate;
 	unsigned int baudrate_param;
 
+	/* output waiting for the hardware, see CONFIG_CONSOLE_TX_BUFFER */
+	struct kfifo *tx_fifo;
+
 	const char *linux_console_name;
 
 	struct cdev devfs;
@@ -8,6 +8,10 @@ extern uint16_t cyg_crc16(const unsigned char *s, int len);
 
 uint32_t crc32(uint32_t, const void *, unsigned int);
 uint32_t crc32_no_comp(uint32_t, const void *, unsigned int);
+uint32_t crc32_no_comp_generic(uint32_t, const void *, unsigned int);
+void crc32_register_arch(const char *name,
+		uint32_t (*fn)(uint32_t crc, const void *buf, unsigned int len));
+const char *crc32_arch_name(void);
 int file_crc(char *filename, unsigned long start, unsigned long size,
 	     unsigned long *crc, unsigned long *total);
 
@@ -83,6 +83,11 @@ struct digest {
  * digest functions
  */
 #ifdef CONFIG_DIGEST
+extern struct list_head digest_algo_list;
+
+#define for_each_digest_algo(algo) \
+	list_for_each_entry(algo, &digest_algo_list, list)
+
 int digest_algo_register(struct digest_algo *d);
 void digest_algo_unregister(struct digest_algo *d);
 void digest_algo_prints(const char *prefix);
@@ -109,6 +109,10 @@ struct driver_d {
 
 	const struct platform_device_id *id_table;
 	const struct of_device_id *of_compatible;
+
+	/*! Probe from a poller instead of when the device is registered.
+	 * Meant for slow probes nothing else depends on during startup. */
+	bool probe_async;
 };
 
 /*@}*/	/* do not delete, doxygen relevant */
@@ -131,6 +135,15 @@ int register_device(struct device_d *);
  */
 int device_probe(struct device_d *dev);
 
+/* probe devices of drivers with probe_async set now instead of in
+ * the background
+ */
+int device_wait_probe(struct device_d *dev);
+int wait_for_device_probe(void);
+int device_probe_on_demand(const char *name);
+/* probe a device waiting to be probed while the console is idle */
+void device_probe_idle(void);
+
 /* detect devices attached to this device (cards, disks,...) */
 int device_detect(struct device_d *dev);
 int device_detect_by_name(const char *devname);
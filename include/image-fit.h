@@ -26,6 +26,13 @@ struct fit_handle {
 	void *fit_alloc;
 	size_t size;
 
+	/* for reading external image data */
+	char *filename;
+	int fd;
+
+	void **image_bufs;
+	int num_image_bufs;
+
 	bool verbose;
 	enum bootm_verify verify;
 
@@ -44,6 +51,10 @@ int fit_has_image(struct fit_handle *handle, void *configuration,
 int fit_open_image(struct fit_handle *handle, void *configuration,
 		   const char *name, const void **outdata,
 		   unsigned long *outsize);
+int fit_get_image_size(struct fit_handle *handle, void *configuration,
+		       const char *name, unsigned long *outsize);
+int fit_load_image(struct fit_handle *handle, void *configuration,
+		   const char *name, void *dest, unsigned long size);
 
 void fit_close(struct fit_handle *handle);
 
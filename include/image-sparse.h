@@ -64,4 +64,23 @@ int sparse_image_read(struct sparse_image_ctx *si, void *buf,
 void sparse_image_close(struct sparse_image_ctx *si);
 loff_t sparse_image_size(struct sparse_image_ctx *si);
 
+typedef int (*sparse_image_write_fn)(void *priv, loff_t pos, const void *buf,
+				     size_t len);
+/*
+ * Fill @len bytes at @pos with @val repeated as little endian 32bit word.
+ * Return -EOPNOTSUPP to have the data written with the write callback.
+ */
+typedef int (*sparse_image_fill_fn)(void *priv, loff_t pos, loff_t len,
+				    uint32_t val);
+
+int sparse_image_write(struct sparse_image_ctx *si, sparse_image_write_fn write,
+		       sparse_image_fill_fn fill, void *priv);
+
+struct sparse_image_ctx *sparse_image_stream_open(sparse_image_write_fn write,
+						  sparse_image_fill_fn fill,
+						  void *priv);
+int sparse_image_stream_feed(struct sparse_image_ctx *si, const void *buf,
+			     size_t len);
+int sparse_image_stream_finish(struct sparse_image_ctx *si);
+
 #endif /* _IMAGE_SPARSE_H */
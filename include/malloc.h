@@ -9,8 +9,37 @@ void *realloc(void *, size_t);
 void *memalign(size_t, size_t);
 void *calloc(size_t, size_t);
 void malloc_stats(void);
+size_t malloc_largest_free(void);
 void *sbrk(ptrdiff_t increment);
 
 int mem_malloc_is_initialized(void);
 
+#ifdef CONFIG_MALLOC_TRACE
+/* the functions of the allocator, common/malloc_trace.c wraps them */
+void *__malloc(size_t);
+void __free(void *);
+void *__realloc(void *, size_t);
+void *__memalign(size_t, size_t);
+void *__calloc(size_t, size_t);
+
+void *malloc_trace_enter(void *caller);
+void malloc_trace_leave(void **prev);
+void malloc_trace_show(int max);
+
+/*
+ * Used at the beginning of allocation helpers like xmalloc(), the
+ * allocations made until the helper returns are attributed to the
+ * caller of the helper instead of the helper itself.
+ */
+#define malloc_trace_caller()						\
+	void *__malloc_trace_prev __attribute__((cleanup(malloc_trace_leave))) \
+		= malloc_trace_enter(__builtin_return_address(0))
+#else
+#define malloc_trace_caller()	do { } while (0)
+
+static inline void malloc_trace_show(int max)
+{
+}
+#endif
+
 #endif /* __MALLOC_H */
@@ -30,6 +30,9 @@
 /* The number of receive packet buffers */
 #define PKTBUFSRX	4
 
+/* Default number of frames a driver may receive per poll */
+#define ETH_RX_BUDGET	16
+
 struct device_d;
 
 struct eth_device {
@@ -40,6 +43,18 @@ struct eth_device {
 	int  (*open) (struct eth_device*);
 	int  (*send) (struct eth_device*, void *packet, int length);
 	int  (*recv) (struct eth_device*);
+	/*
+	 * Optional, used instead of recv: pass up to budget frames to
+	 * net_receive() and return the number of frames received.
+	 */
+	int  (*recv_batch) (struct eth_device*, int budget);
+	/*
+	 * Optional zero-copy transmit: tx_buffer returns a DMA-able buffer
+	 * of PKTSIZE bytes owned by the driver, or NULL if none is free.
+	 * tx_submit sends a frame built in that buffer without copying it.
+	 */
+	void *(*tx_buffer) (struct eth_device*);
+	int  (*tx_submit) (struct eth_device*, void *buf, int length);
 	void (*halt) (struct eth_device*);
 	int  (*get_ethaddr) (struct eth_device*, u8 adr[6]);
 	int  (*set_ethaddr) (struct eth_device*, const unsigned char *adr);
@@ -68,6 +83,13 @@ struct eth_device {
 #define ETH_MODE_STATIC 1
 #define ETH_MODE_DISABLED 2
 	unsigned int global_mode;
+
+	/* maximum number of frames handled per recv_batch call */
+	uint32_t rx_budget;
+
+	/* datagrams reassembled from fragments and dropped incomplete */
+	uint32_t ip_reasm_hits;
+	uint32_t ip_reasm_timeouts;
 };
 
 #define dev_to_edev(d) container_of(d, struct eth_device, dev)
@@ -82,6 +104,8 @@ void eth_unregister(struct eth_device* dev); /* Unregister network device	*/
 int eth_set_ethaddr(struct eth_device *edev, const char *ethaddr);
 
 int eth_send(struct eth_device *edev, void *packet, int length);	   /* Send a packet		*/
+void *eth_get_tx_buffer(struct eth_device *edev);
+int eth_send_tx_buffer(struct eth_device *edev, void *buf, int length);
 int eth_rx(void);			/* Check for received packets	*/
 
 /* associate a MAC address to a ethernet device. Should be called by
@@ -117,6 +141,7 @@ struct ethernet {
 #define PROT_VLAN	0x8100		/* IEEE 802.1q protocol		*/
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 #define IP_BROADCAST    0xffffffff /* Broadcast IP aka 255.255.255.255 */
@@ -138,6 +163,12 @@ struct iphdr {
 	/* The options start here. */
 } __attribute__ ((packed));
 
+#define IP_MF		0x2000		/* more fragments flag */
+#define IP_OFFSET	0x1fff		/* mask for fragment offset */
+
+/* largest payload of a (reassembled) IP datagram */
+#define IP_MAX_PAYLOAD	(0xffff - sizeof(struct iphdr))
+
 struct udphdr {
 	uint16_t	uh_sport;	/* source port */
 	uint16_t	uh_dport;	/* destination port */
@@ -145,6 +176,24 @@ struct udphdr {
 	uint16_t	uh_sum;		/* udp checksum */
 } __attribute__ ((packed));
 
+struct tcphdr {
+	uint16_t	th_sport;	/* source port */
+	uint16_t	th_dport;	/* destination port */
+	uint32_t	th_seq;		/* sequence number */
+	uint32_t	th_ack;		/* acknowledgement number */
+	uint8_t		th_off;		/* data offset in words, upper nibble */
+	uint8_t		th_flags;
+	uint16_t	th_win;		/* window */
+	uint16_t	th_sum;		/* tcp checksum */
+	uint16_t	th_urp;		/* urgent pointer */
+} __attribute__ ((packed));
+
+#define TH_FIN		0x01
+#define TH_SYN		0x02
+#define TH_RST		0x04
+#define TH_PUSH		0x08
+#define TH_ACK		0x10
+
 /*
  *	Address Resolution Protocol (ARP) header.
  */
@@ -437,6 +486,7 @@ struct net_connection {
 	struct udphdr *udp;
 	struct eth_device *edev;
 	struct icmphdr *icmp;
+	struct tcphdr *tcp;
 	unsigned char *packet;
 	struct list_head list;
 	rx_handler_f *handler;
@@ -459,6 +509,9 @@ struct net_connection *net_udp_eth_new(struct eth_device *edev, IPaddr_t dest,
 struct net_connection *net_icmp_new(IPaddr_t dest, rx_handler_f *handler,
 		void *ctx);
 
+struct net_connection *net_tcp_new(IPaddr_t dest, uint16_t dport,
+		rx_handler_f *handler, void *ctx);
+
 void net_unregister(struct net_connection *con);
 
 static inline int net_udp_bind(struct net_connection *con, uint16_t sport)
@@ -473,8 +526,29 @@ static inline void *net_udp_get_payload(struct net_connection *con)
 		sizeof(struct udphdr);
 }
 
+static inline void *net_tcp_get_payload(struct net_connection *con)
+{
+	return con->packet + sizeof(struct ethernet) + sizeof(struct iphdr) +
+		sizeof(struct tcphdr);
+}
+
 int net_udp_send(struct net_connection *con, int len);
+void *net_udp_get_tx_payload(struct net_connection *con);
+int net_udp_send_tx_payload(struct net_connection *con, void *payload, int len);
 int net_icmp_send(struct net_connection *con, int len);
+int net_tcp_send(struct net_connection *con, int len);
+uint16_t net_tcp_checksum(struct iphdr *ip, void *tcp, int len);
+
+#ifdef CONFIG_NET_IP_REASSEMBLY
+unsigned char *net_ip_reassemble(struct eth_device *edev, unsigned char *pkt,
+				 int *len);
+#else
+static inline unsigned char *net_ip_reassemble(struct eth_device *edev,
+					       unsigned char *pkt, int *len)
+{
+	return NULL;
+}
+#endif
 
 void led_trigger_network(enum led_trigger trigger);
 
@@ -34,6 +34,10 @@ struct device_node {
 	struct list_head parent_list;
 	struct list_head list;
 	phandle phandle;
+	struct hlist_node phandle_hash;
+	struct hlist_node path_hash;
+	/* the arena the node and its properties are allocated from */
+	struct arena *arena;
 };
 
 struct of_device_id {
@@ -847,6 +851,7 @@ int of_device_disable_path(const char *path);
 
 phandle of_get_tree_max_phandle(struct device_node *root);
 phandle of_node_create_phandle(struct device_node *node);
+void of_node_set_phandle(struct device_node *node, phandle phandle);
 int of_set_property_to_child_phandle(struct device_node *node, char *prop_name);
 
 static inline struct device_node *of_find_root_node(struct device_node *node)
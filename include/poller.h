@@ -14,6 +14,10 @@ struct poller_struct {
 	void (*func)(struct poller_struct *poller);
 	int registered;
 	struct list_head list;
+
+	/* time spent in the poller and number of calls, for the poller command */
+	uint64_t time_ns;
+	unsigned long calls;
 };
 
 int poller_register(struct poller_struct *poller);
@@ -27,6 +31,8 @@ struct poller_async {
 	void *ctx;
 	uint64_t end;
 	int active;
+	/* position in the queue of scheduled calls, ordered by end */
+	struct list_head queue;
 };
 
 int poller_async_register(struct poller_async *pa);
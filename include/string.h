@@ -8,5 +8,6 @@ int strtobool(const char *str, int *val);
 
 void *__default_memset(void *, int, __kernel_size_t);
 void *__default_memcpy(void * dest,const void *src,size_t count);
+int __default_memcmp(const void *cs, const void *ct, size_t count);
 
 #endif /* __STRING_H */
@@ -0,0 +1,24 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __TCP_H__
+#define __TCP_H__
+
+#include <net.h>
+
+struct tcp_connection;
+
+struct tcp_connection *tcp_connect(IPaddr_t dest, uint16_t dport);
+int tcp_send(struct tcp_connection *tcp, const void *buf, size_t len);
+int tcp_recv(struct tcp_connection *tcp, void *buf, size_t len);
+void tcp_close(struct tcp_connection *tcp);
+
+#endif /* __TCP_H__ */
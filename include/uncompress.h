@@ -1,6 +1,8 @@
 #ifndef __UNCOMPRESS_H
 #define __UNCOMPRESS_H
 
+#include <filetype.h>
+
 int uncompress(unsigned char *inbuf, int len,
 	   int(*fill)(void*, unsigned int),
 	   int(*flush)(void*, unsigned int),
@@ -16,4 +18,66 @@ int uncompress_fd_to_buf(int infd, void *output,
 
 void uncompress_err_stdout(char *);
 
+struct uncompress_stream;
+
+struct uncompress_stream *uncompress_stream_init(void(*error_fn)(char *x));
+int uncompress_stream_feed(struct uncompress_stream *us, const void *buf,
+			   size_t len);
+ssize_t uncompress_stream_drain(struct uncompress_stream *us, void *buf,
+				size_t len);
+enum filetype uncompress_stream_filetype(struct uncompress_stream *us);
+void uncompress_stream_free(struct uncompress_stream *us);
+
+/*
+ * The following is for the decompressors implementing the stream
+ * interface only.
+ */
+struct uncompress_stream_ops {
+	/* called once with the first bytes of the stream in us->in */
+	int (*init)(struct uncompress_stream *us);
+	/*
+	 * Consume input from us->in, decompress to @buf and return the number
+	 * of bytes written. Return 0 when no progress is possible without
+	 * more input, set us->done at the end of the compressed data.
+	 */
+	ssize_t (*drain)(struct uncompress_stream *us, void *buf, size_t len);
+	void (*free)(struct uncompress_stream *us);
+};
+
+struct uncompress_stream {
+	enum filetype type;
+	const struct uncompress_stream_ops *ops;
+	void *priv;
+
+	/* input not yet consumed by the decompressor */
+	const u8 *in;
+	size_t in_len;
+	/* end of input has been signalled */
+	bool eof;
+	/* end of compressed data reached */
+	bool done;
+
+	/* to detect the filetype */
+	u8 hdr[32];
+	size_t hdr_len;
+	const u8 *next_in;
+	size_t next_len;
+
+	/* reports errors, pr_err() is used when NULL */
+	void (*error_fn)(char *x);
+};
+
+void uncompress_stream_error(struct uncompress_stream *us, const char *fmt, ...)
+	__attribute__ ((format(__printf__, 2, 3)));
+
+bool uncompress_stream_collect(struct uncompress_stream *us, void *buf,
+			       size_t *collected, size_t size);
+
+extern const struct uncompress_stream_ops gunzip_stream_ops;
+extern const struct uncompress_stream_ops bunzip2_stream_ops;
+extern const struct uncompress_stream_ops unlzo_stream_ops;
+extern const struct uncompress_stream_ops unlz4_stream_ops;
+extern const struct uncompress_stream_ops unxz_stream_ops;
+extern const struct uncompress_stream_ops unzstd_stream_ops;
+
 #endif /* __UNCOMPRESS_H */
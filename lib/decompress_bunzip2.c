@@ -739,6 +739,118 @@ exit_0:
 	return i;
 }
 
+#ifndef PREBOOT
+#include <uncompress.h>
+
+struct bunzip2_stream {
+	struct bunzip_data *bd;
+	u8 *inbuf;
+	size_t in_len;
+	size_t in_size;
+};
+
+static int bunzip2_stream_init(struct uncompress_stream *us)
+{
+	us->priv = xzalloc(sizeof(struct bunzip2_stream));
+
+	return 0;
+}
+
+/*
+ * The decoder cannot be suspended when it runs out of input in the middle
+ * of a block, so the input is collected completely before decoding it. The
+ * output is still produced piecewise.
+ */
+static int bunzip2_stream_collect(struct uncompress_stream *us,
+				  struct bunzip2_stream *bz)
+{
+	if (bz->in_len + us->in_len > bz->in_size) {
+		size_t size = max(bz->in_size * 2, bz->in_len + us->in_len);
+		u8 *inbuf = realloc(bz->inbuf, size);
+
+		if (!inbuf)
+			return -ENOMEM;
+
+		bz->inbuf = inbuf;
+		bz->in_size = size;
+	}
+
+	memcpy(bz->inbuf + bz->in_len, us->in, us->in_len);
+	bz->in_len += us->in_len;
+	us->in_len = 0;
+
+	return 0;
+}
+
+static ssize_t bunzip2_stream_drain(struct uncompress_stream *us, void *buf,
+				    size_t len)
+{
+	struct bunzip2_stream *bz = us->priv;
+	int ret;
+
+	if (!bz->bd) {
+		ret = bunzip2_stream_collect(us, bz);
+		if (ret)
+			return ret;
+
+		if (!us->eof)
+			return 0;
+
+		ret = start_bunzip(&bz->bd, bz->inbuf, bz->in_len, NULL);
+		if (ret == RETVAL_OUT_OF_MEMORY)
+			return -ENOMEM;
+		if (ret) {
+			uncompress_stream_error(us, "bunzip2: invalid header");
+			return -EINVAL;
+		}
+	}
+
+	/* may return 0 once at the end of the last block */
+	do {
+		ret = read_bunzip(bz->bd, buf, min_t(size_t, len, INT_MAX));
+	} while (!ret);
+
+	if (ret > 0)
+		return ret;
+
+	if (ret == RETVAL_OUT_OF_MEMORY)
+		return -ENOMEM;
+
+	if (ret != RETVAL_LAST_BLOCK) {
+		uncompress_stream_error(us, "bunzip2: uncompression error %d",
+					ret);
+		return -EINVAL;
+	}
+
+	if (bz->bd->headerCRC != bz->bd->totalCRC) {
+		uncompress_stream_error(us,
+			"bunzip2: Data integrity error when decompressing.");
+		return -EINVAL;
+	}
+
+	us->done = true;
+
+	return 0;
+}
+
+static void bunzip2_stream_free(struct uncompress_stream *us)
+{
+	struct bunzip2_stream *bz = us->priv;
+
+	if (bz->bd)
+		free(bz->bd->dbuf);
+	free(bz->bd);
+	free(bz->inbuf);
+	free(bz);
+}
+
+const struct uncompress_stream_ops bunzip2_stream_ops = {
+	.init = bunzip2_stream_init,
+	.drain = bunzip2_stream_drain,
+	.free = bunzip2_stream_free,
+};
+#endif /* PREBOOT */
+
 #ifdef PREBOOT
 STATIC int INIT decompress(unsigned char *buf, int len,
 			int(*fill)(void*, unsigned int),
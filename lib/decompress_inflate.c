@@ -225,4 +225,164 @@ out:
 	return ret;
 }
 
+#ifndef STATIC
+#include <uncompress.h>
+
+/* optional fields of the gzip header */
+#define GZIP_FHCRC	0x02
+#define GZIP_FEXTRA	0x04
+#define GZIP_FNAME	0x08
+#define GZIP_FCOMMENT	0x10
+
+enum gunzip_stream_state {
+	GUNZIP_HEADER,
+	GUNZIP_XLEN,
+	GUNZIP_EXTRA,
+	GUNZIP_NAME,
+	GUNZIP_COMMENT,
+	GUNZIP_HCRC,
+	GUNZIP_DATA,
+};
+
+static const u8 gunzip_field_flag[] = {
+	[GUNZIP_XLEN] = GZIP_FEXTRA,
+	[GUNZIP_EXTRA] = GZIP_FEXTRA,
+	[GUNZIP_NAME] = GZIP_FNAME,
+	[GUNZIP_COMMENT] = GZIP_FCOMMENT,
+	[GUNZIP_HCRC] = GZIP_FHCRC,
+};
+
+struct gunzip_stream {
+	struct z_stream_s strm;
+	enum gunzip_stream_state state;
+	u8 flags;
+	unsigned int pos;	/* position in the current header field */
+	unsigned int xlen;
+};
+
+/* advance to the next header field present in the stream */
+static void gunzip_stream_next_field(struct gunzip_stream *gz)
+{
+	gz->pos = 0;
+
+	do {
+		gz->state++;
+	} while (gz->state != GUNZIP_DATA &&
+		 !(gz->flags & gunzip_field_flag[gz->state]));
+
+	if (gz->state == GUNZIP_EXTRA && !gz->xlen)
+		gunzip_stream_next_field(gz);
+}
+
+/* The header may be split over several pieces of input, parse bytewise */
+static void gunzip_stream_header(struct uncompress_stream *us,
+				 struct gunzip_stream *gz)
+{
+	while (gz->state != GUNZIP_DATA && us->in_len) {
+		u8 c = *us->in++;
+
+		us->in_len--;
+
+		switch (gz->state) {
+		case GUNZIP_HEADER:
+			/* magic and method have been checked by the caller */
+			if (gz->pos == 3)
+				gz->flags = c;
+			if (++gz->pos == 10)
+				gunzip_stream_next_field(gz);
+			break;
+		case GUNZIP_XLEN:
+			gz->xlen |= c << (8 * gz->pos);
+			if (++gz->pos == 2)
+				gunzip_stream_next_field(gz);
+			break;
+		case GUNZIP_EXTRA:
+			if (++gz->pos == gz->xlen)
+				gunzip_stream_next_field(gz);
+			break;
+		case GUNZIP_NAME:
+		case GUNZIP_COMMENT:
+			if (!c)
+				gunzip_stream_next_field(gz);
+			break;
+		case GUNZIP_HCRC:
+			if (++gz->pos == 2)
+				gunzip_stream_next_field(gz);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static int gunzip_stream_init(struct uncompress_stream *us)
+{
+	struct gunzip_stream *gz;
+
+	gz = xzalloc(sizeof(*gz));
+
+	gz->strm.workspace = malloc(zlib_inflate_workspacesize());
+	if (!gz->strm.workspace) {
+		free(gz);
+		return -ENOMEM;
+	}
+
+	zlib_inflateInit2(&gz->strm, -MAX_WBITS);
+
+	us->priv = gz;
+
+	return 0;
+}
+
+static ssize_t gunzip_stream_drain(struct uncompress_stream *us, void *buf,
+				   size_t len)
+{
+	struct gunzip_stream *gz = us->priv;
+	struct z_stream_s *strm = &gz->strm;
+	int rc;
+
+	if (gz->state != GUNZIP_DATA) {
+		gunzip_stream_header(us, gz);
+		if (gz->state != GUNZIP_DATA)
+			return 0;
+	}
+
+	strm->next_in = us->in;
+	strm->avail_in = us->in_len;
+	strm->next_out = buf;
+	strm->avail_out = min_t(size_t, len, UINT_MAX);
+
+	rc = zlib_inflate(strm, 0);
+
+	us->in = strm->next_in;
+	us->in_len = strm->avail_in;
+
+	if (rc == Z_STREAM_END) {
+		us->done = true;
+	} else if (rc == Z_MEM_ERROR) {
+		return -ENOMEM;
+	} else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+		uncompress_stream_error(us, "gunzip: uncompression error %d", rc);
+		return -EINVAL;
+	}
+
+	return strm->next_out - (u8 *)buf;
+}
+
+static void gunzip_stream_free(struct uncompress_stream *us)
+{
+	struct gunzip_stream *gz = us->priv;
+
+	zlib_inflateEnd(&gz->strm);
+	free(gz->strm.workspace);
+	free(gz);
+}
+
+const struct uncompress_stream_ops gunzip_stream_ops = {
+	.init = gunzip_stream_init,
+	.drain = gunzip_stream_drain,
+	.free = gunzip_stream_free,
+};
+#endif /* STATIC */
+
 #define decompress gunzip
@@ -191,4 +191,158 @@ STATIC int decompress_unlz4(unsigned char *buf, int in_len,
 {
 	return unlz4(buf, in_len - 4, fill, flush, output, posp, error);
 }
+
+#ifndef PREBOOT
+#include <common.h>
+#include <uncompress.h>
+
+enum unlz4_stream_state {
+	UNLZ4_SIZE,
+	UNLZ4_DATA,
+	UNLZ4_OUT,
+};
+
+struct unlz4_stream {
+	enum unlz4_stream_state state;
+	u8 size[4];
+	size_t chunksize;
+	size_t collected;
+	u8 *inp;
+	u8 *outp;
+	size_t out_pos;
+	size_t out_len;
+};
+
+static int unlz4_stream_init(struct uncompress_stream *us)
+{
+	struct unlz4_stream *lz4;
+
+	lz4 = xzalloc(sizeof(*lz4));
+	lz4->inp = malloc(lz4_compressbound(LZ4_DEFAULT_UNCOMPRESSED_CHUNK_SIZE));
+	lz4->outp = malloc(LZ4_DEFAULT_UNCOMPRESSED_CHUNK_SIZE);
+
+	if (!lz4->inp || !lz4->outp) {
+		free(lz4->inp);
+		free(lz4->outp);
+		free(lz4);
+		return -ENOMEM;
+	}
+
+	us->priv = lz4;
+
+	return 0;
+}
+
+/* decompress a chunk, directly to the output buffer if it is large enough */
+static ssize_t unlz4_stream_chunk(struct uncompress_stream *us,
+				  const u8 *inp, void *buf, size_t len)
+{
+	struct unlz4_stream *lz4 = us->priv;
+	size_t dest_len = LZ4_DEFAULT_UNCOMPRESSED_CHUNK_SIZE;
+	bool direct = len >= dest_len;
+	int ret;
+
+	ret = lz4_decompress_unknownoutputsize(inp, lz4->chunksize,
+					       direct ? buf : lz4->outp,
+					       &dest_len);
+	if (ret < 0) {
+		uncompress_stream_error(us, "unlz4: Decoding failed");
+		return -EINVAL;
+	}
+
+	lz4->state = UNLZ4_SIZE;
+	lz4->collected = 0;
+
+	if (direct)
+		return dest_len;
+
+	lz4->out_pos = 0;
+	lz4->out_len = dest_len;
+	lz4->state = UNLZ4_OUT;
+
+	return 0;
+}
+
+static ssize_t unlz4_stream_drain(struct uncompress_stream *us, void *buf,
+				  size_t len)
+{
+	struct unlz4_stream *lz4 = us->priv;
+	ssize_t now;
+
+	while (1) {
+		switch (lz4->state) {
+		case UNLZ4_OUT:
+			now = min(len, lz4->out_len - lz4->out_pos);
+			memcpy(buf, lz4->outp + lz4->out_pos, now);
+			lz4->out_pos += now;
+			if (lz4->out_pos == lz4->out_len)
+				lz4->state = UNLZ4_SIZE;
+			if (now)
+				return now;
+			break;
+
+		case UNLZ4_SIZE:
+			/* the legacy format has no end marker */
+			if (us->eof && !us->in_len && !lz4->collected) {
+				us->done = true;
+				return 0;
+			}
+
+			if (!uncompress_stream_collect(us, lz4->size,
+						       &lz4->collected, 4))
+				return 0;
+
+			lz4->collected = 0;
+			lz4->chunksize = get_unaligned_le32(lz4->size);
+			if (lz4->chunksize == ARCHIVE_MAGICNUMBER)
+				break;
+
+			if (lz4->chunksize > lz4_compressbound(LZ4_DEFAULT_UNCOMPRESSED_CHUNK_SIZE)) {
+				uncompress_stream_error(us,
+					"unlz4: chunk length is longer than allocated");
+				return -EINVAL;
+			}
+
+			lz4->state = UNLZ4_DATA;
+			break;
+
+		case UNLZ4_DATA:
+			/* use the input directly when the chunk is contained */
+			if (!lz4->collected && us->in_len >= lz4->chunksize) {
+				const u8 *inp = us->in;
+
+				us->in += lz4->chunksize;
+				us->in_len -= lz4->chunksize;
+				now = unlz4_stream_chunk(us, inp, buf, len);
+			} else {
+				if (!uncompress_stream_collect(us, lz4->inp,
+							       &lz4->collected,
+							       lz4->chunksize))
+					return 0;
+				now = unlz4_stream_chunk(us, lz4->inp, buf, len);
+			}
+
+			if (now)
+				return now;
+			break;
+		}
+	}
+}
+
+static void unlz4_stream_free(struct uncompress_stream *us)
+{
+	struct unlz4_stream *lz4 = us->priv;
+
+	free(lz4->inp);
+	free(lz4->outp);
+	free(lz4);
+}
+
+const struct uncompress_stream_ops unlz4_stream_ops = {
+	.init = unlz4_stream_init,
+	.drain = unlz4_stream_drain,
+	.free = unlz4_stream_free,
+};
+#endif /* PREBOOT */
+
 #define decompress decompress_unlz4
@@ -32,6 +32,7 @@
 #include <xfuncs.h>
 
 #ifdef STATIC
+#define PREBOOT
 #include <linux/decompress/mm.h>
 #include "lzo/lzo1x_decompress_safe.c"
 #else
@@ -287,4 +288,213 @@ exit_1:
 exit:
 	return ret;
 }
+#ifndef PREBOOT
+#include <uncompress.h>
+
+enum unlzo_stream_state {
+	UNLZO_HEADER,
+	UNLZO_DST_LEN,
+	UNLZO_SRC_LEN,
+	UNLZO_DATA,
+	UNLZO_OUT,
+};
+
+struct unlzo_stream {
+	enum unlzo_stream_state state;
+	u8 header[HEADER_SIZE_MAX];
+	u32 dst_len;
+	u32 src_len;
+	size_t collected;
+	u8 *in_buf;
+	u8 *out_buf;
+	size_t out_pos;
+};
+
+static int unlzo_stream_init(struct uncompress_stream *us)
+{
+	struct unlzo_stream *lzo;
+
+	lzo = xzalloc(sizeof(*lzo));
+	lzo->in_buf = malloc(lzo1x_worst_compress(LZO_BLOCK_SIZE));
+	lzo->out_buf = malloc(LZO_BLOCK_SIZE);
+
+	if (!lzo->in_buf || !lzo->out_buf) {
+		free(lzo->in_buf);
+		free(lzo->out_buf);
+		free(lzo);
+		return -ENOMEM;
+	}
+
+	us->priv = lzo;
+
+	return 0;
+}
+
+/*
+ * The header has a variable size, collect it bytewise until parse_header()
+ * is satisfied.
+ */
+static int unlzo_stream_header(struct uncompress_stream *us,
+			       struct unlzo_stream *lzo)
+{
+	int skip;
+
+	while (us->in_len) {
+		if (lzo->collected == HEADER_SIZE_MAX) {
+			uncompress_stream_error(us, "unlzo: invalid header");
+			return -EINVAL;
+		}
+
+		lzo->header[lzo->collected++] = *us->in++;
+		us->in_len--;
+
+		if (parse_header(lzo->header, &skip, lzo->collected)) {
+			lzo->collected = 0;
+			lzo->state = UNLZO_DST_LEN;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/* decompress a block, directly to the output buffer if it is large enough */
+static ssize_t unlzo_stream_block(struct uncompress_stream *us,
+				  const u8 *in_buf, void *buf, size_t len)
+{
+	struct unlzo_stream *lzo = us->priv;
+	bool direct = len >= lzo->dst_len;
+	u8 *out_buf = direct ? buf : lzo->out_buf;
+	size_t tmp = lzo->dst_len;
+	int r;
+
+	/* uncompressed blocks are stored as is */
+	if (lzo->dst_len == lzo->src_len) {
+		memcpy(out_buf, in_buf, lzo->src_len);
+	} else {
+		r = lzo1x_decompress_safe(in_buf, lzo->src_len, out_buf, &tmp);
+		if (r != LZO_E_OK || tmp != lzo->dst_len) {
+			uncompress_stream_error(us, "unlzo: Compressed data violation");
+			return -EINVAL;
+		}
+	}
+
+	lzo->collected = 0;
+
+	if (direct) {
+		lzo->state = UNLZO_DST_LEN;
+		return lzo->dst_len;
+	}
+
+	lzo->out_pos = 0;
+	lzo->state = UNLZO_OUT;
+
+	return 0;
+}
+
+static ssize_t unlzo_stream_drain(struct uncompress_stream *us, void *buf,
+				  size_t len)
+{
+	struct unlzo_stream *lzo = us->priv;
+	ssize_t now;
+	int ret;
+
+	while (1) {
+		switch (lzo->state) {
+		case UNLZO_HEADER:
+			ret = unlzo_stream_header(us, lzo);
+			if (ret)
+				return ret;
+			if (lzo->state == UNLZO_HEADER)
+				return 0;
+			break;
+
+		case UNLZO_DST_LEN:
+			if (!uncompress_stream_collect(us, lzo->header,
+						       &lzo->collected, 4))
+				return 0;
+
+			lzo->collected = 0;
+			lzo->dst_len = get_unaligned_be32(lzo->header);
+
+			/* exit if last block */
+			if (!lzo->dst_len) {
+				us->done = true;
+				return 0;
+			}
+
+			if (lzo->dst_len > LZO_BLOCK_SIZE) {
+				uncompress_stream_error(us,
+					"unlzo: dest len longer than block size");
+				return -EINVAL;
+			}
+
+			lzo->state = UNLZO_SRC_LEN;
+			break;
+
+		case UNLZO_SRC_LEN:
+			/* compressed block size and block checksum */
+			if (!uncompress_stream_collect(us, lzo->header,
+						       &lzo->collected, 8))
+				return 0;
+
+			lzo->collected = 0;
+			lzo->src_len = get_unaligned_be32(lzo->header);
+
+			if (!lzo->src_len || lzo->src_len > lzo->dst_len) {
+				uncompress_stream_error(us, "unlzo: file corrupted");
+				return -EINVAL;
+			}
+
+			lzo->state = UNLZO_DATA;
+			break;
+
+		case UNLZO_DATA:
+			/* use the input directly when the block is contained */
+			if (!lzo->collected && us->in_len >= lzo->src_len) {
+				const u8 *in_buf = us->in;
+
+				us->in += lzo->src_len;
+				us->in_len -= lzo->src_len;
+				now = unlzo_stream_block(us, in_buf, buf, len);
+			} else {
+				if (!uncompress_stream_collect(us, lzo->in_buf,
+							       &lzo->collected,
+							       lzo->src_len))
+					return 0;
+				now = unlzo_stream_block(us, lzo->in_buf, buf,
+							 len);
+			}
+
+			if (now)
+				return now;
+			break;
+
+		case UNLZO_OUT:
+			now = min_t(size_t, len, lzo->dst_len - lzo->out_pos);
+			memcpy(buf, lzo->out_buf + lzo->out_pos, now);
+			lzo->out_pos += now;
+			if (lzo->out_pos == lzo->dst_len)
+				lzo->state = UNLZO_DST_LEN;
+			return now;
+		}
+	}
+}
+
+static void unlzo_stream_free(struct uncompress_stream *us)
+{
+	struct unlzo_stream *lzo = us->priv;
+
+	free(lzo->in_buf);
+	free(lzo->out_buf);
+	free(lzo);
+}
+
+const struct uncompress_stream_ops unlzo_stream_ops = {
+	.init = unlzo_stream_init,
+	.drain = unlzo_stream_drain,
+	.free = unlzo_stream_free,
+};
+#endif /* PREBOOT */
+
 #define decompress decompress_unlzo
@@ -371,6 +371,89 @@ error_alloc_state:
 	return -1;
 }
 
+#ifndef XZ_PREBOOT
+#include <common.h>
+#include <uncompress.h>
+
+struct unxz_stream {
+	struct xz_dec *s;
+	struct xz_buf b;
+};
+
+static int unxz_stream_init(struct uncompress_stream *us)
+{
+	struct unxz_stream *xz;
+
+#if XZ_INTERNAL_CRC32
+	xz_crc32_init();
+#endif
+
+	xz = xzalloc(sizeof(*xz));
+
+	xz->s = xz_dec_init(XZ_DYNALLOC, (uint32_t)-1);
+	if (!xz->s) {
+		free(xz);
+		return -ENOMEM;
+	}
+
+	us->priv = xz;
+
+	return 0;
+}
+
+static ssize_t unxz_stream_drain(struct uncompress_stream *us, void *buf,
+				 size_t len)
+{
+	struct unxz_stream *xz = us->priv;
+	struct xz_buf *b = &xz->b;
+	enum xz_ret ret;
+
+	b->in = us->in;
+	b->in_pos = 0;
+	b->in_size = us->in_len;
+	b->out = buf;
+	b->out_pos = 0;
+	b->out_size = len;
+
+	ret = xz_dec_run(xz->s, b);
+
+	us->in += b->in_pos;
+	us->in_len -= b->in_pos;
+
+	switch (ret) {
+	case XZ_STREAM_END:
+		us->done = true;
+		break;
+	case XZ_OK:
+	case XZ_BUF_ERROR:
+		/* no progress possible without more input */
+		break;
+	case XZ_MEM_ERROR:
+		return -ENOMEM;
+	default:
+		uncompress_stream_error(us,
+			"unxz: XZ-compressed data is corrupt or unsupported");
+		return -EINVAL;
+	}
+
+	return b->out_pos;
+}
+
+static void unxz_stream_free(struct uncompress_stream *us)
+{
+	struct unxz_stream *xz = us->priv;
+
+	xz_dec_end(xz->s);
+	free(xz);
+}
+
+const struct uncompress_stream_ops unxz_stream_ops = {
+	.init = unxz_stream_init,
+	.drain = unxz_stream_drain,
+	.free = unxz_stream_free,
+};
+#endif /* XZ_PREBOOT */
+
 /*
  * This macro is used by architecture-specific files to decompress
  * the kernel image.
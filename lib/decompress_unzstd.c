@@ -0,0 +1,103 @@
+/*
+ * decompress_unzstd.c - zstd support for the uncompress stream interface
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#define pr_fmt(fmt) "unzstd: " fmt
+
+#include <common.h>
+#include <malloc.h>
+#include <uncompress.h>
+#include <linux/zstd.h>
+
+struct unzstd_stream {
+	void *workspace;
+	ZSTD_DStream *zds;
+};
+
+static int unzstd_stream_init(struct uncompress_stream *us)
+{
+	struct unzstd_stream *zstd;
+	ZSTD_frameParams params;
+	size_t size;
+
+	/* the frame header is contained in the bytes used for detection */
+	if (ZSTD_getFrameParams(&params, us->in, us->in_len) ||
+	    !params.windowSize) {
+		uncompress_stream_error(us, "unzstd: invalid or unsupported frame header");
+		return -EINVAL;
+	}
+
+	zstd = xzalloc(sizeof(*zstd));
+
+	size = ZSTD_DStreamWorkspaceBound(params.windowSize);
+	zstd->workspace = malloc(size);
+	if (!zstd->workspace) {
+		free(zstd);
+		return -ENOMEM;
+	}
+
+	zstd->zds = ZSTD_initDStream(params.windowSize, zstd->workspace, size);
+	if (!zstd->zds) {
+		free(zstd->workspace);
+		free(zstd);
+		return -EINVAL;
+	}
+
+	us->priv = zstd;
+
+	return 0;
+}
+
+static ssize_t unzstd_stream_drain(struct uncompress_stream *us, void *buf,
+				   size_t len)
+{
+	struct unzstd_stream *zstd = us->priv;
+	ZSTD_inBuffer in = {
+		.src = us->in,
+		.size = us->in_len,
+	};
+	ZSTD_outBuffer out = {
+		.dst = buf,
+		.size = len,
+	};
+	size_t ret;
+
+	ret = ZSTD_decompressStream(zstd->zds, &out, &in);
+
+	us->in += in.pos;
+	us->in_len -= in.pos;
+
+	if (ZSTD_isError(ret)) {
+		uncompress_stream_error(us, "unzstd: uncompression error %d",
+					ZSTD_getErrorCode(ret));
+		return -EINVAL;
+	}
+
+	/* 0 means the frame is completely decoded and flushed */
+	if (!ret)
+		us->done = true;
+
+	return out.pos;
+}
+
+static void unzstd_stream_free(struct uncompress_stream *us)
+{
+	struct unzstd_stream *zstd = us->priv;
+
+	free(zstd->workspace);
+	free(zstd);
+}
+
+const struct uncompress_stream_ops unzstd_stream_ops = {
+	.init = unzstd_stream_init,
+	.drain = unzstd_stream_drain,
+	.free = unzstd_stream_free,
+};
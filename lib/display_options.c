@@ -18,6 +18,8 @@
  */
 
 #include <common.h>
+#include <clock.h>
+#include <asm-generic/div64.h>
 
 /*
  * return a pointer to a string containing the size
@@ -69,3 +71,36 @@ char *size_human_readable(unsigned long long size)
 	return buf;
 }
 EXPORT_SYMBOL(size_human_readable);
+
+/*
+ * return a pointer to a string containing the rate of @bytes transferred
+ * in @ns nanoseconds as "xxx.yy MiB/s"
+ */
+char *rate_human_readable(unsigned long long bytes, unsigned long long ns)
+{
+	static char buf[32];
+	unsigned long long rate;
+	unsigned int frac;
+	int shift = 20;
+
+	/* in 1/100 MiB/s, drop low bits of @bytes to avoid an overflow */
+	while (bytes > ULLONG_MAX / (100 * SECOND)) {
+		bytes >>= 1;
+		shift--;
+	}
+
+	rate = bytes * 100 * SECOND;
+	do_div(rate, max(ns, 1ULL));
+
+	if (shift > 0)
+		rate >>= shift;
+	else
+		rate <<= -shift;
+
+	frac = do_div(rate, 100);
+
+	sprintf(buf, "%llu.%02u MiB/s", rate, frac);
+
+	return buf;
+}
+EXPORT_SYMBOL(rate_human_readable);
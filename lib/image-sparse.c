@@ -46,9 +46,22 @@
 
 #include <linux/math64.h>
 
-#ifndef CONFIG_FASTBOOT_FLASH_FILLBUF_SIZE
-#define CONFIG_FASTBOOT_FLASH_FILLBUF_SIZE (1024 * 512)
-#endif
+/*
+ * Size of the buffer used by the writer to collect RAW data and to
+ * materialize FILL chunks, this is the maximum size passed to a single
+ * write callback unless the data is passed through without copying.
+ */
+#define SPARSE_BUF_SIZE		SZ_1M
+
+enum sparse_stream_state {
+	SPARSE_STREAM_HEADER,
+	SPARSE_STREAM_CHUNK_HEADER,
+	SPARSE_STREAM_FILL_VAL,
+	SPARSE_STREAM_RAW,
+	SPARSE_STREAM_SKIP,
+	SPARSE_STREAM_CHUNK,		/* chunk header complete */
+	SPARSE_STREAM_DONE,
+};
 
 struct sparse_image_ctx {
 	int fd;
@@ -58,6 +71,21 @@ struct sparse_image_ctx {
 	loff_t pos;
 	size_t remaining;
 	uint32_t fill_val;
+
+	/* for sparse_image_write() and sparse_image_stream_*() */
+	sparse_image_write_fn write;
+	sparse_image_fill_fn fill;
+	void *priv;
+	void *buf;
+	loff_t buf_pos;
+	size_t buf_len;
+
+	/* for images pushed with sparse_image_stream_feed() */
+	enum sparse_stream_state state;
+	enum sparse_stream_state next_state;
+	void *collect;
+	size_t collected;
+	size_t skip;
 };
 
 int sparse_seek(struct sparse_image_ctx *si)
@@ -130,7 +158,7 @@ again:
 		if (payload != sizeof(uint32_t))
 			return -EINVAL;
 
-		offs = lseek(si->fd, chunk_data_sz, SEEK_CUR);
+		offs = lseek(si->fd, payload, SEEK_CUR);
 		if (offs == -1)
 			return -EINVAL;
 		goto again;
@@ -244,6 +272,462 @@ int sparse_image_read(struct sparse_image_ctx *si, void *buf, loff_t *pos,
 
 void sparse_image_close(struct sparse_image_ctx *si)
 {
-	close(si->fd);
+	if (si->fd >= 0)
+		close(si->fd);
+	free(si->buf);
 	free(si);
 }
+
+/* Write out the RAW data collected in si->buf */
+static int sparse_flush(struct sparse_image_ctx *si)
+{
+	size_t len = si->buf_len;
+
+	if (!len)
+		return 0;
+
+	si->buf_len = 0;
+
+	return si->write(si->priv, si->buf_pos, si->buf, len);
+}
+
+/*
+ * Prepare si->buf to take RAW data for si->pos. Data for consecutive
+ * positions is collected, also over chunk boundaries, so that the backend
+ * sees writes as large as possible. A gap, i.e. a "don't care" chunk in
+ * between, flushes the buffer.
+ */
+static int sparse_buf_prepare(struct sparse_image_ctx *si)
+{
+	int ret;
+
+	if (si->buf_len && si->buf_pos + si->buf_len != si->pos) {
+		ret = sparse_flush(si);
+		if (ret)
+			return ret;
+	}
+
+	if (!si->buf_len)
+		si->buf_pos = si->pos;
+
+	return 0;
+}
+
+/* Account @len bytes of RAW data which have been put into si->buf */
+static int sparse_buf_commit(struct sparse_image_ctx *si, size_t len)
+{
+	si->buf_len += len;
+	si->pos += len;
+	si->remaining -= len;
+
+	if (si->buf_len == SPARSE_BUF_SIZE)
+		return sparse_flush(si);
+
+	return 0;
+}
+
+/*
+ * Write the FILL chunk at si->pos. The fill callback gets the chance to
+ * do this without transferring data, e.g. by erasing the region. If there
+ * is no fill callback or it cannot handle the region the data is
+ * materialized and passed to the write callback.
+ */
+static int sparse_write_fill(struct sparse_image_ctx *si)
+{
+	uint32_t *buf32 = si->buf;
+	size_t size;
+	int i, ret;
+
+	ret = sparse_flush(si);
+	if (ret)
+		return ret;
+
+	if (si->fill) {
+		ret = si->fill(si->priv, si->pos, si->remaining,
+			       le32_to_cpu(si->fill_val));
+		if (!ret) {
+			si->pos += si->remaining;
+			si->remaining = 0;
+			return 0;
+		}
+
+		if (ret != -EOPNOTSUPP)
+			return ret;
+	}
+
+	size = min_t(size_t, si->remaining, SPARSE_BUF_SIZE);
+
+	for (i = 0; i < size / sizeof(uint32_t); i++)
+		buf32[i] = si->fill_val;
+
+	while (si->remaining) {
+		size_t now = min_t(size_t, si->remaining, size);
+
+		ret = si->write(si->priv, si->pos, si->buf, now);
+		if (ret)
+			return ret;
+
+		si->pos += now;
+		si->remaining -= now;
+	}
+
+	return 0;
+}
+
+/* Read the RAW chunk at si->pos from the image file */
+static int sparse_read_raw(struct sparse_image_ctx *si)
+{
+	size_t now;
+	int ret;
+
+	while (si->remaining) {
+		ret = sparse_buf_prepare(si);
+		if (ret)
+			return ret;
+
+		now = min_t(size_t, si->remaining,
+			    SPARSE_BUF_SIZE - si->buf_len);
+
+		ret = read_full(si->fd, si->buf + si->buf_len, now);
+		if (ret < 0)
+			return ret;
+		if (ret < now)
+			return -EINVAL;
+
+		ret = sparse_buf_commit(si, now);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * sparse_image_write - write a sparse image to its destination
+ * @si: The context from sparse_image_open()
+ * @write: Called for the data of the unsparsed image
+ * @fill: Called for "fill" chunks, may be NULL
+ * @priv: Passed to @write and @fill
+ *
+ * Other than sparse_image_read() this does not materialize the whole
+ * image. "don't care" chunks are skipped without calling anything, the
+ * data of consecutive "raw" chunks is collected and passed to @write in
+ * pieces as large as possible. "fill" chunks are passed to @fill which
+ * may handle them without writing data, e.g. by erasing the region when
+ * the fill value matches the erased state of the device. When @fill
+ * returns -EOPNOTSUPP the fill data is generated and passed to @write.
+ *
+ * Do not mix with sparse_image_read() on the same context.
+ *
+ * Return: 0 for success, a negative error code for invalid images or the
+ * error returned from the callbacks.
+ */
+int sparse_image_write(struct sparse_image_ctx *si, sparse_image_write_fn write,
+		       sparse_image_fill_fn fill, void *priv)
+{
+	int ret;
+
+	si->write = write;
+	si->fill = fill;
+	si->priv = priv;
+
+	if (!si->buf)
+		si->buf = xmalloc(SPARSE_BUF_SIZE);
+
+	while (1) {
+		if (!si->remaining) {
+			ret = sparse_seek(si);
+			if (ret < 0)
+				return ret;
+			if (!ret)
+				break;
+		}
+
+		switch (si->chunk.chunk_type) {
+		case CHUNK_TYPE_RAW:
+			ret = sparse_read_raw(si);
+			break;
+		case CHUNK_TYPE_FILL:
+			ret = sparse_write_fill(si);
+			break;
+		default:
+			ret = -EINVAL;
+			break;
+		}
+
+		if (ret)
+			return ret;
+	}
+
+	return sparse_flush(si);
+}
+
+/**
+ * sparse_image_stream_open - parse a sparse image pushed in pieces
+ * @write: Called for the data of the unsparsed image
+ * @fill: Called for "fill" chunks, may be NULL
+ * @priv: Passed to @write and @fill
+ *
+ * This is for sparse images which are not available as a file, but arrive
+ * piece by piece, e.g. from USB. The pieces are passed to
+ * sparse_image_stream_feed() which calls the callbacks as described for
+ * sparse_image_write(). The data of "raw" chunks is collected, so the last
+ * of it may only be written in sparse_image_stream_finish(). The callbacks
+ * are called in ascending order of the position, the image size is
+ * available from sparse_image_size() when they are called the first time.
+ *
+ * Return: The context for the other sparse_image_stream_* functions, free
+ * with sparse_image_close().
+ */
+struct sparse_image_ctx *sparse_image_stream_open(sparse_image_write_fn write,
+						  sparse_image_fill_fn fill,
+						  void *priv)
+{
+	struct sparse_image_ctx *si;
+
+	si = xzalloc(sizeof(*si));
+
+	si->fd = -1;
+	si->write = write;
+	si->fill = fill;
+	si->priv = priv;
+	si->buf = xmalloc(SPARSE_BUF_SIZE);
+	si->state = SPARSE_STREAM_HEADER;
+	si->collect = &si->sparse;
+
+	return si;
+}
+
+static void sparse_stream_next_chunk(struct sparse_image_ctx *si)
+{
+	if (si->processed_chunks == si->sparse.total_chunks) {
+		si->state = SPARSE_STREAM_DONE;
+		return;
+	}
+
+	si->state = SPARSE_STREAM_CHUNK_HEADER;
+	si->collect = &si->chunk;
+	si->collected = 0;
+}
+
+static void sparse_stream_skip(struct sparse_image_ctx *si, size_t skip,
+			       enum sparse_stream_state next)
+{
+	si->skip = skip;
+	si->state = SPARSE_STREAM_SKIP;
+	si->next_state = next;
+}
+
+/* called when the header of a chunk is complete */
+static int sparse_stream_chunk(struct sparse_image_ctx *si)
+{
+	unsigned int chunk_data_sz, payload;
+
+	chunk_data_sz = si->sparse.blk_sz * si->chunk.chunk_sz;
+	payload = si->chunk.total_sz - si->sparse.chunk_hdr_sz;
+
+	si->processed_chunks++;
+
+	switch (si->chunk.chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (payload != chunk_data_sz)
+			return -EINVAL;
+
+		si->remaining = payload;
+		si->state = SPARSE_STREAM_RAW;
+
+		if (!payload)
+			sparse_stream_next_chunk(si);
+
+		break;
+
+	case CHUNK_TYPE_FILL:
+		if (payload != sizeof(uint32_t))
+			return -EINVAL;
+
+		si->remaining = chunk_data_sz;
+		si->state = SPARSE_STREAM_FILL_VAL;
+		si->collect = &si->fill_val;
+		si->collected = 0;
+
+		break;
+
+	case CHUNK_TYPE_DONT_CARE:
+		si->pos += chunk_data_sz;
+		sparse_stream_next_chunk(si);
+
+		break;
+
+	case CHUNK_TYPE_CRC32:
+		if (payload != sizeof(uint32_t))
+			return -EINVAL;
+
+		sparse_stream_skip(si, payload, SPARSE_STREAM_CHUNK_HEADER);
+
+		break;
+
+	default:
+		pr_err("Unknown chunk type 0x%04x", si->chunk.chunk_type);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int sparse_stream_skip_done(struct sparse_image_ctx *si)
+{
+	if (si->next_state == SPARSE_STREAM_CHUNK)
+		return sparse_stream_chunk(si);
+
+	sparse_stream_next_chunk(si);
+
+	return 0;
+}
+
+/*
+ * Collect a header or the fill value which may be split over several
+ * pieces. Returns the number of bytes consumed from @buf.
+ */
+static size_t sparse_stream_collect(struct sparse_image_ctx *si,
+				    const void *buf, size_t len, size_t size)
+{
+	size_t now = min(len, size - si->collected);
+
+	memcpy(si->collect + si->collected, buf, now);
+	si->collected += now;
+
+	return now;
+}
+
+/**
+ * sparse_image_stream_feed - pass the next piece of a sparse image
+ * @si: The context from sparse_image_stream_open()
+ * @buf: The data
+ * @len: Size of @buf, may be arbitrary
+ *
+ * Return: 0 for success, a negative error code for invalid images or the
+ * error returned from the write callback.
+ */
+int sparse_image_stream_feed(struct sparse_image_ctx *si, const void *buf,
+			     size_t len)
+{
+	size_t now;
+	int ret;
+
+	while (len) {
+		switch (si->state) {
+		case SPARSE_STREAM_HEADER:
+			now = sparse_stream_collect(si, buf, len,
+						    sizeof(struct sparse_header));
+			if (si->collected < sizeof(struct sparse_header))
+				break;
+
+			if (!is_sparse_image(&si->sparse))
+				return -EINVAL;
+
+			sparse_stream_skip(si, si->sparse.file_hdr_sz -
+					   sizeof(struct sparse_header),
+					   SPARSE_STREAM_CHUNK_HEADER);
+			break;
+
+		case SPARSE_STREAM_CHUNK_HEADER:
+			now = sparse_stream_collect(si, buf, len,
+						    sizeof(struct chunk_header));
+			if (si->collected < sizeof(struct chunk_header))
+				break;
+
+			/*
+			 * Skip the remaining bytes in a header that is longer
+			 * than we expected.
+			 */
+			if (si->sparse.chunk_hdr_sz > sizeof(struct chunk_header)) {
+				sparse_stream_skip(si, si->sparse.chunk_hdr_sz -
+						   sizeof(struct chunk_header),
+						   SPARSE_STREAM_CHUNK);
+				break;
+			}
+
+			ret = sparse_stream_chunk(si);
+			if (ret)
+				return ret;
+			break;
+
+		case SPARSE_STREAM_FILL_VAL:
+			now = sparse_stream_collect(si, buf, len,
+						    sizeof(uint32_t));
+			if (si->collected < sizeof(uint32_t))
+				break;
+
+			ret = sparse_write_fill(si);
+			if (ret)
+				return ret;
+
+			sparse_stream_next_chunk(si);
+			break;
+
+		case SPARSE_STREAM_RAW:
+			ret = sparse_buf_prepare(si);
+			if (ret)
+				return ret;
+
+			now = min3(si->remaining, len,
+				   SPARSE_BUF_SIZE - si->buf_len);
+
+			memcpy(si->buf + si->buf_len, buf, now);
+
+			ret = sparse_buf_commit(si, now);
+			if (ret)
+				return ret;
+
+			if (!si->remaining)
+				sparse_stream_next_chunk(si);
+			break;
+
+		case SPARSE_STREAM_SKIP:
+			now = min(si->skip, len);
+			si->skip -= now;
+
+			if (si->skip)
+				break;
+
+			ret = sparse_stream_skip_done(si);
+			if (ret)
+				return ret;
+			break;
+
+		default:
+			/* ignore trailing data */
+			return 0;
+		}
+
+		buf += now;
+		len -= now;
+	}
+
+	/* a skip of zero bytes is done without more data */
+	if (si->state == SPARSE_STREAM_SKIP && !si->skip)
+		return sparse_stream_skip_done(si);
+
+	return 0;
+}
+
+/**
+ * sparse_image_stream_finish - complete a streamed sparse image
+ * @si: The context from sparse_image_stream_open()
+ *
+ * Writes the data still collected and checks if the image is complete.
+ *
+ * Return: 0 when all chunks of the image have been processed and written,
+ * -EINVAL for incomplete images or the error returned from the write
+ * callback.
+ */
+int sparse_image_stream_finish(struct sparse_image_ctx *si)
+{
+	if (si->state != SPARSE_STREAM_DONE) {
+		pr_err("image incomplete, %d of %d chunks processed\n",
+		       si->processed_chunks, si->sparse.total_chunks);
+		return -EINVAL;
+	}
+
+	return sparse_flush(si);
+}
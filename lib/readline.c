@@ -6,6 +6,7 @@
 #include <ratp_bb.h>
 #include <xfuncs.h>
 #include <complete.h>
+#include <driver.h>
 #include <linux/ctype.h>
 
 /*
@@ -202,6 +203,7 @@ int readline(const char *prompt, char *buf, int len)
 	while (1) {
 		while (!tstc()) {
 			poller_call();
+			device_probe_idle();
 			if (IS_ENABLED(CONFIG_CONSOLE_RATP))
 				barebox_ratp_command_run();
 		}
@@ -311,6 +311,7 @@ EXPORT_SYMBOL(strnlen);
 char * strdup(const char *s)
 {
 	char *new;
+	malloc_trace_caller();
 
 	if ((s == NULL)	||
 	    ((new = malloc (strlen(s) + 1)) == NULL) ) {
@@ -328,6 +329,7 @@ char *strndup(const char *s, size_t n)
 {
 	char *new;
 	size_t len = strnlen(s, n);
+	malloc_trace_caller();
 
 	if ((s == NULL) ||
 	    ((new = malloc(len + 1)) == NULL)) {
@@ -559,23 +561,45 @@ void * memmove(void * dest,const void *src,size_t count)
 #endif
 EXPORT_SYMBOL(memmove);
 
-#ifndef __HAVE_ARCH_MEMCMP
 /**
  * memcmp - Compare two areas of memory
  * @cs: One area of memory
  * @ct: Another area of memory
  * @count: The size of the area.
  */
-int memcmp(const void * cs,const void * ct,size_t count)
+int __default_memcmp(const void * cs,const void * ct,size_t count)
 {
-	const unsigned char *su1, *su2;
+	const unsigned char *su1 = cs, *su2 = ct;
 	int res = 0;
 
-	for( su1 = cs, su2 = ct; 0 < count; ++su1, ++su2, count--)
+	/*
+	 * Skip equal words when both areas have the same alignment, the
+	 * first difference is then searched bytewise below.
+	 */
+	if (!(((unsigned long)su1 ^ (unsigned long)su2) & (sizeof(long) - 1))) {
+		for (; count && ((unsigned long)su1 & (sizeof(long) - 1));
+		     ++su1, ++su2, count--)
+			if ((res = *su1 - *su2) != 0)
+				return res;
+
+		while (count >= sizeof(long) &&
+		       *(const unsigned long *)su1 == *(const unsigned long *)su2) {
+			su1 += sizeof(long);
+			su2 += sizeof(long);
+			count -= sizeof(long);
+		}
+	}
+
+	for (; 0 < count; ++su1, ++su2, count--)
 		if ((res = *su1 - *su2) != 0)
 			break;
 	return res;
 }
+EXPORT_SYMBOL(__default_memcmp);
+
+#ifndef __HAVE_ARCH_MEMCMP
+int memcmp(const void *cs, const void *ct, size_t count)
+	__alias(__default_memcmp);
 #endif
 EXPORT_SYMBOL(memcmp);
 
@@ -16,6 +16,8 @@
  * GNU General Public License for more details.
  *
  */
+#define pr_fmt(fmt) "uncompress: " fmt
+
 #include <common.h>
 #include <uncompress.h>
 #include <bunzip2.h>
@@ -27,6 +29,8 @@
 #include <filetype.h>
 #include <malloc.h>
 #include <fs.h>
+#include <libfile.h>
+#include <linux/sizes.h>
 
 static void *uncompress_buf;
 static unsigned int uncompress_size;
@@ -141,36 +145,327 @@ err:
 	return ret;
 }
 
-static int uncompress_infd, uncompress_outfd;
+static const struct uncompress_stream_ops *uncompress_stream_ops(enum filetype ft)
+{
+	switch (ft) {
+#ifdef CONFIG_BZLIB
+	case filetype_bzip2:
+		return &bunzip2_stream_ops;
+#endif
+#ifdef CONFIG_ZLIB
+	case filetype_gzip:
+		return &gunzip_stream_ops;
+#endif
+#ifdef CONFIG_LZO_DECOMPRESS
+	case filetype_lzo_compressed:
+		return &unlzo_stream_ops;
+#endif
+#ifdef CONFIG_LZ4_DECOMPRESS
+	case filetype_lz4_compressed:
+		return &unlz4_stream_ops;
+#endif
+#ifdef CONFIG_XZ_DECOMPRESS
+	case filetype_xz_compressed:
+		return &unxz_stream_ops;
+#endif
+#ifdef CONFIG_ZSTD_DECOMPRESS
+	case filetype_zstd_compressed:
+		return &unzstd_stream_ops;
+#endif
+	default:
+		return NULL;
+	}
+}
 
-static int fill_fd(void *buf, unsigned int len)
+/**
+ * uncompress_stream_init - start decompressing a stream
+ *
+ * The compressed data is passed in pieces of arbitrary size with
+ * uncompress_stream_feed(), the decompressed data is fetched with
+ * uncompress_stream_drain(). Other than uncompress() this has no global
+ * state, so several streams can be decompressed at the same time, and the
+ * caller decides where the input comes from and where the output goes to,
+ * e.g. to decompress an image while it is still being read.
+ *
+ * The compression format is detected from the first bytes of the stream.
+ * Errors are reported to @error_fn, or with pr_err() when it is NULL.
+ *
+ * Return: The stream, free with uncompress_stream_free()
+ */
+struct uncompress_stream *uncompress_stream_init(void(*error_fn)(char *x))
 {
-	return read(uncompress_infd, buf, len);
+	struct uncompress_stream *us;
+
+	us = xzalloc(sizeof(struct uncompress_stream));
+	us->error_fn = error_fn;
+
+	return us;
 }
 
-static int flush_fd(void *buf, unsigned int len)
+/**
+ * uncompress_stream_error - report an error of a stream
+ * @us: The stream
+ * @fmt: printf style format of the message, without a trailing newline
+ */
+void uncompress_stream_error(struct uncompress_stream *us, const char *fmt, ...)
 {
-	return write(uncompress_outfd, buf, len);
+	va_list args;
+	char *err;
+
+	va_start(args, fmt);
+	err = bvasprintf(fmt, args);
+	va_end(args);
+
+	if (us->error_fn)
+		us->error_fn(err);
+	else
+		pr_err("%s\n", err);
+
+	free(err);
+}
+
+static int uncompress_stream_start(struct uncompress_stream *us)
+{
+	int ret;
+
+	us->type = file_detect_type(us->hdr, us->hdr_len);
+	us->ops = uncompress_stream_ops(us->type);
+	if (!us->ops) {
+		uncompress_stream_error(us, "cannot handle filetype %s",
+					file_type_to_string(us->type));
+		return -ENOSYS;
+	}
+
+	us->in = us->hdr;
+	us->in_len = us->hdr_len;
+
+	ret = us->ops->init(us);
+	if (ret)
+		us->ops = NULL;
+
+	return ret;
+}
+
+/**
+ * uncompress_stream_feed - pass the next piece of compressed data
+ * @us: The stream
+ * @buf: The compressed data, NULL to signal the end of the input
+ * @len: Size of @buf
+ *
+ * @buf is not copied, it must stay valid until uncompress_stream_drain()
+ * returns 0 which means that all input has been consumed. Only then the
+ * next piece may be passed. Data after the end of the compressed data is
+ * ignored.
+ *
+ * Return: 0 for success or a negative error code
+ */
+int uncompress_stream_feed(struct uncompress_stream *us, const void *buf,
+			   size_t len)
+{
+	size_t now;
+
+	if (us->in_len || us->next_len)
+		return -EBUSY;
+
+	if (!buf) {
+		us->eof = true;
+		if (!us->ops && us->hdr_len)
+			return uncompress_stream_start(us);
+		return 0;
+	}
+
+	if (us->done)
+		return 0;
+
+	if (us->ops) {
+		us->in = buf;
+		us->in_len = len;
+		return 0;
+	}
+
+	now = min(len, sizeof(us->hdr) - us->hdr_len);
+	memcpy(us->hdr + us->hdr_len, buf, now);
+	us->hdr_len += now;
+
+	if (us->hdr_len < sizeof(us->hdr))
+		return 0;
+
+	us->next_in = buf + now;
+	us->next_len = len - now;
+
+	return uncompress_stream_start(us);
+}
+
+/**
+ * uncompress_stream_drain - fetch decompressed data
+ * @us: The stream
+ * @buf: Buffer for the decompressed data
+ * @len: Size of @buf
+ *
+ * Call this until it returns 0 after each uncompress_stream_feed(). After
+ * the end of the input has been signalled a return value of 0 means that
+ * the stream has been decompressed successfully.
+ *
+ * Return: The number of bytes written to @buf, 0 when more input is needed
+ * or the stream is complete, or a negative error code.
+ */
+ssize_t uncompress_stream_drain(struct uncompress_stream *us, void *buf,
+				size_t len)
+{
+	ssize_t ret;
+
+	if (!us->ops) {
+		if (!us->eof)
+			return 0;
+		uncompress_stream_error(us, "no compressed data");
+		return -EINVAL;
+	}
+
+	while (!us->done) {
+		ret = us->ops->drain(us, buf, len);
+		if (ret)
+			return ret;
+
+		if (us->done)
+			break;
+
+		/* continue with the input following the detection bytes */
+		if (us->next_len) {
+			us->in = us->next_in;
+			us->in_len = us->next_len;
+			us->next_len = 0;
+			continue;
+		}
+
+		if (us->eof) {
+			uncompress_stream_error(us,
+						"unexpected end of compressed data");
+			return -EINVAL;
+		}
+
+		return 0;
+	}
+
+	/* ignore trailing data */
+	us->in_len = 0;
+	us->next_len = 0;
+
+	return 0;
+}
+
+/**
+ * uncompress_stream_filetype - return the compression format of a stream
+ * @us: The stream
+ *
+ * Return: The filetype, filetype_unknown before enough data has been fed
+ */
+enum filetype uncompress_stream_filetype(struct uncompress_stream *us)
+{
+	return us->type;
+}
+
+void uncompress_stream_free(struct uncompress_stream *us)
+{
+	if (us->ops)
+		us->ops->free(us);
+	free(us);
+}
+
+/**
+ * uncompress_stream_collect - collect input for a decompressor
+ * @us: The stream
+ * @buf: The buffer to collect into
+ * @collected: Number of bytes already in @buf, updated
+ * @size: Number of bytes needed
+ *
+ * For decompressors which need a header or a block of compressed data in
+ * one piece.
+ *
+ * Return: true when @buf contains @size bytes
+ */
+bool uncompress_stream_collect(struct uncompress_stream *us, void *buf,
+			       size_t *collected, size_t size)
+{
+	size_t now = min(us->in_len, size - *collected);
+
+	memcpy(buf + *collected, us->in, now);
+	*collected += now;
+	us->in += now;
+	us->in_len -= now;
+
+	return *collected == size;
+}
+
+#define UNCOMPRESS_FD_BUFSIZE	SZ_64K
+
+/*
+ * Decompress from @infd to @outfd or, if @output is given, to @output
+ * which must be big enough for the decompressed data.
+ */
+static int uncompress_fd(int infd, int outfd, void *output,
+			 void(*error_fn)(char *x))
+{
+	struct uncompress_stream *us;
+	void *inbuf, *outbuf = NULL;
+	ssize_t now, len;
+	int ret;
+
+	us = uncompress_stream_init(error_fn);
+	inbuf = xmalloc(UNCOMPRESS_FD_BUFSIZE);
+	if (!output)
+		outbuf = xmalloc(UNCOMPRESS_FD_BUFSIZE);
+
+	do {
+		len = read(infd, inbuf, UNCOMPRESS_FD_BUFSIZE);
+		if (len < 0) {
+			ret = len;
+			goto out;
+		}
+
+		ret = uncompress_stream_feed(us, len ? inbuf : NULL, len);
+		if (ret)
+			goto out;
+
+		while (1) {
+			if (output)
+				now = uncompress_stream_drain(us, output, SZ_1M);
+			else
+				now = uncompress_stream_drain(us, outbuf,
+							UNCOMPRESS_FD_BUFSIZE);
+			if (now < 0) {
+				ret = now;
+				goto out;
+			}
+			if (!now)
+				break;
+
+			if (output) {
+				output += now;
+			} else {
+				ret = write_full(outfd, outbuf, now);
+				if (ret < 0)
+					goto out;
+			}
+		}
+	} while (len && !us->done);
+
+	ret = 0;
+out:
+	uncompress_stream_free(us);
+	free(inbuf);
+	free(outbuf);
+
+	return ret;
 }
 
 int uncompress_fd_to_fd(int infd, int outfd,
 	   void(*error_fn)(char *x))
 {
-	uncompress_infd = infd;
-	uncompress_outfd = outfd;
-
-	return uncompress(NULL, 0,
-	   fill_fd,
-	   flush_fd,
-	   NULL,
-	   NULL,
-	   error_fn);
+	return uncompress_fd(infd, outfd, NULL, error_fn);
 }
 
 int uncompress_fd_to_buf(int infd, void *output,
 		void(*error_fn)(char *x))
 {
-	uncompress_infd = infd;
-
-	return uncompress(NULL, 0, fill_fd, NULL, output, NULL, error_fn);
+	return uncompress_fd(infd, -1, output, error_fn);
 }
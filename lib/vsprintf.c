@@ -680,6 +680,7 @@ int vasprintf(char **strp, const char *fmt, va_list ap)
 	unsigned int len;
 	va_list aq;
 	char *p;
+	malloc_trace_caller();
 
 	va_copy(aq, ap);
 	len = vsnprintf(NULL, 0, fmt, aq);
@@ -701,6 +702,7 @@ char *bvasprintf(const char *fmt, va_list ap)
 {
 	char *p;
 	int len;
+	malloc_trace_caller();
 
 	len = vasprintf(&p, fmt, ap);
 	if (len < 0)
@@ -714,6 +716,7 @@ int asprintf(char **strp, const char *fmt, ...)
 {
 	va_list ap;
 	int len;
+	malloc_trace_caller();
 
 	va_start(ap, fmt);
 	len = vasprintf(strp, fmt, ap);
@@ -728,6 +731,7 @@ char *basprintf(const char *fmt, ...)
 	va_list ap;
 	char *p;
 	int len;
+	malloc_trace_caller();
 
 	va_start(ap, fmt);
 	len = vasprintf(&p, fmt, ap);
@@ -32,6 +32,7 @@ static void __noreturn enomem_panic(size_t size)
 		pr_emerg("Unable to allocate %zu bytes\n", size);
 
 	malloc_stats();
+	malloc_trace_show(10);
 
 	panic("out of memory");
 }
@@ -39,6 +40,7 @@ static void __noreturn enomem_panic(size_t size)
 void *xmalloc(size_t size)
 {
 	void *p = NULL;
+	malloc_trace_caller();
 
 	if (!(p = malloc(size)))
 		enomem_panic(size);
@@ -50,6 +52,7 @@ EXPORT_SYMBOL(xmalloc);
 void *xrealloc(void *ptr, size_t size)
 {
 	void *p = NULL;
+	malloc_trace_caller();
 
 	if (!(p = realloc(ptr, size)))
 		enomem_panic(size);
@@ -60,7 +63,10 @@ EXPORT_SYMBOL(xrealloc);
 
 void *xzalloc(size_t size)
 {
-	void *ptr = xmalloc(size);
+	void *ptr;
+	malloc_trace_caller();
+
+	ptr = xmalloc(size);
 	memset(ptr, 0, size);
 	return ptr;
 }
@@ -69,6 +75,7 @@ EXPORT_SYMBOL(xzalloc);
 char *xstrdup(const char *s)
 {
 	char *p;
+	malloc_trace_caller();
 
 	if (!s)
 		return NULL;
@@ -85,6 +92,7 @@ char *xstrndup(const char *s, size_t n)
 {
 	int m;
 	char *t;
+	malloc_trace_caller();
 
 	/* We can just xmalloc(n+1) and strncpy into it, */
 	/* but think about xstrndup("abc", 10000) wastage! */
@@ -105,7 +113,10 @@ EXPORT_SYMBOL(xstrndup);
 
 void* xmemalign(size_t alignment, size_t bytes)
 {
-	void *p = memalign(alignment, bytes);
+	void *p;
+	malloc_trace_caller();
+
+	p = memalign(alignment, bytes);
 	if (!p)
 		enomem_panic(bytes);
 
@@ -115,8 +126,10 @@ EXPORT_SYMBOL(xmemalign);
 
 void *xmemdup(const void *orig, size_t size)
 {
-	void *buf = xmalloc(size);
+	void *buf;
+	malloc_trace_caller();
 
+	buf = xmalloc(size);
 	memcpy(buf, orig, size);
 
 	return buf;
@@ -126,6 +139,7 @@ EXPORT_SYMBOL(xmemdup);
 char *xvasprintf(const char *fmt, va_list ap)
 {
 	char *p;
+	malloc_trace_caller();
 
 	p = bvasprintf(fmt, ap);
 	if (!p)
@@ -138,6 +152,7 @@ char *xasprintf(const char *fmt, ...)
 {
 	va_list ap;
 	char *p;
+	malloc_trace_caller();
 
 	va_start(ap, fmt);
 	p = xvasprintf(fmt, ap);
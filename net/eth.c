@@ -154,7 +154,7 @@ void of_eth_register_ethaddr(struct device_node *node, const char *ethaddr)
 	list_add_tail(&addr->list, &ethaddr_list);
 }
 
-struct eth_device *eth_get_byname(const char *ethname)
+static struct eth_device *__eth_get_byname(const char *ethname)
 {
 	struct eth_device *edev;
 
@@ -165,6 +165,17 @@ struct eth_device *eth_get_byname(const char *ethname)
 	return NULL;
 }
 
+struct eth_device *eth_get_byname(const char *ethname)
+{
+	struct eth_device *edev;
+
+	edev = __eth_get_byname(ethname);
+	if (!edev && device_probe_on_demand(ethname))
+		edev = __eth_get_byname(ethname);
+
+	return edev;
+}
+
 #ifdef CONFIG_AUTO_COMPLETE
 int eth_complete(struct string_list *sl, char *instr)
 {
@@ -247,6 +258,35 @@ int eth_send(struct eth_device *edev, void *packet, int length)
 	return edev->send(edev, packet, length);
 }
 
+/**
+ * eth_get_tx_buffer - get a transmit buffer of the driver
+ * @edev: the device to send on
+ *
+ * Return: a buffer of PKTSIZE bytes to build a frame in and send with
+ * eth_send_tx_buffer(), or NULL if the driver doesn't provide one. The
+ * buffer must be sent before any other frame is sent on the device.
+ */
+void *eth_get_tx_buffer(struct eth_device *edev)
+{
+	if (!edev->tx_buffer || eth_check_open(edev))
+		return NULL;
+
+	return edev->tx_buffer(edev);
+}
+
+int eth_send_tx_buffer(struct eth_device *edev, void *buf, int length)
+{
+	int ret;
+
+	ret = eth_carrier_check(edev, 0);
+	if (ret)
+		return ret;
+
+	led_trigger_network(LED_TRIGGER_NET_TX);
+
+	return edev->tx_submit(edev, buf, length);
+}
+
 static int __eth_rx(struct eth_device *edev)
 {
 	int ret;
@@ -259,6 +299,9 @@ static int __eth_rx(struct eth_device *edev)
 	if (ret)
 		return ret;
 
+	if (edev->recv_batch)
+		return edev->recv_batch(edev, edev->rx_budget);
+
 	return edev->recv(edev);
 }
 
@@ -281,6 +324,16 @@ static int eth_param_set_ethaddr(struct param_d *param, void *priv)
 	return eth_set_ethaddr(edev, edev->ethaddr);
 }
 
+static int eth_param_set_rx_budget(struct param_d *param, void *priv)
+{
+	struct eth_device *edev = priv;
+
+	if (!edev->rx_budget)
+		return -EINVAL;
+
+	return 0;
+}
+
 #ifdef CONFIG_OFTREE
 static void eth_of_fixup_node(struct device_node *root,
 			      const char *node_path, int ethid,
@@ -396,6 +449,19 @@ int eth_register(struct eth_device *edev)
 				  eth_mode_names, ARRAY_SIZE(eth_mode_names),
 				  NULL);
 
+	if (edev->recv_batch) {
+		edev->rx_budget = ETH_RX_BUDGET;
+		dev_add_param_uint32(dev, "rx_budget", eth_param_set_rx_budget,
+				     NULL, &edev->rx_budget, "%u", edev);
+	}
+
+	if (IS_ENABLED(CONFIG_NET_IP_REASSEMBLY)) {
+		dev_add_param_uint32_ro(dev, "ip_reasm_hits",
+					&edev->ip_reasm_hits, "%u");
+		dev_add_param_uint32_ro(dev, "ip_reasm_timeouts",
+					&edev->ip_reasm_timeouts, "%u");
+	}
+
 	if (edev->init)
 		edev->init(edev);
 
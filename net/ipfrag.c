@@ -0,0 +1,206 @@
+/*
+ * ipfrag.c - IPv4 fragment reassembly
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt) "ipfrag: " fmt
+
+#include <common.h>
+#include <clock.h>
+#include <malloc.h>
+#include <net.h>
+#include <linux/bitmap.h>
+
+/* number of datagrams which can be reassembled at the same time */
+#define IPFRAG_SLOTS		8
+/* incomplete datagrams are dropped after this time */
+#define IPFRAG_TIMEOUT		(2 * SECOND)
+
+#define IPFRAG_HDR_SIZE		(ETHER_HDR_SIZE + sizeof(struct iphdr))
+
+struct ipfrag {
+	struct eth_device *edev;
+	bool active;
+	uint64_t start;
+
+	/* identifies the datagram together with the protocol */
+	IPaddr_t saddr;
+	IPaddr_t daddr;
+	uint16_t id;
+	uint8_t protocol;
+
+	/*
+	 * The datagram is assembled in buf, prefixed with the ethernet and
+	 * IP header of its first fragment so that it looks like a regular
+	 * packet to the protocol handlers.
+	 */
+	unsigned char *buf;
+	size_t bufsize;
+
+	/* payload length, known once the last fragment arrived */
+	int total;
+	/* payload received so far, in units of 8 bytes */
+	int received;
+	DECLARE_BITMAP(map, DIV_ROUND_UP(IP_MAX_PAYLOAD, 8));
+};
+
+static struct ipfrag ipfrags[IPFRAG_SLOTS];
+
+static void ipfrag_drop(struct ipfrag *frag)
+{
+	frag->active = false;
+	frag->edev->ip_reasm_timeouts++;
+
+	pr_debug("dropping incomplete datagram id 0x%04x\n", frag->id);
+}
+
+static struct ipfrag *ipfrag_find(struct eth_device *edev, struct iphdr *ip)
+{
+	struct ipfrag *frag, *oldest = NULL, *free = NULL;
+	uint64_t now = get_time_ns();
+	int i;
+
+	for (i = 0; i < IPFRAG_SLOTS; i++) {
+		frag = &ipfrags[i];
+
+		if (frag->active && is_timeout(frag->start, IPFRAG_TIMEOUT))
+			ipfrag_drop(frag);
+
+		/*
+		 * Use the least recently used slot, the buffer of a datagram
+		 * is still needed by the protocol handler after delivery.
+		 */
+		if (!frag->active) {
+			if (!free || frag->start < free->start)
+				free = frag;
+			continue;
+		}
+
+		if (frag->id == ip->id && frag->protocol == ip->protocol &&
+		    frag->saddr == net_read_ip(&ip->saddr) &&
+		    frag->daddr == net_read_ip(&ip->daddr))
+			return frag;
+
+		if (!oldest || frag->start < oldest->start)
+			oldest = frag;
+	}
+
+	/* make room by sacrificing the oldest incomplete datagram */
+	if (!free) {
+		ipfrag_drop(oldest);
+		free = oldest;
+	}
+
+	frag = free;
+
+	frag->edev = edev;
+	frag->active = true;
+	frag->start = now;
+	frag->saddr = net_read_ip(&ip->saddr);
+	frag->daddr = net_read_ip(&ip->daddr);
+	frag->id = ip->id;
+	frag->protocol = ip->protocol;
+	frag->total = -1;
+	frag->received = 0;
+	bitmap_zero(frag->map, DIV_ROUND_UP(IP_MAX_PAYLOAD, 8));
+
+	return frag;
+}
+
+/*
+ * net_ip_reassemble - collect a fragment of an IP datagram
+ *
+ * @pkt is an ethernet frame with a fragmented IP packet, already checked
+ * by net_handle_ip(). Returns the reassembled datagram, again in the form
+ * of an ethernet frame, once all of its fragments have arrived, NULL
+ * otherwise. *@len is updated to the length of the reassembled frame.
+ *
+ * The returned buffer stays valid until the slot is reused for another
+ * datagram.
+ */
+unsigned char *net_ip_reassemble(struct eth_device *edev, unsigned char *pkt,
+				 int *len)
+{
+	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
+	uint16_t frag_off = ntohs(ip->frag_off);
+	int ihl = (ip->hl_v & 0x0f) * 4;
+	int offset = (frag_off & IP_OFFSET) * 8;
+	int fraglen = ntohs(ip->tot_len) - ihl;
+	bool last = !(frag_off & IP_MF);
+	struct ipfrag *frag;
+	struct iphdr *fip;
+	size_t size;
+	int i;
+
+	if (ihl < sizeof(struct iphdr) || fraglen <= 0 ||
+	    offset + fraglen > IP_MAX_PAYLOAD)
+		return NULL;
+
+	/* all but the last fragment carry a multiple of 8 bytes */
+	if (!last && (fraglen & 7))
+		return NULL;
+
+	frag = ipfrag_find(edev, ip);
+
+	if (last) {
+		if (frag->total >= 0 && frag->total != offset + fraglen)
+			goto invalid;
+		frag->total = offset + fraglen;
+	}
+
+	if (frag->total >= 0 && offset + fraglen > frag->total)
+		goto invalid;
+
+	size = IPFRAG_HDR_SIZE + offset + fraglen;
+	if (size > frag->bufsize) {
+		unsigned char *buf = realloc(frag->buf, size);
+
+		if (!buf)
+			goto invalid;
+
+		frag->buf = buf;
+		frag->bufsize = size;
+	}
+
+	/* the first fragment provides the headers for the whole datagram */
+	if (!offset) {
+		memcpy(frag->buf, pkt, IPFRAG_HDR_SIZE);
+		fip = (struct iphdr *)(frag->buf + ETHER_HDR_SIZE);
+		fip->hl_v = 0x45;
+		fip->frag_off = 0;
+	}
+
+	memcpy(frag->buf + IPFRAG_HDR_SIZE + offset, pkt + ETHER_HDR_SIZE + ihl,
+	       fraglen);
+
+	for (i = offset / 8; i < DIV_ROUND_UP(offset + fraglen, 8); i++)
+		if (!test_and_set_bit(i, frag->map))
+			frag->received++;
+
+	if (frag->total < 0 || frag->received != DIV_ROUND_UP(frag->total, 8))
+		return NULL;
+
+	frag->active = false;
+	edev->ip_reasm_hits++;
+
+	fip = (struct iphdr *)(frag->buf + ETHER_HDR_SIZE);
+	fip->tot_len = htons(sizeof(struct iphdr) + frag->total);
+
+	*len = IPFRAG_HDR_SIZE + frag->total;
+
+	return frag->buf;
+
+invalid:
+	pr_debug("invalid fragment for datagram id 0x%04x\n", frag->id);
+	frag->active = false;
+
+	return NULL;
+}
@@ -35,6 +35,7 @@
 #include <driver.h>
 #include <errno.h>
 #include <malloc.h>
+#include <stdlib.h>
 #include <init.h>
 #include <globalvar.h>
 #include <magicvar.h>
@@ -96,6 +97,40 @@ uint16_t net_checksum(unsigned char *ptr, int len)
 	return xsum & 0xffff;
 }
 
+/*
+ * Checksum of a TCP segment including the pseudo header. Fill in with
+ * th_sum set to zero, a received segment is valid if 0 is returned.
+ */
+uint16_t net_tcp_checksum(struct iphdr *ip, void *tcp, int len)
+{
+	unsigned char *p = tcp;
+	uint32_t xsum = 0;
+	int i;
+
+	xsum += net_read_uint32(&ip->saddr) & 0xffff;
+	xsum += net_read_uint32(&ip->saddr) >> 16;
+	xsum += net_read_uint32(&ip->daddr) & 0xffff;
+	xsum += net_read_uint32(&ip->daddr) >> 16;
+	xsum += htons(IPPROTO_TCP);
+	xsum += htons(len);
+
+	for (i = 0; i + 1 < len; i += 2)
+		xsum += *(uint16_t *)(p + i);
+
+	/* the odd byte is padded with zero, without touching the buffer */
+	if (len & 1) {
+		uint16_t last = 0;
+
+		*(uint8_t *)&last = p[len - 1];
+		xsum += last;
+	}
+
+	xsum = (xsum & 0xffff) + (xsum >> 16);
+	xsum = (xsum & 0xffff) + (xsum >> 16);
+
+	return ~xsum & 0xffff;
+}
+
 IPaddr_t getenv_ip(const char *name)
 {
 	IPaddr_t ip;
@@ -267,6 +302,25 @@ static uint16_t net_udp_new_localport(void)
 	return localport;
 }
 
+/*
+ * TCP ports are taken from the dynamic range, starting at a random port.
+ * A server may still keep connections of a previous boot in TIME_WAIT.
+ */
+static uint16_t net_tcp_new_localport(void)
+{
+	static uint16_t localport;
+
+	if (!localport)
+		localport = 49152 + random32() % 16384;
+
+	localport++;
+
+	if (localport < 49152)
+		localport = 49152;
+
+	return localport;
+}
+
 IPaddr_t net_get_serverip(void)
 {
 	return net_serverip;
@@ -348,6 +402,7 @@ static struct net_connection *net_new(struct eth_device *edev, IPaddr_t dest,
 	con->ip = (struct iphdr *)(con->packet + ETHER_HDR_SIZE);
 	con->udp = (struct udphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
 	con->icmp = (struct icmphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
+	con->tcp = (struct tcphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
 	con->handler = handler;
 
 	if (dest == IP_BROADCAST) {
@@ -414,6 +469,22 @@ struct net_connection *net_icmp_new(IPaddr_t dest, rx_handler_f *handler,
 	return con;
 }
 
+struct net_connection *net_tcp_new(IPaddr_t dest, uint16_t dport,
+		rx_handler_f *handler, void *ctx)
+{
+	struct net_connection *con = net_new(NULL, dest, handler, ctx);
+
+	if (IS_ERR(con))
+		return con;
+
+	con->proto = IPPROTO_TCP;
+	con->tcp->th_dport = htons(dport);
+	con->tcp->th_sport = htons(net_tcp_new_localport());
+	con->ip->protocol = IPPROTO_TCP;
+
+	return con;
+}
+
 void net_unregister(struct net_connection *con)
 {
 	list_del(&con->list);
@@ -421,22 +492,80 @@ void net_unregister(struct net_connection *con)
 	free(con);
 }
 
+static int net_ip_xmit(struct net_connection *con, unsigned char *frame,
+		       int len)
+{
+	struct iphdr *ip = (struct iphdr *)(frame + ETHER_HDR_SIZE);
+
+	ip->tot_len = htons(sizeof(struct iphdr) + len);
+	ip->id = htons(net_ip_id++);
+	ip->check = 0;
+	ip->check = ~net_checksum((unsigned char *)ip, sizeof(struct iphdr));
+
+	len += ETHER_HDR_SIZE + sizeof(struct iphdr);
+
+	if (frame != con->packet)
+		return eth_send_tx_buffer(con->edev, frame, len);
+
+	return eth_send(con->edev, frame, len);
+}
+
 static int net_ip_send(struct net_connection *con, int len)
 {
-	con->ip->tot_len = htons(sizeof(struct iphdr) + len);
-	con->ip->id = htons(net_ip_id++);
-	con->ip->check = 0;
-	con->ip->check = ~net_checksum((unsigned char *)con->ip, sizeof(struct iphdr));
+	return net_ip_xmit(con, con->packet, len);
+}
 
-	return eth_send(con->edev, con->packet, ETHER_HDR_SIZE + sizeof(struct iphdr) + len);
+static int net_udp_xmit(struct net_connection *con, unsigned char *frame,
+			int len)
+{
+	struct udphdr *udp = (struct udphdr *)(frame + ETHER_HDR_SIZE +
+					       sizeof(struct iphdr));
+
+	udp->uh_ulen = htons(len + 8);
+	udp->uh_sum = 0;
+
+	return net_ip_xmit(con, frame, sizeof(struct udphdr) + len);
 }
 
 int net_udp_send(struct net_connection *con, int len)
 {
-	con->udp->uh_ulen = htons(len + 8);
-	con->udp->uh_sum = 0;
+	return net_udp_xmit(con, con->packet, len);
+}
+
+#define UDP_HDR_SIZE	(ETHER_HDR_SIZE + sizeof(struct iphdr) + \
+			 sizeof(struct udphdr))
 
-	return net_ip_send(con, sizeof(struct udphdr) + len);
+/*
+ * net_udp_get_tx_payload - get a buffer for the payload of a UDP packet
+ *
+ * If the driver provides transmit buffers, the packet is built in one of
+ * them and sent without copying. The headers are taken from the
+ * connection's packet. Otherwise the connection's packet itself is used.
+ * Send with net_udp_send_tx_payload() before sending anything else.
+ */
+void *net_udp_get_tx_payload(struct net_connection *con)
+{
+	unsigned char *frame = eth_get_tx_buffer(con->edev);
+
+	if (!frame)
+		return net_udp_get_payload(con);
+
+	memcpy(frame, con->packet, UDP_HDR_SIZE);
+
+	return frame + UDP_HDR_SIZE;
+}
+
+int net_udp_send_tx_payload(struct net_connection *con, void *payload, int len)
+{
+	return net_udp_xmit(con, payload - UDP_HDR_SIZE, len);
+}
+
+int net_tcp_send(struct net_connection *con, int len)
+{
+	con->tcp->th_sum = 0;
+	con->tcp->th_sum = net_tcp_checksum(con->ip, con->tcp, len);
+
+	return net_ip_send(con, len);
 }
 
 int net_icmp_send(struct net_connection *con, int len)
@@ -554,6 +683,25 @@ static int net_handle_udp(unsigned char *pkt, int len)
 	return -EINVAL;
 }
 
+static int net_handle_tcp(unsigned char *pkt, int len)
+{
+	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
+	struct net_connection *con;
+	struct tcphdr *tcp;
+
+	tcp = (struct tcphdr *)(ip + 1);
+	list_for_each_entry(con, &connection_list, list) {
+		if (con->proto == IPPROTO_TCP &&
+		    tcp->th_dport == con->tcp->th_sport &&
+		    tcp->th_sport == con->tcp->th_dport &&
+		    net_read_ip(&ip->saddr) == net_read_ip(&con->ip->daddr)) {
+			con->handler(con->priv, pkt, len);
+			return 0;
+		}
+	}
+	return -EINVAL;
+}
+
 static int net_handle_icmp(unsigned char *pkt, int len)
 {
 	struct net_connection *con;
@@ -585,8 +733,6 @@ static int net_handle_ip(struct eth_device *edev, unsigned char *pkt, int len)
 	if ((ip->hl_v & 0xf0) != 0x40)
 		goto bad;
 
-	if (ip->frag_off & htons(0x1fff)) /* Can't deal w/ fragments */
-		goto bad;
 	if (!net_checksum_ok((unsigned char *)ip, sizeof(struct iphdr)))
 		goto bad;
 
@@ -594,11 +740,21 @@ static int net_handle_ip(struct eth_device *edev, unsigned char *pkt, int len)
 	if (edev->ipaddr && tmp != edev->ipaddr && tmp != IP_BROADCAST)
 		return 0;
 
+	if (ip->frag_off & htons(IP_MF | IP_OFFSET)) {
+		/* continue with the datagram once it is complete */
+		pkt = net_ip_reassemble(edev, pkt, &len);
+		if (!pkt)
+			return 0;
+		ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
+	}
+
 	switch (ip->protocol) {
 	case IPPROTO_ICMP:
 		return net_handle_icmp(pkt, len);
 	case IPPROTO_UDP:
 		return net_handle_udp(pkt, len);
+	case IPPROTO_TCP:
+		return net_handle_tcp(pkt, len);
 	}
 
 	return 0;
@@ -0,0 +1,761 @@
+/*
+ * tcp.c - minimal TCP client implementation
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Only active opens are supported and the implementation is optimized for
+ * receiving: received data is buffered in a FIFO whose free space is
+ * offered as window (scaled if the peer supports it), out of order segments
+ * are kept until the gap is filled and acknowledgements are delayed until
+ * two segments arrived. Data is sent go-back-N from a single buffer, with a
+ * fast retransmit of the first segment after three duplicate ACKs.
+ */
+
+#define pr_fmt(fmt) "tcp: " fmt
+
+#include <common.h>
+#include <clock.h>
+#include <malloc.h>
+#include <errno.h>
+#include <kfifo.h>
+#include <stdlib.h>
+#include <net.h>
+#include <tcp.h>
+#include <linux/list.h>
+#include <linux/err.h>
+#include <linux/sizes.h>
+#include <asm/unaligned.h>
+
+#define TCP_RX_BUFSIZE		SZ_128K
+#define TCP_TX_BUFSIZE		SZ_16K
+/* window scale we offer, large enough to announce the whole buffer */
+#define TCP_RCV_WSCALE		2
+
+#define TCP_MSS			(1500 - sizeof(struct iphdr) - sizeof(struct tcphdr))
+#define TCP_DEFAULT_MSS		536
+/* smaller MSS options are ignored, a MSS of 0 would stall the output */
+#define TCP_MIN_MSS		64
+
+#define TCP_RTO_INITIAL		SECOND
+#define TCP_RTO_MAX		(16 * SECOND)
+#define TCP_MAX_RETRIES		8
+#define TCP_DELACK_TIMEOUT	(40 * MSECOND)
+#define TCP_IDLE_TIMEOUT	(30 * SECOND)
+#define TCP_CLOSE_TIMEOUT	SECOND
+
+enum tcp_state {
+	TCP_CLOSED,
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+	TCP_FIN_WAIT_1,
+	TCP_FIN_WAIT_2,
+	TCP_CLOSE_WAIT,
+	TCP_LAST_ACK,
+	TCP_CLOSING,
+};
+
+struct tcp_segment {
+	struct list_head list;
+	uint32_t seq;
+	unsigned int len;
+	bool fin;
+	unsigned char data[];
+};
+
+struct tcp_connection {
+	struct net_connection *con;
+	enum tcp_state state;
+	int err;
+
+	/* send side */
+	uint32_t snd_una;
+	uint32_t snd_nxt;
+	uint32_t snd_wnd;
+	uint8_t snd_wscale;
+	uint16_t mss;
+	bool closing;
+	bool fin_sent;
+	/* data not acknowledged yet, starting at snd_una */
+	unsigned char *txbuf;
+	size_t txlen;
+	uint64_t rto_start;
+	uint64_t rto;
+	int retries;
+	int dupacks;
+
+	/* receive side */
+	uint32_t rcv_nxt;
+	/* right edge of the window we announced last */
+	uint32_t rcv_adv;
+	uint8_t rcv_wscale;
+	struct kfifo *rxfifo;
+	/* out of order segments, sorted by sequence number */
+	struct list_head ooo;
+	size_t ooo_len;
+	bool fin_received;
+	int ack_pending;
+	uint64_t ack_start;
+	uint64_t last_rx;
+};
+
+static inline bool seq_before(uint32_t a, uint32_t b)
+{
+	return (int32_t)(a - b) < 0;
+}
+
+static inline bool seq_after(uint32_t a, uint32_t b)
+{
+	return seq_before(b, a);
+}
+
+static uint32_t tcp_rcv_window(struct tcp_connection *tcp)
+{
+	uint32_t wnd = tcp->rxfifo->size - kfifo_len(tcp->rxfifo);
+
+	wnd = min_t(uint32_t, wnd, 0xffff << tcp->rcv_wscale);
+
+	/* the window is announced in units of the scale */
+	return wnd >> tcp->rcv_wscale << tcp->rcv_wscale;
+}
+
+static int tcp_xmit(struct tcp_connection *tcp, uint8_t flags, uint32_t seq,
+		    const void *data, size_t len)
+{
+	struct tcphdr *th = tcp->con->tcp;
+	unsigned char *opt = (unsigned char *)(th + 1);
+	uint32_t wnd = tcp_rcv_window(tcp);
+	int optlen = 0;
+
+	if (flags & TH_SYN) {
+		/* maximum segment size */
+		opt[0] = 2;
+		opt[1] = 4;
+		put_unaligned_be16(TCP_MSS, opt + 2);
+		/* window scale, preceded by a NOP for alignment */
+		opt[4] = 1;
+		opt[5] = 3;
+		opt[6] = 3;
+		opt[7] = TCP_RCV_WSCALE;
+		optlen = 8;
+	}
+
+	if (len)
+		memcpy(opt + optlen, data, len);
+
+	th->th_seq = htonl(seq);
+	th->th_ack = (flags & TH_ACK) ? htonl(tcp->rcv_nxt) : 0;
+	th->th_off = ((sizeof(*th) + optlen) / 4) << 4;
+	th->th_flags = flags;
+	th->th_win = htons(wnd >> tcp->rcv_wscale);
+	th->th_urp = 0;
+
+	if (flags & TH_ACK) {
+		tcp->ack_pending = 0;
+		tcp->rcv_adv = tcp->rcv_nxt + wnd;
+	}
+
+	return net_tcp_send(tcp->con, sizeof(*th) + optlen + len);
+}
+
+static void tcp_send_ack(struct tcp_connection *tcp)
+{
+	tcp_xmit(tcp, TH_ACK, tcp->snd_nxt, NULL, 0);
+}
+
+/* send new data the peer has room for, followed by a FIN when closing */
+static void tcp_output(struct tcp_connection *tcp)
+{
+	size_t off = tcp->snd_nxt - tcp->snd_una;
+
+	if (tcp->fin_sent)
+		return;
+
+	while (off < tcp->txlen && off < tcp->snd_wnd) {
+		size_t now = min3(tcp->txlen - off, (size_t)tcp->mss,
+				  tcp->snd_wnd - off);
+
+		if (tcp->snd_una == tcp->snd_nxt)
+			tcp->rto_start = get_time_ns();
+
+		tcp_xmit(tcp, TH_ACK | TH_PUSH, tcp->snd_nxt, tcp->txbuf + off,
+			 now);
+
+		tcp->snd_nxt += now;
+		off += now;
+	}
+
+	if (tcp->closing && off == tcp->txlen) {
+		if (tcp->snd_una == tcp->snd_nxt)
+			tcp->rto_start = get_time_ns();
+
+		tcp_xmit(tcp, TH_FIN | TH_ACK, tcp->snd_nxt, NULL, 0);
+
+		tcp->snd_nxt++;
+		tcp->fin_sent = true;
+
+		if (tcp->state == TCP_ESTABLISHED)
+			tcp->state = TCP_FIN_WAIT_1;
+		else if (tcp->state == TCP_CLOSE_WAIT)
+			tcp->state = TCP_LAST_ACK;
+	}
+}
+
+static void tcp_retransmit(struct tcp_connection *tcp)
+{
+	if (tcp->state == TCP_SYN_SENT) {
+		tcp_xmit(tcp, TH_SYN, tcp->snd_una, NULL, 0);
+		return;
+	}
+
+	if (tcp->fin_sent && !tcp->txlen) {
+		tcp_xmit(tcp, TH_FIN | TH_ACK, tcp->snd_una, NULL, 0);
+		return;
+	}
+
+	/* go back and send everything not acknowledged again */
+	tcp->fin_sent = false;
+	tcp->snd_nxt = tcp->snd_una;
+	tcp_output(tcp);
+}
+
+static void tcp_parse_options(struct tcp_connection *tcp, struct tcphdr *th,
+			      int hdrlen)
+{
+	unsigned char *opt = (unsigned char *)(th + 1);
+	unsigned char *end = (unsigned char *)th + hdrlen;
+
+	while (opt < end) {
+		if (*opt == 0)
+			break;
+		if (*opt == 1) {
+			opt++;
+			continue;
+		}
+		if (opt + 1 >= end || opt[1] < 2 || opt + opt[1] > end)
+			break;
+
+		if (opt[0] == 2 && opt[1] == 4 &&
+		    get_unaligned_be16(opt + 2) >= TCP_MIN_MSS)
+			tcp->mss = min_t(uint16_t, get_unaligned_be16(opt + 2),
+					 TCP_MSS);
+		if (opt[0] == 3 && opt[1] == 3) {
+			tcp->snd_wscale = min_t(uint8_t, opt[2], 14);
+			tcp->rcv_wscale = TCP_RCV_WSCALE;
+		}
+
+		opt += opt[1];
+	}
+}
+
+static void tcp_fin(struct tcp_connection *tcp)
+{
+	tcp->rcv_nxt++;
+	tcp->fin_received = true;
+
+	switch (tcp->state) {
+	case TCP_ESTABLISHED:
+		tcp->state = TCP_CLOSE_WAIT;
+		break;
+	case TCP_FIN_WAIT_1:
+		tcp->state = TCP_CLOSING;
+		break;
+	case TCP_FIN_WAIT_2:
+		/* no need for TIME_WAIT, the port is not reused soon */
+		tcp->state = TCP_CLOSED;
+		break;
+	default:
+		break;
+	}
+}
+
+static void tcp_ack(struct tcp_connection *tcp, uint32_t ack, uint32_t wnd,
+		    bool has_data)
+{
+	if (seq_after(ack, tcp->snd_nxt)) {
+		/* acknowledges something we didn't send */
+		tcp_send_ack(tcp);
+		return;
+	}
+
+	if (seq_after(ack, tcp->snd_una)) {
+		uint32_t acked = ack - tcp->snd_una;
+
+		/* our FIN occupies the sequence number after the data */
+		if (tcp->fin_sent && ack == tcp->snd_nxt) {
+			acked--;
+
+			if (tcp->state == TCP_FIN_WAIT_1)
+				tcp->state = TCP_FIN_WAIT_2;
+			else if (tcp->state == TCP_CLOSING ||
+				 tcp->state == TCP_LAST_ACK)
+				tcp->state = TCP_CLOSED;
+		}
+
+		acked = min_t(size_t, acked, tcp->txlen);
+		memmove(tcp->txbuf, tcp->txbuf + acked, tcp->txlen - acked);
+		tcp->txlen -= acked;
+
+		tcp->snd_una = ack;
+		tcp->rto = TCP_RTO_INITIAL;
+		tcp->rto_start = get_time_ns();
+		tcp->retries = 0;
+		tcp->dupacks = 0;
+	} else if (ack == tcp->snd_una && tcp->snd_una != tcp->snd_nxt &&
+		   !has_data && wnd == tcp->snd_wnd) {
+		if (++tcp->dupacks == 3 && tcp->txlen)
+			tcp_xmit(tcp, TH_ACK | TH_PUSH, tcp->snd_una,
+				 tcp->txbuf,
+				 min_t(size_t, tcp->txlen, tcp->mss));
+	}
+
+	/* the window opened again, don't wait with the backoff of the probes */
+	if (wnd && !tcp->snd_wnd)
+		tcp->rto = TCP_RTO_INITIAL;
+
+	tcp->snd_wnd = wnd;
+
+	tcp_output(tcp);
+}
+
+/*
+ * The peer closed its window and all data sent has been acknowledged, so
+ * only a window update makes us send again. Ask for it from time to time
+ * in case the update got lost: a segment with an old sequence number makes
+ * the peer answer with an ACK announcing its current window.
+ */
+static void tcp_probe_window(struct tcp_connection *tcp)
+{
+	if (tcp->snd_wnd || tcp->snd_una != tcp->snd_nxt || !tcp->txlen ||
+	    tcp->fin_sent)
+		return;
+
+	if (!is_timeout(tcp->rto_start, tcp->rto))
+		return;
+
+	tcp_xmit(tcp, TH_ACK, tcp->snd_una - 1, NULL, 0);
+
+	tcp->rto = min_t(uint64_t, tcp->rto * 2, TCP_RTO_MAX);
+	tcp->rto_start = get_time_ns();
+}
+
+static void tcp_queue_ooo(struct tcp_connection *tcp, uint32_t seq,
+			  const void *data, unsigned int len, bool fin)
+{
+	struct tcp_segment *seg, *pos;
+
+	list_for_each_entry(pos, &tcp->ooo, list) {
+		if (pos->seq == seq && pos->len >= len)
+			return;
+		if (seq_after(pos->seq, seq))
+			break;
+	}
+
+	if (tcp->ooo_len + len > TCP_RX_BUFSIZE)
+		return;
+
+	seg = malloc(sizeof(*seg) + len);
+	if (!seg)
+		return;
+
+	seg->seq = seq;
+	seg->len = len;
+	seg->fin = fin;
+	memcpy(seg->data, data, len);
+
+	/* insert before the first segment starting after this one */
+	list_add_tail(&seg->list, &pos->list);
+	tcp->ooo_len += len;
+}
+
+/* move out of order segments which became contiguous to the FIFO */
+static void tcp_deliver_ooo(struct tcp_connection *tcp)
+{
+	struct tcp_segment *seg, *tmp;
+
+	list_for_each_entry_safe(seg, tmp, &tcp->ooo, list) {
+		uint32_t end = seg->seq + seg->len;
+
+		if (seq_after(seg->seq, tcp->rcv_nxt))
+			break;
+
+		if (!tcp->fin_received &&
+		    (seq_after(end, tcp->rcv_nxt) ||
+		     (seg->fin && end == tcp->rcv_nxt))) {
+			uint32_t off = tcp->rcv_nxt - seg->seq;
+
+			kfifo_put(tcp->rxfifo, seg->data + off, seg->len - off);
+			tcp->rcv_nxt = end;
+
+			if (seg->fin)
+				tcp_fin(tcp);
+		}
+
+		list_del(&seg->list);
+		tcp->ooo_len -= seg->len;
+		free(seg);
+	}
+}
+
+static void tcp_data(struct tcp_connection *tcp, uint32_t seq,
+		     unsigned char *data, unsigned int len, bool fin)
+{
+	uint32_t wnd;
+	bool had_ooo;
+
+	if (!len && !fin)
+		return;
+
+	if (tcp->fin_received) {
+		tcp_send_ack(tcp);
+		return;
+	}
+
+	/* trim what we already have */
+	if (seq_before(seq, tcp->rcv_nxt)) {
+		uint32_t dup = tcp->rcv_nxt - seq;
+
+		if (dup > len || (dup == len && !fin)) {
+			tcp_send_ack(tcp);
+			return;
+		}
+
+		data += dup;
+		len -= dup;
+		seq = tcp->rcv_nxt;
+	}
+
+	/* and what doesn't fit into the window */
+	wnd = tcp_rcv_window(tcp);
+	if (seq - tcp->rcv_nxt + len > wnd) {
+		if (seq - tcp->rcv_nxt >= wnd) {
+			tcp_send_ack(tcp);
+			return;
+		}
+		len = wnd - (seq - tcp->rcv_nxt);
+		fin = false;
+	}
+
+	if (seq != tcp->rcv_nxt) {
+		tcp_queue_ooo(tcp, seq, data, len, fin);
+		/* duplicate ACK, so that the peer retransmits the gap */
+		tcp_send_ack(tcp);
+		return;
+	}
+
+	kfifo_put(tcp->rxfifo, data, len);
+	tcp->rcv_nxt += len;
+
+	if (fin)
+		tcp_fin(tcp);
+
+	had_ooo = !list_empty(&tcp->ooo);
+	tcp_deliver_ooo(tcp);
+
+	if (had_ooo || tcp->fin_received || ++tcp->ack_pending >= 2)
+		tcp_send_ack(tcp);
+	else
+		tcp->ack_start = get_time_ns();
+}
+
+static void tcp_handler(void *ctx, char *packet, unsigned int len)
+{
+	struct tcp_connection *tcp = ctx;
+	struct iphdr *ip = net_eth_to_iphdr(packet);
+	struct tcphdr *th = (struct tcphdr *)(ip + 1);
+	int seglen = ntohs(ip->tot_len) - sizeof(struct iphdr);
+	int hdrlen = (th->th_off >> 4) * 4;
+	uint32_t seq, ack;
+	uint8_t flags;
+
+	if (seglen < (int)sizeof(*th) || hdrlen < sizeof(*th) ||
+	    hdrlen > seglen)
+		return;
+
+	if (net_tcp_checksum(ip, th, seglen)) {
+		pr_debug("bad checksum\n");
+		return;
+	}
+
+	seq = ntohl(th->th_seq);
+	ack = ntohl(th->th_ack);
+	flags = th->th_flags;
+
+	tcp->last_rx = get_time_ns();
+
+	if (flags & TH_RST) {
+		if (tcp->state == TCP_SYN_SENT) {
+			if (!(flags & TH_ACK) || ack != tcp->snd_nxt)
+				return;
+			tcp->err = -ECONNREFUSED;
+		} else {
+			if (seq != tcp->rcv_nxt)
+				return;
+			tcp->err = -ECONNRESET;
+		}
+		tcp->state = TCP_CLOSED;
+		return;
+	}
+
+	switch (tcp->state) {
+	case TCP_CLOSED:
+		return;
+	case TCP_SYN_SENT:
+		if ((flags & (TH_SYN | TH_ACK)) != (TH_SYN | TH_ACK) ||
+		    ack != tcp->snd_nxt)
+			return;
+
+		tcp_parse_options(tcp, th, hdrlen);
+
+		tcp->rcv_nxt = seq + 1;
+		tcp->snd_una = ack;
+		/* the window in a SYN is never scaled */
+		tcp->snd_wnd = ntohs(th->th_win);
+		tcp->state = TCP_ESTABLISHED;
+		tcp->rto = TCP_RTO_INITIAL;
+		tcp->retries = 0;
+
+		tcp_send_ack(tcp);
+		return;
+	default:
+		break;
+	}
+
+	/* retransmitted SYN-ACK, our ACK got lost */
+	if (flags & TH_SYN) {
+		tcp_send_ack(tcp);
+		return;
+	}
+
+	if (!(flags & TH_ACK))
+		return;
+
+	tcp_ack(tcp, ack, ntohs(th->th_win) << tcp->snd_wscale,
+		seglen > hdrlen || (flags & TH_FIN));
+
+	tcp_data(tcp, seq, (unsigned char *)th + hdrlen, seglen - hdrlen,
+		 flags & TH_FIN);
+}
+
+static int tcp_poll(struct tcp_connection *tcp)
+{
+	if (ctrlc())
+		return -EINTR;
+
+	net_poll();
+
+	if (tcp->err)
+		return tcp->err;
+
+	if (tcp->ack_pending && is_timeout(tcp->ack_start, TCP_DELACK_TIMEOUT))
+		tcp_send_ack(tcp);
+
+	if (tcp->snd_una != tcp->snd_nxt && is_timeout(tcp->rto_start, tcp->rto)) {
+		if (++tcp->retries > TCP_MAX_RETRIES) {
+			tcp->state = TCP_CLOSED;
+			tcp->err = -ETIMEDOUT;
+			return tcp->err;
+		}
+
+		tcp->rto = min_t(uint64_t, tcp->rto * 2, TCP_RTO_MAX);
+		tcp->rto_start = get_time_ns();
+		tcp_retransmit(tcp);
+	}
+
+	tcp_probe_window(tcp);
+
+	return 0;
+}
+
+static void tcp_free(struct tcp_connection *tcp)
+{
+	struct tcp_segment *seg, *tmp;
+
+	list_for_each_entry_safe(seg, tmp, &tcp->ooo, list)
+		free(seg);
+
+	net_unregister(tcp->con);
+	kfifo_free(tcp->rxfifo);
+	free(tcp->txbuf);
+	free(tcp);
+}
+
+/**
+ * tcp_connect - open a TCP connection
+ * @dest: IP address of the peer
+ * @dport: port to connect to
+ *
+ * Return: the connection once it is established or an error pointer.
+ */
+struct tcp_connection *tcp_connect(IPaddr_t dest, uint16_t dport)
+{
+	struct tcp_connection *tcp;
+	int ret;
+
+	tcp = xzalloc(sizeof(*tcp));
+	INIT_LIST_HEAD(&tcp->ooo);
+
+	tcp->rxfifo = kfifo_alloc(TCP_RX_BUFSIZE);
+	if (!tcp->rxfifo) {
+		free(tcp);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	tcp->con = net_tcp_new(dest, dport, tcp_handler, tcp);
+	if (IS_ERR(tcp->con)) {
+		ret = PTR_ERR(tcp->con);
+		kfifo_free(tcp->rxfifo);
+		free(tcp);
+		return ERR_PTR(ret);
+	}
+
+	tcp->txbuf = xmalloc(TCP_TX_BUFSIZE);
+	tcp->mss = TCP_DEFAULT_MSS;
+	tcp->snd_una = random32();
+	tcp->snd_nxt = tcp->snd_una + 1;
+	tcp->rto = TCP_RTO_INITIAL;
+	tcp->rto_start = get_time_ns();
+	tcp->last_rx = tcp->rto_start;
+	tcp->state = TCP_SYN_SENT;
+
+	tcp_xmit(tcp, TH_SYN, tcp->snd_una, NULL, 0);
+
+	while (tcp->state == TCP_SYN_SENT) {
+		ret = tcp_poll(tcp);
+		if (ret)
+			goto err;
+	}
+
+	if (tcp->state != TCP_ESTABLISHED) {
+		ret = tcp->err ? tcp->err : -ECONNRESET;
+		goto err;
+	}
+
+	return tcp;
+err:
+	tcp_free(tcp);
+
+	return ERR_PTR(ret);
+}
+
+/**
+ * tcp_send - send data
+ * @tcp: the connection
+ * @buf: data to send
+ * @len: length of the data
+ *
+ * The data is buffered until it is acknowledged, this only waits when
+ * the buffer is full.
+ *
+ * Return: 0 for success or a negative error code.
+ */
+int tcp_send(struct tcp_connection *tcp, const void *buf, size_t len)
+{
+	int ret;
+
+	while (len) {
+		size_t now;
+
+		if (tcp->closing || (tcp->state != TCP_ESTABLISHED &&
+				     tcp->state != TCP_CLOSE_WAIT))
+			return tcp->err ? tcp->err : -ENOTCONN;
+
+		now = min(len, TCP_TX_BUFSIZE - tcp->txlen);
+		if (!now) {
+			ret = tcp_poll(tcp);
+			if (ret)
+				return ret;
+			continue;
+		}
+
+		memcpy(tcp->txbuf + tcp->txlen, buf, now);
+		tcp->txlen += now;
+		buf += now;
+		len -= now;
+
+		tcp_output(tcp);
+	}
+
+	return 0;
+}
+
+/**
+ * tcp_recv - receive data
+ * @tcp: the connection
+ * @buf: buffer for the data
+ * @len: size of the buffer
+ *
+ * Waits until data is available.
+ *
+ * Return: the number of bytes received, 0 when the peer closed the
+ * connection or a negative error code.
+ */
+int tcp_recv(struct tcp_connection *tcp, void *buf, size_t len)
+{
+	unsigned int now;
+	int ret;
+
+	while (1) {
+		now = kfifo_get(tcp->rxfifo, buf, len);
+		if (now) {
+			/* let the peer know when there is room again */
+			if (tcp->rcv_nxt + tcp_rcv_window(tcp) - tcp->rcv_adv >=
+			    min_t(uint32_t, TCP_RX_BUFSIZE / 2, tcp->mss))
+				tcp_send_ack(tcp);
+
+			return now;
+		}
+
+		if (tcp->fin_received)
+			return 0;
+
+		if (tcp->state == TCP_CLOSED)
+			return tcp->err ? tcp->err : -ECONNRESET;
+
+		ret = tcp_poll(tcp);
+		if (ret)
+			return ret;
+
+		if (is_timeout(tcp->last_rx, TCP_IDLE_TIMEOUT))
+			return -ETIMEDOUT;
+	}
+}
+
+/**
+ * tcp_close - close a connection and free it
+ * @tcp: the connection
+ *
+ * The connection is reset when not all data from the peer has been
+ * received.
+ */
+void tcp_close(struct tcp_connection *tcp)
+{
+	uint64_t start;
+
+	if (tcp->state == TCP_ESTABLISHED || tcp->state == TCP_CLOSE_WAIT) {
+		if (!tcp->fin_received || kfifo_len(tcp->rxfifo)) {
+			tcp_xmit(tcp, TH_RST | TH_ACK, tcp->snd_nxt, NULL, 0);
+		} else {
+			tcp->closing = true;
+			tcp_output(tcp);
+
+			start = get_time_ns();
+
+			while (tcp->state != TCP_CLOSED &&
+			       !is_timeout(start, TCP_CLOSE_TIMEOUT)) {
+				if (tcp_poll(tcp))
+					break;
+			}
+		}
+	}
+
+	tcp_free(tcp);
+}
@@ -0,0 +1,139 @@
+/*
+ * udpsink.c - receive and discard UDP packets to measure the receive rate
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include <common.h>
+#include <command.h>
+#include <clock.h>
+#include <getopt.h>
+#include <net.h>
+#include <errno.h>
+#include <asm-generic/div64.h>
+#include <linux/err.h>
+
+#define UDPSINK_PORT	9	/* discard */
+
+static unsigned int udpsink_packets;
+static uint64_t udpsink_bytes;
+static uint64_t udpsink_start, udpsink_end;
+
+static void udpsink_handler(void *ctx, char *pkt, unsigned len)
+{
+	struct iphdr *ip = net_eth_to_iphdr(pkt);
+	struct udphdr *udp = (struct udphdr *)(ip + 1);
+
+	udpsink_end = get_time_ns();
+	if (!udpsink_packets)
+		udpsink_start = udpsink_end;
+
+	udpsink_packets++;
+	udpsink_bytes += ntohs(udp->uh_ulen) - sizeof(struct udphdr);
+}
+
+static int do_udpsink(int argc, char *argv[])
+{
+	struct net_connection *con;
+	struct eth_device *edev;
+	const char *ethname = "eth0";
+	unsigned int port = UDPSINK_PORT, timeout = 10;
+	uint64_t start, ns, ms, rate;
+	int opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "i:p:t:")) > 0) {
+		switch (opt) {
+		case 'i':
+			ethname = optarg;
+			break;
+		case 'p':
+			port = simple_strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			timeout = simple_strtoul(optarg, NULL, 0);
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (optind != argc)
+		return COMMAND_ERROR_USAGE;
+
+	edev = eth_get_byname(ethname);
+	if (!edev) {
+		printf("%s: no such device\n", ethname);
+		return 1;
+	}
+
+	con = net_udp_eth_new(edev, IP_BROADCAST, 0, udpsink_handler, NULL);
+	if (IS_ERR(con)) {
+		printf("udpsink failed: %s\n", strerrorp(con));
+		return 1;
+	}
+
+	net_udp_bind(con, port);
+
+	udpsink_packets = 0;
+	udpsink_bytes = 0;
+
+	printf("receiving on port %u for %us...\n", port, timeout);
+
+	start = get_time_ns();
+
+	while (!is_timeout(start, timeout * SECOND)) {
+		if (ctrlc()) {
+			ret = -EINTR;
+			break;
+		}
+
+		net_poll();
+	}
+
+	net_unregister(con);
+
+	if (udpsink_packets < 2) {
+		printf("%u packets received\n", udpsink_packets);
+		return ret ? 1 : 0;
+	}
+
+	/* only count the time between the first and the last packet */
+	ns = max_t(uint64_t, udpsink_end - udpsink_start, 1);
+
+	ms = ns;
+	do_div(ms, MSECOND);
+
+	rate = (uint64_t)udpsink_packets * SECOND;
+	do_div(rate, ns);
+	printf("%u packets, %llu bytes in %llu ms: %llu packets/s",
+	       udpsink_packets, udpsink_bytes, ms, rate);
+
+	printf(", %s\n", rate_human_readable(udpsink_bytes, ns));
+
+	return 0;
+}
+
+BAREBOX_CMD_HELP_START(udpsink)
+BAREBOX_CMD_HELP_TEXT("Receive and discard UDP packets and report the packet and data")
+BAREBOX_CMD_HELP_TEXT("rate between the first and the last received packet. Send packets")
+BAREBOX_CMD_HELP_TEXT("from a host with e.g. 'iperf -u -c TARGET -p 9 -b 100M'.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-i INTF", "interface to receive on (default eth0)")
+BAREBOX_CMD_HELP_OPT ("-p PORT", "UDP port to listen on (default 9)")
+BAREBOX_CMD_HELP_OPT ("-t SECONDS", "time to receive (default 10)")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(udpsink)
+	.cmd		= do_udpsink,
+	BAREBOX_CMD_DESC("measure the UDP receive rate")
+	BAREBOX_CMD_OPTS("[-ipt]")
+	BAREBOX_CMD_GROUP(CMD_GRP_NET)
+	BAREBOX_CMD_HELP(cmd_udpsink_help)
+BAREBOX_CMD_END